@@ -6,10 +6,51 @@
 	Copyright (c) 2023 Oscar Bergström
 */
 
+// MAP_ANONYMOUS isn't part of POSIX.
+#define _DEFAULT_SOURCE
+#include <stdint.h>
+#include <sys/mman.h>
 #include "allocHandler.h"
 
+#define MEMORY_OVERLAY_WIDTH 42
+
 char *_backUpBuffer = NULL; 
 
+static const char *_categoryNames[MEM_CATEGORY_COUNT] = {"document", "structure", "clipboard", "buffers"};
+static long _currentBytes[MEM_CATEGORY_COUNT];
+static long _peakBytes[MEM_CATEGORY_COUNT];
+static long _currentTotal = 0, _peakTotal = 0;
+static long _memoryBudget = 0;
+
+// The nodes are cut from slabs of one pool, the address range of the pool is reserved once so a node never moves and is found from its index.
+// Slab k holds the nodes k * NODE_SLAB_NODES up to (k + 1) * NODE_SLAB_NODES, it's only backed by memory while it holds nodes.
+typedef struct nodeSlab
+{
+	uint32_t freeNodes;
+	long liveNodes, usedNodes;
+	long nextFree, prevFree;
+	bool isMapped;
+} nodeSlab;
+
+#define SLAB_BYTES (NODE_SLAB_NODES * (long)sizeof(TEXT))
+
+TEXT *_nodePool = NULL;
+static long _poolSlabs = 0;
+static nodeSlab *_slabs = NULL;
+static long _slabCount = 0, _slabCapacity = 0, _mappedSlabs = 0;
+
+// The slabs with nodes left to hand out and the slabs given back to the system, -1 ends each list.
+// Up to NODE_SPARE_SLABS of the slabs with nodes left may be empty, they are kept instead of being given back.
+static long _freeSlabs = -1, _unmappedSlabs = -1, _spareSlabs = 0;
+
+static void reservePool(void);
+static long mapSlab(void);
+static void releaseSlab(long slab);
+static void linkFreeSlab(long slab);
+static void unlinkFreeSlab(long slab);
+static void failPool(const char *reason);
+static double getBytesPerCharacter(void);
+
 /** 
  * This function will allocate and store a backup. 
  * The backup is used if malloc fails which freeing it might yield some empty paging.
@@ -58,3 +99,349 @@ void *memAlloc(void *mem, int size)
 success:
 	return mem; 
 }
+
+/**
+ * Account for memory that was allocated (bytes > 0) or freed (bytes < 0) within a category.
+ * The current and the peak usage are kept for each category and in total.
+ */
+void trackMemory(int category, long bytes)
+{
+	_currentBytes[category] += bytes;
+	_currentTotal += bytes;
+
+	if (_currentBytes[category] > _peakBytes[category])
+	{
+		_peakBytes[category] = _currentBytes[category];
+	}
+
+	if (_currentTotal > _peakTotal)
+	{
+		_peakTotal = _currentTotal;
+	}
+}
+
+/**
+ * Account for created (nodes > 0) or deleted (nodes < 0) TEXT nodes.
+ * The slabs holding the nodes are counted as structure when they are mapped, the character of each node is moved from it to the document.
+ */
+void trackNodes(long nodes)
+{
+	trackMemory(MEM_DOCUMENT, nodes);
+	trackMemory(MEM_STRUCTURE, -nodes);
+}
+
+/**
+ * Take a node from the pool, from the first slab with a node left. A new slab is mapped when every slab is full.
+ * The node is counted by trackNodes like before.
+ */
+TEXT *allocNode(void)
+{
+	if (_freeSlabs == -1)
+	{
+		linkFreeSlab(mapSlab());
+	}
+
+	long number = _freeSlabs;
+	nodeSlab *slab = &_slabs[number];
+	uint32_t index = slab->freeNodes;
+	if (index != 0)
+	{
+		slab->freeNodes = _nodePool[index].next;
+	}
+	else
+	{
+		index = (uint32_t)(number * NODE_SLAB_NODES + slab->usedNodes++);
+	}
+
+	_spareSlabs -= slab->liveNodes++ == 0 ? 1 : 0;
+	if (slab->freeNodes == 0 && slab->usedNodes == NODE_SLAB_NODES)
+	{
+		unlinkFreeSlab(number);
+	}
+
+	_nodePool[index].viewSlot = 0;
+	return &_nodePool[index];
+}
+
+/**
+ * Give a node back to its slab, a slab left without nodes is given back to the system.
+ */
+void freeNode(TEXT *node)
+{
+	uint32_t index = (uint32_t)(node - _nodePool);
+	long number = index / NODE_SLAB_NODES;
+	nodeSlab *slab = &_slabs[number];
+	if (slab->freeNodes == 0 && slab->usedNodes == NODE_SLAB_NODES)
+	{
+		linkFreeSlab(number);
+	}
+
+	// A freed node is no longer in the view, even while its slab is kept.
+	node->viewSlot = 0;
+	if (--slab->liveNodes == 0)
+	{
+		releaseSlab(number);
+		return;
+	}
+
+	node->next = slab->freeNodes;
+	slab->freeNodes = index;
+}
+
+/**
+ * Check that the memory of a node is still mapped, a node that was freed may be part of a slab given back to the system.
+ */
+bool isNodeMapped(const TEXT *node)
+{
+	if (_nodePool == NULL || node < _nodePool)
+	{
+		return false;
+	}
+
+	long number = (node - _nodePool) / NODE_SLAB_NODES;
+	return number < _slabCount && _slabs[number].isMapped;
+}
+
+/**
+ * Reserve the address range of the pool without backing it by memory. The range is halved until it can be reserved,
+ * the address space may be limited.
+ */
+static void reservePool(void)
+{
+	for (long slabs = NODE_POOL_SLABS; slabs > 0 && _nodePool == NULL; slabs /= 2)
+	{
+		void *pool = mmap(NULL, slabs * SLAB_BYTES, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+		_nodePool = pool != MAP_FAILED ? pool : NULL;
+		_poolSlabs = pool != MAP_FAILED ? slabs : 0;
+	}
+
+	if (_nodePool == NULL)
+	{
+		failPool("no address range could be reserved for the nodes");
+	}
+}
+
+/**
+ * Back an empty slab by memory, a slab given back earlier is used before a new one.
+ * The slab is a spare until its first node is used, the whole slab is counted as structure until its nodes are used.
+ */
+static long mapSlab(void)
+{
+	if (_nodePool == NULL)
+	{
+		reservePool();
+	}
+
+	long number = _unmappedSlabs;
+	if (number != -1)
+	{
+		_unmappedSlabs = _slabs[number].nextFree;
+	}
+	else
+	{
+		if (_slabCount == _poolSlabs)
+		{
+			failPool("the node pool is full");
+		}
+
+		if (_slabCount == _slabCapacity)
+		{
+			long capacity = _slabCapacity > 0 ? _slabCapacity * 2 : 16;
+			_slabs = memAlloc(realloc(_slabs, capacity * sizeof(nodeSlab)), capacity * sizeof(nodeSlab));
+			trackMemory(MEM_STRUCTURE, (capacity - _slabCapacity) * (long)sizeof(nodeSlab));
+			_slabCapacity = capacity;
+		}
+		number = _slabCount++;
+	}
+
+	if (mprotect(_nodePool + number * NODE_SLAB_NODES, SLAB_BYTES, PROT_READ | PROT_WRITE) == -1)
+	{
+		failPool("no slab of nodes could be mapped");
+	}
+
+	// Index 0 ends a list, so it's never handed out.
+	nodeSlab *slab = &_slabs[number];
+	slab->freeNodes = 0;
+	slab->liveNodes = 0;
+	slab->usedNodes = number == 0 ? 1 : 0;
+	slab->nextFree = slab->prevFree = -1;
+	slab->isMapped = true;
+	++_mappedSlabs;
+	++_spareSlabs;
+	trackMemory(MEM_STRUCTURE, SLAB_BYTES);
+	return number;
+}
+
+/**
+ * Give the memory of a slab whose last node was freed back to the system, its address range stays reserved.
+ * The first empty slabs are kept as spares, so a small document that is loaded again
+ * or a node added and freed at the edge of a slab doesn't map new memory each time.
+ */
+static void releaseSlab(long number)
+{
+	nodeSlab *slab = &_slabs[number];
+	if (_spareSlabs < NODE_SPARE_SLABS)
+	{
+		slab->freeNodes = 0;
+		slab->usedNodes = number == 0 ? 1 : 0;
+		++_spareSlabs;
+		return;
+	}
+
+	unlinkFreeSlab(number);
+	mmap(_nodePool + number * NODE_SLAB_NODES, SLAB_BYTES, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_FIXED, -1, 0);
+	slab->isMapped = false;
+	slab->nextFree = _unmappedSlabs;
+	_unmappedSlabs = number;
+	--_mappedSlabs;
+	trackMemory(MEM_STRUCTURE, -SLAB_BYTES);
+}
+
+/**
+ * Add a slab to the front of the slabs with nodes left.
+ */
+static void linkFreeSlab(long number)
+{
+	_slabs[number].prevFree = -1;
+	_slabs[number].nextFree = _freeSlabs;
+	if (_freeSlabs != -1)
+	{
+		_slabs[_freeSlabs].prevFree = number;
+	}
+	_freeSlabs = number;
+}
+
+/**
+ * Remove a slab from the slabs with nodes left.
+ */
+static void unlinkFreeSlab(long number)
+{
+	nodeSlab *slab = &_slabs[number];
+	if (slab->prevFree != -1)
+	{
+		_slabs[slab->prevFree].nextFree = slab->nextFree;
+	}
+	else
+	{
+		_freeSlabs = slab->nextFree;
+	}
+
+	if (slab->nextFree != -1)
+	{
+		_slabs[slab->nextFree].prevFree = slab->prevFree;
+	}
+	slab->nextFree = slab->prevFree = -1;
+}
+
+/**
+ * End the editor when the pool can't hold another node, like memAlloc does when memory runs out.
+ */
+static void failPool(const char *reason)
+{
+	endwin();
+	fprintf(stderr, "Memory allocation failed, %s | Critical error | application will exit with return code 1\n", reason);
+	exit(1);
+}
+
+/**
+ * Give the whole pool back to the system, no node may be used after this.
+ */
+void clearNodePool(void)
+{
+	if (_nodePool != NULL)
+	{
+		munmap(_nodePool, _poolSlabs * SLAB_BYTES);
+	}
+	trackMemory(MEM_STRUCTURE, -_mappedSlabs * SLAB_BYTES - _slabCapacity * (long)sizeof(nodeSlab));
+
+	free(_slabs);
+	_slabs = NULL;
+	_nodePool = NULL;
+	_freeSlabs = _unmappedSlabs = -1;
+	_poolSlabs = _slabCount = _slabCapacity = _mappedSlabs = _spareSlabs = 0;
+}
+
+/**
+ * Get the memory needed by the nodes holding a number of characters.
+ */
+long getNodesCost(long nodes)
+{
+	return nodes * (long)sizeof(TEXT);
+}
+
+/**
+ * Set the memory budget from a string holding a number of megabytes.
+ * A missing or invalid budget means there is no budget.
+ */
+void setMemoryBudget(const char *budget)
+{
+	if (budget == NULL)
+	{
+		return;
+	}
+
+	long megaBytes = strtol(budget, NULL, 10);
+	_memoryBudget = megaBytes > 0 ? megaBytes * 1024L * 1024L : 0;
+}
+
+/**
+ * Check if allocating an additional amount of bytes keeps the total memory usage within the budget.
+ */
+bool isWithinMemoryBudget(long bytes)
+{
+	return _memoryBudget == 0 || _currentTotal + bytes <= _memoryBudget;
+}
+
+/**
+ * The amount of memory used for every character in the document.
+ */
+static double getBytesPerCharacter(void)
+{
+	if (_currentBytes[MEM_DOCUMENT] == 0)
+	{
+		return 0.0;
+	}
+
+	return (double)(_currentBytes[MEM_DOCUMENT] + _currentBytes[MEM_STRUCTURE]) / _currentBytes[MEM_DOCUMENT];
+}
+
+/**
+ * Print the memory usage of each category in the bottom right corner of the terminal.
+ * Sizes are printed in kilobytes.
+ */
+void printMemoryStats(void)
+{
+	int x = getmaxx(stdscr) - MEMORY_OVERLAY_WIDTH, y = getmaxy(stdscr) - MEM_CATEGORY_COUNT - 3;
+	x = x < 0 ? 0 : x;
+	y = y < 0 ? 0 : y;
+
+	attron(A_REVERSE);
+	mvprintw(y++, x, "%-12s%15s%15s", "memory", "current KB", "peak KB");
+	for (int i = 0; i < MEM_CATEGORY_COUNT; ++i)
+	{
+		mvprintw(y++, x, "%-12s%15.1f%15.1f", _categoryNames[i], _currentBytes[i] / 1024.0, _peakBytes[i] / 1024.0);
+	}
+	mvprintw(y++, x, "%-12s%15.1f%15.1f", "total", _currentTotal / 1024.0, _peakTotal / 1024.0);
+	mvprintw(y, x, "%-12s%30.1f", "bytes/char", getBytesPerCharacter());
+	attroff(A_REVERSE);
+}
+
+/**
+ * Write the memory usage of each category to a file, this is done when the editor exits.
+ */
+void reportMemoryUsage(FILE *fp)
+{
+	if (fp == NULL)
+	{
+		return;
+	}
+
+	fprintf(fp, "%-12s%16s%16s\n", "memory", "current bytes", "peak bytes");
+	for (int i = 0; i < MEM_CATEGORY_COUNT; ++i)
+	{
+		fprintf(fp, "%-12s%16ld%16ld\n", _categoryNames[i], _currentBytes[i], _peakBytes[i]);
+	}
+	fprintf(fp, "%-12s%16ld%16ld\n", "total", _currentTotal, _peakTotal);
+	fprintf(fp, "bytes per character at peak: %.1f\n",
+			_peakBytes[MEM_DOCUMENT] == 0 ? 0.0 : (double)(_peakBytes[MEM_DOCUMENT] + _peakBytes[MEM_STRUCTURE]) / _peakBytes[MEM_DOCUMENT]);
+}
@@ -12,10 +12,68 @@
 #include <stdlib.h>
 #include <ncurses.h>
 #include <error.h>
+#include "textData.h"
+
+#define NODE_SLAB_NODES 8192L
+#define NODE_POOL_SLABS ((1L << 32) / NODE_SLAB_NODES)
+#define NODE_SPARE_SLABS 256
+
+enum memCategory
+{
+	MEM_DOCUMENT,
+	MEM_STRUCTURE,
+	MEM_CLIPBOARD,
+	MEM_BUFFERS,
+	MEM_CATEGORY_COUNT
+};
 
 extern char *_backUpBuffer; 
+extern TEXT *_nodePool;
 
 void allocateBackUp(void);
 void *memAlloc(void *mem, int size);
+void trackMemory(int category, long bytes);
+void trackNodes(long nodes);
+TEXT *allocNode(void);
+void freeNode(TEXT *node);
+void clearNodePool(void);
+bool isNodeMapped(const TEXT *node);
+void setMemoryBudget(const char *budget);
+bool isWithinMemoryBudget(long bytes);
+long getNodesCost(long nodes);
+void printMemoryStats(void);
+void reportMemoryUsage(FILE *fp);
+
+/**
+ * The node after a node, NULL at the end of the list.
+ */
+static inline TEXT *nextNode(const TEXT *node)
+{
+	return node->next != 0 ? _nodePool + node->next : NULL;
+}
+
+/**
+ * The node before a node, NULL at the start of the list.
+ */
+static inline TEXT *prevNode(const TEXT *node)
+{
+	return node->prev != 0 ? _nodePool + node->prev : NULL;
+}
+
+/**
+ * Link the node after a node, next may be NULL.
+ */
+static inline void setNext(TEXT *node, const TEXT *next)
+{
+	node->next = next != NULL ? (uint32_t)(next - _nodePool) : 0;
+}
+
+/**
+ * Link the node before a node, prev may be NULL.
+ */
+static inline void setPrev(TEXT *node, const TEXT *prev)
+{
+	node->prev = prev != NULL ? (uint32_t)(prev - _nodePool) : 0;
+}
 
 #endif //  ALLOCHANDLER_H
@@ -0,0 +1,380 @@
+/*
+	Writen by: Oscar Bergström
+	https://github.com/OSCARJFB
+
+	MIT License
+	Copyright (c) 2023 Oscar Bergström
+*/
+
+// The benchmarks call the static functions of the editor mode, so it's compiled as a part of this file.
+#include "editorMode.c"
+
+#define BENCH_TIME_NS 200000000LL
+#define BENCH_WALL_NS 10000000000LL
+#define BENCH_MAX_ITERATIONS 100000
+#define BENCH_VIEW_LINES 1000
+#define BENCH_SAVE_PATH "/tmp/1st-editor-bench.txt"
+#define BENCH_LINE "The quick brown fox jumps over the lazy dog 0123456789\n"
+#define BENCH_MACRO "line\n"
+
+// The time spent in one operation, it's repeated until BENCH_TIME_NS has passed. Setting up the next run isn't timed,
+// but the runs stop after BENCH_WALL_NS when the setup is much slower than the operation.
+typedef struct benchTimer
+{
+	long iterations;
+	long long elapsed, started, begun;
+} benchTimer;
+
+static long parseSize(const char *text);
+static char *generateText(long size);
+static bool isTiming(benchTimer *timer);
+static void startTimer(benchTimer *timer);
+static void stopTimer(benchTimer *timer);
+static void printResult(const char *operation, long size, benchTimer timer);
+static void setView(TEXT **headNode, long line, int lines);
+static void benchCreate(char *buffer, long size);
+static void benchEdit(TEXT **headNode, long size, const char *position, long line, coordinates xy);
+static void benchSave(TEXT *headNode, long size);
+static void benchCopy(TEXT **headNode, long size, const char *name, coordinates end);
+static void benchRender(TEXT *headNode, long size);
+static void benchMacro(TEXT **headNode, long size);
+static void benchDocument(long size);
+
+/**
+ * Read a size like 1K, 1M or 1G, the suffixes are powers of 1024.
+ */
+static long parseSize(const char *text)
+{
+	char *suffix = NULL;
+	long size = strtol(text, &suffix, 10);
+	switch (*suffix)
+	{
+		case 'G':
+			size *= 1024L;
+			// fall through
+		case 'M':
+			size *= 1024L;
+			// fall through
+		case 'K':
+			size *= 1024L;
+			break;
+	}
+
+	return size;
+}
+
+/**
+ * Fill a buffer with lines of BENCH_LINE, the last line is cut at the size.
+ */
+static char *generateText(long size)
+{
+	const long lineLength = sizeof(BENCH_LINE) - 1;
+	char *buffer = memAlloc(malloc(size), size);
+	for (long i = 0; i < size; i += lineLength)
+	{
+		memcpy(buffer + i, BENCH_LINE, size - i < lineLength ? size - i : lineLength);
+	}
+
+	return buffer;
+}
+
+/**
+ * Check if an operation should run again, it runs at least once.
+ */
+static bool isTiming(benchTimer *timer)
+{
+	return timer->iterations == 0 || (timer->elapsed < BENCH_TIME_NS && timer->iterations < BENCH_MAX_ITERATIONS && getTimeNs() - timer->begun < BENCH_WALL_NS);
+}
+
+/**
+ * Start timing one run of an operation.
+ */
+static void startTimer(benchTimer *timer)
+{
+	timer->started = getTimeNs();
+	timer->begun = timer->iterations == 0 ? timer->started : timer->begun;
+}
+
+/**
+ * Stop timing one run of an operation.
+ */
+static void stopTimer(benchTimer *timer)
+{
+	timer->elapsed += getTimeNs() - timer->started;
+	++timer->iterations;
+}
+
+/**
+ * Print the result of an operation as a CSV row: operation, document size in bytes, runs and nanoseconds per run.
+ */
+static void printResult(const char *operation, long size, benchTimer timer)
+{
+	printf("%s,%ld,%ld,%.1f\n", operation, size, timer.iterations, (double)timer.elapsed / timer.iterations);
+	fflush(stdout);
+}
+
+/**
+ * Place the view at a line and give the nodes in it their coordinates.
+ */
+static void setView(TEXT **headNode, long line, int lines)
+{
+	_viewStart = line;
+	_view = lines;
+	updateCoordinatesInView(headNode);
+}
+
+/**
+ * Create the list from a buffer like when a file is loaded.
+ */
+static void benchCreate(char *buffer, long size)
+{
+	benchTimer timer = {0, 0, 0, 0};
+	while (isTiming(&timer))
+	{
+		startTimer(&timer);
+		TEXT *headNode = createNodesFromBuffer(buffer, size);
+		stopTimer(&timer);
+		deleteAllNodes(&headNode);
+	}
+
+	printResult("create", size, timer);
+}
+
+/**
+ * Add a character in front of the node at xy and delete it again, so the document doesn't grow while it's timed.
+ * A node at xy that isn't in the view edits the end of the text.
+ */
+static void benchEdit(TEXT **headNode, long size, const char *position, long line, coordinates xy)
+{
+	char operation[32];
+	setView(headNode, line, getmaxy(stdscr));
+
+	benchTimer addTimer = {0, 0, 0, 0}, deleteTimer = {0, 0, 0, 0};
+	while (isTiming(&addTimer))
+	{
+		startTimer(&addTimer);
+		addNode(headNode, 'x', xy);
+		stopTimer(&addTimer);
+
+		int deleted = 0;
+		startTimer(&deleteTimer);
+		deleteNode(headNode, xy, &deleted);
+		stopTimer(&deleteTimer);
+	}
+
+	snprintf(operation, sizeof(operation), "add_%s", position);
+	printResult(operation, size, addTimer);
+	snprintf(operation, sizeof(operation), "delete_%s", position);
+	printResult(operation, size, deleteTimer);
+}
+
+/**
+ * Turn the list into a buffer, and save it as a new file which writes all of it.
+ */
+static void benchSave(TEXT *headNode, long size)
+{
+	benchTimer timer = {0, 0, 0, 0};
+	while (isTiming(&timer))
+	{
+		startTimer(&timer);
+		long fileSize = getFileSizeFromList(headNode);
+		char *buffer = saveListToBuffer(headNode, fileSize);
+		stopTimer(&timer);
+		free(buffer);
+		trackMemory(MEM_BUFFERS, -(fileSize + 1));
+	}
+	printResult("save_buffer", size, timer);
+
+	char fileName[FILENAME_SIZE] = BENCH_SAVE_PATH;
+	benchTimer saveTimer = {0, 0, 0, 0};
+	while (isTiming(&saveTimer))
+	{
+		resetChangeMap(NULL, 0);
+		startTimer(&saveTimer);
+		save(headNode, fileName);
+		stopTimer(&saveTimer);
+	}
+	printResult("save", size, saveTimer);
+
+	stopWatchingFile();
+	remove(BENCH_SAVE_PATH);
+}
+
+/**
+ * Copy, cut and paste the text from the start of the view to an end point. The cut text is pasted back, so the document keeps its size.
+ */
+static void benchCopy(TEXT **headNode, long size, const char *name, coordinates end)
+{
+	char operation[32];
+	coordinates start = {_margins.left, 0};
+	dataCopied cpyData = {NULL, {0, 0}, {0, 0}, false, false, 0};
+	long line = getLineCount(*headNode) / 2;
+
+	benchTimer copyTimer = {0, 0, 0, 0};
+	setView(headNode, line, BENCH_VIEW_LINES);
+	while (isTiming(&copyTimer))
+	{
+		startTimer(&copyTimer);
+		cpyData = copy(cpyData, *headNode, start);
+		cpyData = copy(cpyData, *headNode, end);
+		stopTimer(&copyTimer);
+	}
+
+	benchTimer cutTimer = {0, 0, 0, 0}, pasteTimer = {0, 0, 0, 0};
+	while (isTiming(&cutTimer))
+	{
+		setView(headNode, line, BENCH_VIEW_LINES);
+		startTimer(&cutTimer);
+		cpyData = cut(cpyData, headNode, start);
+		cpyData = cut(cpyData, headNode, end);
+		stopTimer(&cutTimer);
+
+		setView(headNode, line, BENCH_VIEW_LINES);
+		startTimer(&pasteTimer);
+		cpyData = paste(headNode, cpyData, start);
+		stopTimer(&pasteTimer);
+	}
+
+	free(cpyData.copiedList);
+	trackMemory(MEM_CLIPBOARD, -cpyData.copySize);
+	snprintf(operation, sizeof(operation), "copy_%s", name);
+	printResult(operation, size, copyTimer);
+	snprintf(operation, sizeof(operation), "cut_%s", name);
+	printResult(operation, size, cutTimer);
+	snprintf(operation, sizeof(operation), "paste_%s", name);
+	printResult(operation, size, pasteTimer);
+}
+
+/**
+ * Print a full view from the middle of the text, like after a jump. The line index is built before, the edits of the other benchmarks dropped it.
+ */
+static void benchRender(TEXT *headNode, long size)
+{
+	coordinates xy = {_margins.left, 0};
+	long line = getLineCount(headNode) / 2;
+	benchTimer timer = {0, 0, 0, 0};
+	while (isTiming(&timer))
+	{
+		startTimer(&timer);
+		setView(&headNode, line, getmaxy(stdscr));
+		printText(headNode, xy);
+		refresh();
+		stopTimer(&timer);
+	}
+
+	printResult("render", size, timer);
+}
+
+/**
+ * Replay a macro typing a line in the middle of the text, each replay adds a newline. The keys go through the same steps as in the editor,
+ * without printing which a replay skips. Every newline used to build the line index again, making the replay slower the larger the text.
+ */
+static void benchMacro(TEXT **headNode, long size)
+{
+	startRecording();
+	for (const char *key = BENCH_MACRO; *key != '\0'; ++key)
+	{
+		recordKey(*key);
+	}
+	stopRecording();
+
+	coordinates xy = {_margins.left, 0};
+	setView(headNode, getLineCount(*headNode) / 2, getmaxy(stdscr));
+	startReplay(BENCH_MAX_ITERATIONS, false);
+
+	benchTimer timer = {0, 0, 0, 0};
+	while (isTiming(&timer))
+	{
+		startTimer(&timer);
+		for (int i = 0; i < (int)sizeof(BENCH_MACRO) - 1; ++i)
+		{
+			int ch = replayKey();
+			long editLine = getLineAtRow(_viewStart, xy.y), lines = 0;
+			TEXT *editedNode = edit(headNode, xy, ch, &lines);
+			moveLines(editLine, lines);
+			updateViewPort(xy, ch, *headNode, editedNode);
+			updateMargins(xy.y, ch, *headNode);
+			updateCoordinatesInView(headNode);
+			xy = updateCursor(ch, xy, editedNode, *headNode);
+		}
+		stopTimer(&timer);
+	}
+
+	stopReplay();
+	clearMacro();
+	printResult("macro_newline", size, timer);
+}
+
+/**
+ * Run every benchmark on a generated document of a size. A size whose nodes don't fit in the memory of the machine is skipped.
+ */
+static void benchDocument(long size)
+{
+	long memory = sysconf(_SC_PHYS_PAGES) * sysconf(_SC_PAGESIZE);
+	if (size <= 0 || getNodesCost(size) + size > memory / 4 * 3)
+	{
+		fprintf(stderr, "skipping %ld bytes, the document doesn't fit in memory\n", size);
+		return;
+	}
+
+	char *buffer = generateText(size);
+	_viewStart = 0;
+	_view = getmaxy(stdscr);
+	benchCreate(buffer, size);
+
+	TEXT *headNode = createNodesFromBuffer(buffer, size);
+	free(buffer);
+	long lineCount = getLineCount(headNode), lastLine = lineCount > _view ? lineCount - _view : 0;
+	setLeftMargin(lineCount);
+
+	coordinates lineXy = {_margins.left + 1, 0}, endXy = {-2, -2};
+	benchEdit(&headNode, size, "start", 0, lineXy);
+	benchEdit(&headNode, size, "middle", lineCount / 2, lineXy);
+	benchEdit(&headNode, size, "end", lastLine, endXy);
+	benchSave(headNode, size);
+
+	// The copies start in the middle of the text and end at the same character, at the end of the line or at the end of BENCH_VIEW_LINES lines.
+	const int lineEnd = _margins.left + (int)sizeof(BENCH_LINE) - 2;
+	coordinates charEnd = {_margins.left, 0}, lineCopyEnd = {lineEnd, 0}, viewEnd = {lineEnd, BENCH_VIEW_LINES - 1};
+	benchCopy(&headNode, size, "char", charEnd);
+	benchCopy(&headNode, size, "line", lineCopyEnd);
+	if (lineCount / 2 > BENCH_VIEW_LINES)
+	{
+		benchCopy(&headNode, size, "view", viewEnd);
+	}
+	benchRender(headNode, size);
+	benchMacro(&headNode, size);
+
+	deleteAllNodes(&headNode);
+	clearLineIndex();
+}
+
+/**
+ * Run the benchmarks for the sizes given as arguments, 1K, 1M and 100M when none are given. The results are printed as CSV.
+ * The view is printed to /dev/null.
+ */
+int main(int argc, char **argv)
+{
+	FILE *output = fopen("/dev/null", "w");
+	SCREEN *screen = output != NULL ? newterm(getenv("TERM") != NULL ? NULL : "xterm", output, stdin) : NULL;
+	if (screen == NULL)
+	{
+		fprintf(stderr, "The terminal could not be set up\n");
+		return 1;
+	}
+
+	printf("operation,size,iterations,ns_per_op\n");
+	const char *defaultSizes[] = {"1K", "1M", "100M"};
+	int sizeCount = argc > 1 ? argc - 1 : (int)(sizeof(defaultSizes) / sizeof(defaultSizes[0]));
+	for (int i = 0; i < sizeCount; ++i)
+	{
+		benchDocument(parseSize(argc > 1 ? argv[i + 1] : defaultSizes[i]));
+	}
+
+	endwin();
+	delscreen(screen);
+	fclose(output);
+	freeViewMap();
+	clearNodePool();
+	return 0;
+}
@@ -0,0 +1,611 @@
+/*
+	Writen by: Oscar Bergström
+	https://github.com/OSCARJFB
+
+	MIT License
+	Copyright (c) 2023 Oscar Bergström
+*/
+
+#define _GNU_SOURCE
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <sys/sendfile.h>
+#include "changeMap.h"
+#include "compressedFile.h"
+
+#define EDITED_RANGE -1
+#define WRITE_BUFFER_SIZE 65536
+
+typedef struct range
+{
+	long source, size;
+} range;
+
+static range *_ranges = NULL;
+static long _rangeCount = 0, _rangeCapacity = 0;
+static long _documentSize = 0;
+
+// A range whose start is known, edits are mostly close to the previous one so the ranges are searched from here.
+static long _fingerIndex = 0, _fingerPosition = 0;
+static char *_sourceName = NULL;
+static struct stat _sourceStat;
+static bool _isEdited = false;
+
+// The change map of a document that was switched away from, it's put back when the document is switched back to.
+struct changeMapState
+{
+	range *ranges;
+	long rangeCount, rangeCapacity, documentSize;
+	char *sourceName;
+	struct stat sourceStat;
+	bool isEdited;
+};
+
+static void reserveRanges(long count);
+static long splitRange(long offset);
+static void removeRanges(long first, long count);
+static bool isSourceUnchanged(const char *fileName);
+static bool copyRange(int source, int target, long offset, long size);
+static bool writeNodes(int target, TEXT **node, long size, char *buffer);
+static bool writePage(int source, int target, long page, TEXT **node, char *buffer);
+
+/**
+ * Start over with a document that is an unchanged copy of a file.
+ * If fileName is NULL (or the file doesn't match the size, or is compressed) the document has no source, and every save writes the whole document.
+ */
+void resetChangeMap(const char *fileName, long fileSize)
+{
+	trackMemory(MEM_STRUCTURE, -_rangeCapacity * (long)sizeof(range));
+	free(_ranges);
+	_ranges = NULL;
+	_rangeCount = _rangeCapacity = _fingerIndex = _fingerPosition = 0;
+	free(_sourceName);
+	_sourceName = NULL;
+	_isEdited = false;
+	_documentSize = fileSize > 0 ? fileSize : 0;
+
+	if (fileName == NULL || getCompression(fileName) != COMPRESSION_NONE || stat(fileName, &_sourceStat) != 0 || _sourceStat.st_size != _documentSize)
+	{
+		return;
+	}
+
+	long size = strlen(fileName) + 1;
+	_sourceName = memAlloc(malloc(size), size);
+	strcpy(_sourceName, fileName);
+
+	if (_documentSize > 0)
+	{
+		reserveRanges(1);
+		_ranges[0].source = 0;
+		_ranges[0].size = _documentSize;
+		_rangeCount = 1;
+	}
+}
+
+/**
+ * Make room for a number of ranges.
+ */
+static void reserveRanges(long count)
+{
+	if (count <= _rangeCapacity)
+	{
+		return;
+	}
+
+	long capacity = count * 2;
+	_ranges = memAlloc(realloc(_ranges, capacity * sizeof(range)), capacity * sizeof(range));
+	trackMemory(MEM_STRUCTURE, (capacity - _rangeCapacity) * (long)sizeof(range));
+	_rangeCapacity = capacity;
+}
+
+/**
+ * Make sure a range starts at the given document offset, splitting the range the offset is found in.
+ * Returns the index of the range starting at the offset.
+ */
+static long splitRange(long offset)
+{
+	long i = _fingerIndex < _rangeCount && _fingerPosition <= offset ? _fingerIndex : 0;
+	long position = i > 0 ? _fingerPosition : 0;
+	for (; i < _rangeCount; position += _ranges[i++].size)
+	{
+		// The range before the one returned keeps its start whatever the edit does to it.
+		if (position == offset)
+		{
+			_fingerIndex = i > 0 ? i - 1 : 0;
+			_fingerPosition = i > 0 ? position - _ranges[i - 1].size : 0;
+			return i;
+		}
+
+		if (offset < position + _ranges[i].size)
+		{
+			_fingerIndex = i;
+			_fingerPosition = position;
+			long headSize = offset - position;
+			reserveRanges(_rangeCount + 1);
+			memmove(&_ranges[i + 2], &_ranges[i + 1], (_rangeCount - i - 1) * sizeof(range));
+			_ranges[i + 1].source = _ranges[i].source == EDITED_RANGE ? EDITED_RANGE : _ranges[i].source + headSize;
+			_ranges[i + 1].size = _ranges[i].size - headSize;
+			_ranges[i].size = headSize;
+			++_rangeCount;
+			return i + 1;
+		}
+	}
+
+	return _rangeCount;
+}
+
+/**
+ * Remove a number of ranges starting at index first.
+ */
+static void removeRanges(long first, long count)
+{
+	if (_fingerIndex >= first)
+	{
+		_fingerIndex = _fingerPosition = 0;
+	}
+
+	memmove(&_ranges[first], &_ranges[first + count], (_rangeCount - first - count) * sizeof(range));
+	_rangeCount -= count;
+}
+
+/**
+ * Record text inserted into the document, the inserted text is marked as edited.
+ * The edit is recorded in the journal as well.
+ */
+void recordInsert(long offset, const char *text, long size)
+{
+	if (size <= 0)
+	{
+		return;
+	}
+	shiftLineIndex(offset, size);
+	_isEdited = true;
+
+	// The list only holds a window of a paged file, so the edit is recorded for the page it was made in.
+	if (isPaged())
+	{
+		editPages(offset, size);
+		_documentSize += size;
+		return;
+	}
+
+	journalInsert(offset, text, size);
+	_documentSize += size;
+	if (_sourceName == NULL)
+	{
+		return;
+	}
+
+	// Grow a neighbouring edited range or add a new one.
+	long i = splitRange(offset);
+	if (i > 0 && _ranges[i - 1].source == EDITED_RANGE)
+	{
+		_ranges[i - 1].size += size;
+	}
+	else if (i < _rangeCount && _ranges[i].source == EDITED_RANGE)
+	{
+		_ranges[i].size += size;
+	}
+	else
+	{
+		reserveRanges(_rangeCount + 1);
+		memmove(&_ranges[i + 1], &_ranges[i], (_rangeCount - i) * sizeof(range));
+		_ranges[i].source = EDITED_RANGE;
+		_ranges[i].size = size;
+		++_rangeCount;
+	}
+}
+
+/**
+ * Record text deleted from the document.
+ * The edit is recorded in the journal as well.
+ */
+void recordDelete(long offset, long size)
+{
+	if (size <= 0)
+	{
+		return;
+	}
+	shiftLineIndex(offset, -size);
+	_isEdited = true;
+
+	if (isPaged())
+	{
+		editPages(offset, -size);
+		_documentSize -= size;
+		return;
+	}
+
+	journalDelete(offset, size);
+	_documentSize -= size;
+	if (_sourceName == NULL)
+	{
+		return;
+	}
+
+	long first = splitRange(offset), last = splitRange(offset + size);
+	removeRanges(first, last - first);
+
+	// Edited ranges that now meet are joined.
+	if (first > 0 && first < _rangeCount && _ranges[first - 1].source == EDITED_RANGE && _ranges[first].source == EDITED_RANGE)
+	{
+		_ranges[first - 1].size += _ranges[first].size;
+		removeRanges(first, 1);
+	}
+}
+
+/**
+ * Record text that was appended to the source file by another program and added to the end of the document.
+ * The journal is moved over to the grown file, its records still apply since the text was added after all of them.
+ */
+void recordAppendedSource(long size)
+{
+	if (size <= 0)
+	{
+		return;
+	}
+
+	refreshJournalHeader();
+	_documentSize += size;
+	if (_sourceName == NULL)
+	{
+		return;
+	}
+
+	long sourceSize = _sourceStat.st_size;
+	if (stat(_sourceName, &_sourceStat) != 0)
+	{
+		_sourceStat.st_size = sourceSize + size;
+	}
+
+	reserveRanges(_rangeCount + 1);
+	_ranges[_rangeCount].source = sourceSize;
+	_ranges[_rangeCount++].size = size;
+}
+
+/**
+ * The amount of characters in the document.
+ */
+long getDocumentSize(void)
+{
+	return _documentSize;
+}
+
+/**
+ * Check if the document still holds the same text as the file it was loaded from, even if it was edited back and forth.
+ * The state of the file when it was loaded is stored in sourceStat.
+ */
+bool isDocumentUnchanged(struct stat *sourceStat)
+{
+	if (_sourceName == NULL)
+	{
+		return false;
+	}
+
+	long position = 0;
+	for (long i = 0; i < _rangeCount; position += _ranges[i++].size)
+	{
+		if (_ranges[i].source != position)
+		{
+			return false;
+		}
+	}
+
+	*sourceStat = _sourceStat;
+	return position == _sourceStat.st_size;
+}
+
+/**
+ * Check if the document holds text that isn't saved. A document with a source is compared through its ranges,
+ * so text that was edited back to what it was isn't modified. Without a source any edit modifies it.
+ */
+bool isDocumentModified(void)
+{
+	struct stat sourceStat;
+	return _sourceName != NULL ? !isDocumentUnchanged(&sourceStat) : _isEdited;
+}
+
+/**
+ * Take the change map of the document away, the editor is left with an empty map without a source.
+ */
+changeMapState *takeChangeMap(void)
+{
+	changeMapState *state = memAlloc(malloc(sizeof(changeMapState)), sizeof(changeMapState));
+	trackMemory(MEM_STRUCTURE, sizeof(changeMapState));
+	state->ranges = _ranges;
+	state->rangeCount = _rangeCount;
+	state->rangeCapacity = _rangeCapacity;
+	state->documentSize = _documentSize;
+	state->sourceName = _sourceName;
+	state->sourceStat = _sourceStat;
+	state->isEdited = _isEdited;
+
+	_ranges = NULL;
+	_sourceName = NULL;
+	_rangeCount = _rangeCapacity = _documentSize = _fingerIndex = _fingerPosition = 0;
+	_isEdited = false;
+	return state;
+}
+
+/**
+ * Replace the change map with one that was taken away, the state is freed.
+ */
+void restoreChangeMap(changeMapState *state)
+{
+	resetChangeMap(NULL, 0);
+	_ranges = state->ranges;
+	_rangeCount = state->rangeCount;
+	_rangeCapacity = state->rangeCapacity;
+	_documentSize = state->documentSize;
+	_sourceName = state->sourceName;
+	_sourceStat = state->sourceStat;
+	_isEdited = state->isEdited;
+
+	trackMemory(MEM_STRUCTURE, -(long)sizeof(changeMapState));
+	free(state);
+}
+
+/**
+ * Free a change map that was taken away.
+ */
+void freeChangeMap(changeMapState *state)
+{
+	trackMemory(MEM_STRUCTURE, -state->rangeCapacity * (long)sizeof(range) - (long)sizeof(changeMapState));
+	free(state->ranges);
+	free(state->sourceName);
+	free(state);
+}
+
+/**
+ * The unchanged ranges can only be copied if the file still is the one the document was loaded from.
+ */
+static bool isSourceUnchanged(const char *fileName)
+{
+	struct stat current;
+	if (_sourceName == NULL || strcmp(fileName, _sourceName) != 0 || stat(fileName, &current) != 0)
+	{
+		return false;
+	}
+
+	return current.st_ino == _sourceStat.st_ino && current.st_size == _sourceStat.st_size &&
+		   current.st_mtim.tv_sec == _sourceStat.st_mtim.tv_sec && current.st_mtim.tv_nsec == _sourceStat.st_mtim.tv_nsec;
+}
+
+/**
+ * Copy a range of the source file to the end of the target file inside the kernel.
+ * copy_file_range is tried first, sendfile is used where it isn't supported.
+ */
+static bool copyRange(int source, int target, long offset, long size)
+{
+	loff_t sourceOffset = offset;
+	while (size > 0)
+	{
+		ssize_t copied = copy_file_range(source, &sourceOffset, target, NULL, size, 0);
+		if (copied <= 0)
+		{
+			break;
+		}
+		size -= copied;
+	}
+
+	off_t sendOffset = sourceOffset;
+	while (size > 0)
+	{
+		ssize_t sent = sendfile(target, source, &sendOffset, size);
+		if (sent <= 0)
+		{
+			return false;
+		}
+		size -= sent;
+	}
+
+	return true;
+}
+
+/**
+ * Write the characters of a number of nodes to the target file, moving node past them.
+ */
+static bool writeNodes(int target, TEXT **node, long size, char *buffer)
+{
+	while (size > 0)
+	{
+		long length = 0;
+		for (; *node != NULL && length < size && length < WRITE_BUFFER_SIZE; *node = nextNode(*node))
+		{
+			buffer[length++] = (*node)->ch;
+		}
+
+		if (length == 0 || write(target, buffer, length) != length)
+		{
+			return false;
+		}
+		size -= length;
+	}
+
+	return true;
+}
+
+/**
+ * The new file is written next to the file it replaces, "dir/name" is written to "dir/.name.ob-save".
+ * A symbolic link is followed, the new file has to be next to the file the link points to so it can be renamed over it.
+ */
+char *getSavePath(const char *fileName)
+{
+	char realName[PATH_MAX];
+	fileName = realpath(fileName, realName) != NULL ? realName : fileName;
+	const char *base = strrchr(fileName, '/');
+	int dirLength = base == NULL ? 0 : (int)(base - fileName) + 1;
+	base = base == NULL ? fileName : base + 1;
+
+	long size = strlen(fileName) + sizeof(".ob-save") + 1;
+	char *path = memAlloc(malloc(size), size);
+	sprintf(path, "%.*s.%s.ob-save", dirLength, fileName, base);
+	return path;
+}
+
+/**
+ * Put a new file written to the save path in place of a file, returns false if the file was left as it was.
+ * The new file is renamed over the file a symbolic link points to, so the link is kept. A file with other hard links is overwritten
+ * with the new file instead, a rename would give the file a new inode and leave the other links with the old text.
+ */
+bool replaceFile(const char *savePath, const char *fileName)
+{
+	struct stat fileStat;
+	char realName[PATH_MAX];
+	fileName = realpath(fileName, realName) != NULL ? realName : fileName;
+	if (stat(fileName, &fileStat) != 0 || fileStat.st_nlink <= 1)
+	{
+		return rename(savePath, fileName) == 0;
+	}
+
+	struct stat saveStat;
+	int source = open(savePath, O_RDONLY);
+	int target = open(fileName, O_WRONLY | O_TRUNC);
+	bool isWritten = source != -1 && target != -1 && fstat(source, &saveStat) == 0 && copyRange(source, target, 0, saveStat.st_size) && fsync(target) == 0;
+	if (source != -1)
+	{
+		close(source);
+	}
+	if (target != -1)
+	{
+		close(target);
+	}
+
+	unlink(savePath);
+	return isWritten;
+}
+
+/**
+ * Save the document by copying the unchanged ranges from the file it was loaded from, only edited ranges are written from the list.
+ * The new file replaces the old one when it's complete. Returns false if the document can't be saved this way.
+ */
+bool saveChangedRanges(const char *fileName, TEXT *headNode)
+{
+	if (fileName == NULL || !isSourceUnchanged(fileName))
+	{
+		return false;
+	}
+
+	char *savePath = getSavePath(fileName);
+	int source = open(fileName, O_RDONLY);
+	int target = open(savePath, O_WRONLY | O_CREAT | O_TRUNC, _sourceStat.st_mode & 07777);
+	bool isWritten = source != -1 && target != -1;
+
+	char *buffer = memAlloc(malloc(WRITE_BUFFER_SIZE), WRITE_BUFFER_SIZE);
+	trackMemory(MEM_BUFFERS, WRITE_BUFFER_SIZE);
+
+	TEXT *node = headNode;
+	for (long i = 0; i < _rangeCount && isWritten; ++i)
+	{
+		if (_ranges[i].source == EDITED_RANGE)
+		{
+			isWritten = writeNodes(target, &node, _ranges[i].size, buffer);
+			continue;
+		}
+
+		isWritten = copyRange(source, target, _ranges[i].source, _ranges[i].size);
+		for (long skip = _ranges[i].size; node != NULL && skip > 0; --skip)
+		{
+			node = nextNode(node);
+		}
+	}
+
+	trackMemory(MEM_BUFFERS, -WRITE_BUFFER_SIZE);
+	free(buffer);
+	isWritten = isWritten && fsync(target) == 0;
+
+	if (source != -1)
+	{
+		close(source);
+	}
+	if (target != -1)
+	{
+		close(target);
+	}
+
+	if (isWritten && replaceFile(savePath, fileName))
+	{
+		resetChangeMap(fileName, _documentSize);
+		free(savePath);
+		return true;
+	}
+
+	unlink(savePath);
+	free(savePath);
+	return false;
+}
+
+/**
+ * Write a page of a paged file to the end of the target file, moving node past the page if it's in the window.
+ * Edited pages in the window are written from the list, pages moved out of the window from their stored text, the rest is copied from the file.
+ */
+static bool writePage(int source, int target, long page, TEXT **node, char *buffer)
+{
+	long size = getPageSize(page);
+	bool isWindow = page >= getFirstPage() && page <= getLastPage();
+	if (isWindow && isPageEdited(page))
+	{
+		return writeNodes(target, node, size, buffer);
+	}
+
+	for (long skip = isWindow ? size : 0; *node != NULL && skip > 0; --skip)
+	{
+		*node = nextNode(*node);
+	}
+
+	if (getPageOverlay(page) != NULL)
+	{
+		return write(target, getPageOverlay(page), size) == size;
+	}
+
+	return copyRange(source, target, getPageStart(page), size);
+}
+
+/**
+ * Save a paged file, only the edited pages are written and the rest is copied from the file inside the kernel.
+ * The new file replaces the old one when it's complete. Returns false if the file was changed by another program since it was opened.
+ */
+bool savePages(const char *fileName, TEXT *headNode)
+{
+	struct stat sourceStat;
+	if (!isPagedSourceUnchanged(fileName) || fstat(getPagedFd(), &sourceStat) != 0)
+	{
+		return false;
+	}
+
+	char *savePath = getSavePath(fileName);
+	int target = open(savePath, O_WRONLY | O_CREAT | O_TRUNC, sourceStat.st_mode & 07777);
+	bool isWritten = target != -1;
+
+	char *buffer = memAlloc(malloc(WRITE_BUFFER_SIZE), WRITE_BUFFER_SIZE);
+	trackMemory(MEM_BUFFERS, WRITE_BUFFER_SIZE);
+
+	TEXT *node = headNode;
+	for (long i = 0; i < getPageCount() && isWritten; ++i)
+	{
+		isWritten = writePage(getPagedFd(), target, i, &node, buffer);
+	}
+
+	trackMemory(MEM_BUFFERS, -WRITE_BUFFER_SIZE);
+	free(buffer);
+	isWritten = isWritten && fsync(target) == 0;
+
+	if (target != -1)
+	{
+		close(target);
+	}
+
+	if (isWritten && replaceFile(savePath, fileName))
+	{
+		rebasePages(fileName);
+		free(savePath);
+		return true;
+	}
+
+	unlink(savePath);
+	free(savePath);
+	return false;
+}
@@ -0,0 +1,38 @@
+/*
+	Writen by: Oscar Bergström
+	https://github.com/OSCARJFB
+
+	MIT License
+	Copyright (c) 2023 Oscar Bergström
+*/
+
+#ifndef CHANGEMAP_H
+#define CHANGEMAP_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <sys/stat.h>
+#include "textData.h"
+#include "allocHandler.h"
+#include "journal.h"
+#include "pagedFile.h"
+#include "lineIndex.h"
+
+typedef struct changeMapState changeMapState;
+
+void resetChangeMap(const char *fileName, long fileSize);
+void recordInsert(long offset, const char *text, long size);
+void recordDelete(long offset, long size);
+void recordAppendedSource(long size);
+long getDocumentSize(void);
+bool isDocumentUnchanged(struct stat *sourceStat);
+bool isDocumentModified(void);
+changeMapState *takeChangeMap(void);
+void restoreChangeMap(changeMapState *state);
+void freeChangeMap(changeMapState *state);
+bool saveChangedRanges(const char *fileName, TEXT *headNode);
+bool savePages(const char *fileName, TEXT *headNode);
+char *getSavePath(const char *fileName);
+bool replaceFile(const char *savePath, const char *fileName);
+
+#endif // CHANGEMAP_H
@@ -0,0 +1,255 @@
+/*
+	Writen by: Oscar Bergström
+	https://github.com/OSCARJFB
+
+	MIT License
+	Copyright (c) 2023 Oscar Bergström
+*/
+
+#define _POSIX_C_SOURCE 200809L
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <spawn.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include "compressedFile.h"
+#include "changeMap.h"
+
+extern char **environ;
+
+// The tool decompressing the file being streamed into the document.
+static pid_t _decompressPid = -1;
+
+static bool openPipe(int fds[2]);
+static pid_t spawnTool(char *arguments[], int input, int output);
+static bool writeNodes(int fd, TEXT *headNode);
+
+/**
+ * The compression of a file, found from its extension.
+ */
+int getCompression(const char *fileName)
+{
+	size_t length = fileName != NULL ? strlen(fileName) : 0;
+	if (length > 3 && strcmp(fileName + length - 3, ".gz") == 0)
+	{
+		return COMPRESSION_GZIP;
+	}
+
+	if (length > 4 && strcmp(fileName + length - 4, ".zst") == 0)
+	{
+		return COMPRESSION_ZSTD;
+	}
+
+	return COMPRESSION_NONE;
+}
+
+/**
+ * Create a pipe whose ends aren't inherited, a tool only gets the end it is given.
+ */
+static bool openPipe(int fds[2])
+{
+	if (pipe(fds) == -1)
+	{
+		return false;
+	}
+
+	fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+	fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+	return true;
+}
+
+/**
+ * Run gzip or zstd reading from input (or /dev/null if it's -1) and writing to output, its errors are dropped. Returns its pid or -1.
+ */
+static pid_t spawnTool(char *arguments[], int input, int output)
+{
+	posix_spawn_file_actions_t actions;
+	posix_spawn_file_actions_init(&actions);
+	if (input == -1)
+	{
+		posix_spawn_file_actions_addopen(&actions, STDIN_FILENO, "/dev/null", O_RDONLY, 0);
+	}
+	else
+	{
+		posix_spawn_file_actions_adddup2(&actions, input, STDIN_FILENO);
+	}
+	posix_spawn_file_actions_adddup2(&actions, output, STDOUT_FILENO);
+	posix_spawn_file_actions_addopen(&actions, STDERR_FILENO, "/dev/null", O_WRONLY, 0);
+
+	pid_t pid = -1;
+	bool isSpawned = posix_spawnp(&pid, arguments[0], &actions, NULL, arguments, environ) == 0;
+	posix_spawn_file_actions_destroy(&actions);
+	return isSpawned ? pid : -1;
+}
+
+/**
+ * Start decompressing a file in the background. Returns the descriptor the text can be read from as it's decompressed, -1 if it can't be.
+ */
+int openDecompression(const char *fileName)
+{
+	char *gzip[] = {"gzip", "-dc", "--", (char *)fileName, NULL};
+	char *zstd[] = {"zstd", "-dcq", "--", (char *)fileName, NULL};
+	int compression = getCompression(fileName), fds[2];
+	if (compression == COMPRESSION_NONE || !openPipe(fds))
+	{
+		return -1;
+	}
+
+	closeDecompression();
+	_decompressPid = spawnTool(compression == COMPRESSION_GZIP ? gzip : zstd, -1, fds[1]);
+	close(fds[1]);
+	if (_decompressPid == -1)
+	{
+		close(fds[0]);
+		return -1;
+	}
+
+	return fds[0];
+}
+
+/**
+ * Stop the decompression, it might still be running if the document was closed before it was read.
+ */
+void closeDecompression(void)
+{
+	if (_decompressPid == -1)
+	{
+		return;
+	}
+
+	kill(_decompressPid, SIGTERM);
+	waitpid(_decompressPid, NULL, 0);
+	_decompressPid = -1;
+}
+
+/**
+ * Decompress a whole file into a buffer, which is counted as MEM_BUFFERS memory. Returns NULL if nothing could be read.
+ */
+char *readDecompressed(const char *fileName, long *size)
+{
+	*size = 0;
+	int fd = openDecompression(fileName);
+	if (fd == -1)
+	{
+		return NULL;
+	}
+
+	long capacity = COMPRESS_CHUNK_SIZE;
+	char *buffer = memAlloc(malloc(capacity), capacity);
+	for (ssize_t bytes = 0; (bytes = read(fd, buffer + *size, capacity - *size)) != 0;)
+	{
+		if (bytes == -1 && errno == EINTR)
+		{
+			continue;
+		}
+
+		if (bytes == -1)
+		{
+			break;
+		}
+
+		*size += bytes;
+		if (*size == capacity)
+		{
+			capacity *= 2;
+			buffer = memAlloc(realloc(buffer, capacity), capacity);
+		}
+	}
+	close(fd);
+	closeDecompression();
+
+	if (*size == 0)
+	{
+		free(buffer);
+		return NULL;
+	}
+
+	buffer = memAlloc(realloc(buffer, *size), *size);
+	trackMemory(MEM_BUFFERS, *size);
+	return buffer;
+}
+
+/**
+ * Write the text of the list to a descriptor, COMPRESS_CHUNK_SIZE characters at a time.
+ */
+static bool writeNodes(int fd, TEXT *headNode)
+{
+	char buffer[COMPRESS_CHUNK_SIZE];
+	while (headNode != NULL)
+	{
+		long size = 0;
+		for (; headNode != NULL && size < COMPRESS_CHUNK_SIZE; headNode = nextNode(headNode))
+		{
+			buffer[size++] = headNode->ch;
+		}
+
+		for (long written = 0; written < size;)
+		{
+			ssize_t bytes = write(fd, buffer + written, size - written);
+			if (bytes == -1 && errno == EINTR)
+			{
+				continue;
+			}
+
+			if (bytes <= 0)
+			{
+				return false;
+			}
+			written += bytes;
+		}
+	}
+
+	return true;
+}
+
+/**
+ * Save the list compressed, the text is streamed from the list through gzip or zstd into a new file next to the old one.
+ * The new file replaces the old one when the tool succeeded, so a failed save leaves the old file as it was.
+ */
+bool saveCompressed(const char *fileName, TEXT *headNode)
+{
+	char *gzip[] = {"gzip", "-c", NULL};
+	char *zstd[] = {"zstd", "-cq", NULL};
+	struct stat fileStat;
+	mode_t mode = stat(fileName, &fileStat) == 0 ? fileStat.st_mode & 07777 : 0666;
+	char *savePath = getSavePath(fileName);
+	int target = open(savePath, O_WRONLY | O_CREAT | O_TRUNC, mode), fds[2];
+	if (target == -1 || !openPipe(fds))
+	{
+		if (target != -1)
+		{
+			close(target);
+			unlink(savePath);
+		}
+		free(savePath);
+		return false;
+	}
+
+	// A tool that fails would end the editor with SIGPIPE while the text is written to it.
+	struct sigaction ignore, old;
+	memset(&ignore, 0, sizeof(ignore));
+	ignore.sa_handler = SIG_IGN;
+	sigemptyset(&ignore.sa_mask);
+	sigaction(SIGPIPE, &ignore, &old);
+
+	pid_t pid = spawnTool(getCompression(fileName) == COMPRESSION_GZIP ? gzip : zstd, fds[0], target);
+	close(fds[0]);
+	close(target);
+	bool isWritten = pid != -1 && writeNodes(fds[1], headNode);
+	close(fds[1]);
+
+	int status = 0;
+	isWritten = pid != -1 && waitpid(pid, &status, 0) == pid && WIFEXITED(status) && WEXITSTATUS(status) == 0 && isWritten;
+	sigaction(SIGPIPE, &old, NULL);
+
+	isWritten = isWritten && replaceFile(savePath, fileName);
+	if (!isWritten)
+	{
+		unlink(savePath);
+	}
+	free(savePath);
+	return isWritten;
+}
@@ -0,0 +1,32 @@
+/*
+	Writen by: Oscar Bergström
+	https://github.com/OSCARJFB
+
+	MIT License
+	Copyright (c) 2023 Oscar Bergström
+*/
+
+#ifndef COMPRESSEDFILE_H
+#define COMPRESSEDFILE_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include "textData.h"
+#include "allocHandler.h"
+
+#define COMPRESS_CHUNK_SIZE 65536
+
+enum compression
+{
+	COMPRESSION_NONE,
+	COMPRESSION_GZIP,
+	COMPRESSION_ZSTD
+};
+
+int getCompression(const char *fileName);
+int openDecompression(const char *fileName);
+void closeDecompression(void);
+char *readDecompressed(const char *fileName, long *size);
+bool saveCompressed(const char *fileName, TEXT *headNode);
+
+#endif // COMPRESSEDFILE_H
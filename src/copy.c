@@ -8,6 +8,8 @@
 
 #include "copy.h"
 
+#define COPY_BUFFER_SIZE 1000
+
 static inline  dataCopied startPoint(dataCopied cpyData, coordinates xy);
 static inline dataCopied endPoint(dataCopied cpyData, coordinates xy);
 static dataCopied saveCopiedText(TEXT *headNode, dataCopied cpyData);
@@ -55,56 +57,55 @@ static inline dataCopied endPoint(dataCopied cpyData, coordinates xy)
  */
 static void deleteCpyList(dataCopied cpyData, TEXT **headNode)
 {
-	TEXT *node = *headNode, *startNode, *endNode, *del;
+	TEXT *node = getNodeAt(cpyData.cpyStart), *lastNode = getNodeAt(cpyData.cpyEnd), *startNode, *endNode, *del;
        	startNode = endNode = del = NULL; 	
+	long offset = 0, deleted = 0;
 
-	// Find the start location.
-	while(node != NULL)
+	// Find the start location, the nodes at the start and end points are found in the view.
+	if(node != NULL)
 	{
-		if(node->x == cpyData.cpyStart.x && node->y == cpyData.cpyStart.y)	
-		{
-			if(node->prev != NULL)
-			{
-				startNode = node->prev; 
-			}
-			break;
-		}
-		node = node->next; 
+		startNode = prevNode(node);
+		offset = findNodeOffset(*headNode, node);
 	}
 	
-	// Delete from the list until the end point is reached. 
+	// Delete from the list until the end point is reached, the end point is deleted as well.
 	while(node != NULL)
 	{
-		if(node->x == cpyData.cpyEnd.x && node->y == cpyData.cpyEnd.y)	
+		bool isEnd = node == lastNode;
+		del = node; 
+		node = nextNode(node);
+	      	freeNode(del);
+		del = NULL; 	
+		++deleted;
+
+		if(isEnd)
 		{
-			if(node->next != NULL)
-			{
-				endNode = node->next; 
-			}
+			endNode = node;
 			break;
 		}
-	
-		del = node; 
-		node = node->next;
-	      	free(del);
-		del = NULL; 	
 	}
+	trackNodes(-deleted);
+	invalidateLineIndex();
+	recordDelete(offset, deleted);
 	
 	// Link the new list depending on which part of the list that was deleted
-	if(endNode != NULL && startNode != NULL)
+	if(deleted == 0)
+	{
+		return;
+	}
+
+	if(startNode != NULL)
 	{
-		endNode->prev = startNode;
-		startNode->next = endNode;
+		setNext(startNode, endNode);
 	}
-	else if(endNode != NULL && startNode == NULL)
+	else
 	{
 		*headNode = endNode;
-		(*headNode)->prev = NULL; 
 	}
-	else if(endNode == NULL && startNode != NULL)
+
+	if(endNode != NULL)
 	{
-		*headNode = startNode;
-		(*headNode)->prev = NULL;
+		setPrev(endNode, startNode);
 	}
 }
 
@@ -114,9 +115,7 @@ static void deleteCpyList(dataCopied cpyData, TEXT **headNode)
  */
 static dataCopied saveCopiedText(TEXT *headNode, dataCopied cpyData)
 {
-	const int bufferSize = 1000;
-	int currentSize = 0;
-	bool start_found = false;
+	int bufferSize = 0, currentSize = 0;
 
 	// Swap coordinates if text selection was done backwards.
 	if (cpyData.cpyStart.y > cpyData.cpyEnd.y || (cpyData.cpyStart.y == cpyData.cpyEnd.y && cpyData.cpyStart.x > cpyData.cpyEnd.x))
@@ -126,77 +125,91 @@ static dataCopied saveCopiedText(TEXT *headNode, dataCopied cpyData)
 		cpyData.cpyEnd = temp;
 	}
 
-	// Create a buffer. 
-	while (headNode != NULL)
+	// Create a buffer, starting at the node at the start point. Every node is added until the end point or the end of the list is found.
+	TEXT *endNode = getNodeAt(cpyData.cpyEnd);
+	for (TEXT *node = headNode != NULL ? getNodeAt(cpyData.cpyStart) : NULL; node != NULL; node = nextNode(node))
 	{
-		// Start were copy point is found, add every node until the end of the list is found.
-		if ((headNode->x == cpyData.cpyStart.x && headNode->y == cpyData.cpyStart.y) || start_found)
+		// The buffer doubles when it's full, so any amount of text can be copied.
+		if (currentSize == bufferSize)
 		{
-			if (cpyData.copiedList == NULL)
-			{
-				cpyData.copiedList = memAlloc(malloc(bufferSize * sizeof(char)), bufferSize * sizeof(char));
-				start_found = true;
-			}
-
-			if (currentSize < bufferSize)
-			{
-				cpyData.copiedList[currentSize++] = headNode->ch;
-			}
+			bufferSize = bufferSize > 0 ? bufferSize * 2 : COPY_BUFFER_SIZE;
+			cpyData.copiedList = memAlloc(realloc(cpyData.copiedList, bufferSize * sizeof(char)), bufferSize * sizeof(char));
 		}
 
+		cpyData.copiedList[currentSize++] = node->ch;
+
 		// If true end of list was found.
-		if (headNode->x == cpyData.cpyEnd.x && headNode->y == cpyData.cpyEnd.y)
+		if (node == endNode)
 		{
 			break;
 		}
-
-		headNode = headNode->next;
 	}
 	
-	// Set the end size of the buffer list. 
+	// Set the end size of the buffer list, the buffer is shrunk to it and shared with the other editors.
 	cpyData.copySize = currentSize;
+	if (cpyData.copiedList != NULL)
+	{
+		cpyData.copiedList = memAlloc(realloc(cpyData.copiedList, currentSize * sizeof(char)), currentSize * sizeof(char));
+		trackMemory(MEM_CLIPBOARD, currentSize);
+		publishClip(cpyData.copiedList, currentSize);
+	}
 	return cpyData;
 }
 
 /**
  * Paste and line items to the TEXT list. 
- * Items will be pasted between xy -> xy. 
+ * Items will be pasted between xy -> xy. A clip copied in another editor since the last copy replaces the buffer first.
  */
-void paste(TEXT **headNode, dataCopied cpyData, coordinates xy)
+dataCopied paste(TEXT **headNode, dataCopied cpyData, coordinates xy)
 {
+	long sharedSize = 0;
+	char *sharedText = fetchClip(&sharedSize);
+	if (sharedText != NULL)
+	{
+		free(cpyData.copiedList);
+		trackMemory(MEM_CLIPBOARD, sharedSize - (cpyData.copiedList != NULL ? cpyData.copySize : 0));
+		cpyData.copiedList = sharedText;
+		cpyData.copySize = sharedSize;
+	}
+
 	if (*headNode == NULL || cpyData.copiedList == NULL)
 	{
-		return;
+		return cpyData;
 	}
 
-	// First find the paste start location should.
-	TEXT *preList = *headNode;
-	for (; preList->next != NULL; preList = preList->next)
+	// First find the paste start location, the node in view at xy or else the last node.
+	TEXT *preList = getNodeAt(xy);
+	if (preList == NULL)
 	{
-		if (preList->x == xy.x && preList->y == xy.y)
+		for (preList = *headNode; nextNode(preList) != NULL; preList = nextNode(preList))
 		{
-			break;
 		}
 	}
+	recordInsert(findNodeOffset(*headNode, preList) + 1, cpyData.copiedList, cpyData.copySize);
 
 	// Create and chain each new node from the copy buffer.
-	TEXT *postList = preList->next;
+	TEXT *postList = nextNode(preList);
 	for (int i = 0; i < cpyData.copySize; ++i)
 	{
-		TEXT *new_node = memAlloc(malloc(sizeof(TEXT)), sizeof(TEXT));
+		TEXT *new_node = allocNode();
 		
 		new_node->ch = cpyData.copiedList[i];
-		preList->next = new_node;
-		new_node->prev = preList;
-		preList = preList->next;
+		setNext(new_node, NULL);
+		setNext(preList, new_node);
+		setPrev(new_node, preList);
+		preList = nextNode(preList);
 	}
+	trackNodes(cpyData.copySize);
+	invalidateLineIndex();
 
 	// If any part of the list in other words, we're not at the end of the list, chain the list together.
 	if (postList != NULL)
 	{
-		preList->next = postList;
-		postList->prev = preList;
+		setNext(preList, postList);
+		setPrev(postList, preList);
 	}
+
+	return cpyData;
 }
 
 /**
@@ -211,6 +224,7 @@ dataCopied copy(dataCopied cpyData, TEXT *headNode, coordinates xy)
 	{
 		free(cpyData.copiedList);
 		cpyData.copiedList = NULL;
+		trackMemory(MEM_CLIPBOARD, -cpyData.copySize);
 	}
 
 	// Set start and end point. 
@@ -239,6 +253,7 @@ dataCopied cut(dataCopied cpyData, TEXT **headNode, coordinates xy)
 	{
 		free(cpyData.copiedList);
 		cpyData.copiedList = NULL;
+		trackMemory(MEM_CLIPBOARD, -cpyData.copySize);
 	}
 	
 	// Set start and end point. 
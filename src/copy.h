@@ -13,8 +13,12 @@
 #include <stdbool.h>
 #include "textData.h"
 #include "allocHandler.h"
+#include "changeMap.h"
+#include "lineIndex.h"
+#include "sharedClipboard.h"
+#include "viewMap.h"
 
-void paste(TEXT **headNode, dataCopied cpyData, coordinates xy);
+dataCopied paste(TEXT **headNode, dataCopied cpyData, coordinates xy);
 dataCopied copy(dataCopied cpyData, TEXT *headNode, coordinates xy);
 dataCopied cut(dataCopied cpyData, TEXT **headNode, coordinates xy);
 
@@ -0,0 +1,278 @@
+/*
+	Writen by: Oscar Bergström
+	https://github.com/OSCARJFB
+
+	MIT License
+	Copyright (c) 2023 Oscar Bergström
+*/
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdlib.h>
+#include <string.h>
+#include "documentCache.h"
+
+typedef struct document
+{
+	char fileName[FILENAME_SIZE];
+	TEXT *headNode;
+	coordinates xy;
+	int viewStart;
+	long fileSize, savedSize;
+	long long lastUse;
+	struct stat fileStat;
+
+	// A document with unsaved edits keeps its change map, and is never evicted.
+	changeMapState *changeMap;
+} document;
+
+static document _documents[DOCUMENT_CACHE_SIZE];
+static int _documentCount = 0;
+static long long _useCount = 0;
+static long _cacheBytes = 0;
+static long _cacheLimit = DOCUMENT_CACHE_MB * 1024L * 1024L;
+
+static void removeDocument(int index, bool isFreed);
+static void evictDocuments(void);
+static int findDocument(const char *fileName);
+
+/**
+ * Set the amount of memory the cached documents can use from a string holding a number of megabytes.
+ * A missing or invalid limit keeps the default limit.
+ */
+void setDocumentCacheLimit(const char *megaBytes)
+{
+	if (megaBytes == NULL)
+	{
+		return;
+	}
+
+	long limit = strtol(megaBytes, NULL, 10);
+	_cacheLimit = limit >= 0 ? limit * 1024L * 1024L : _cacheLimit;
+}
+
+/**
+ * Remove a document from the cache, the list is freed unless it is handed back to the editor.
+ */
+static void removeDocument(int index, bool isFreed)
+{
+	document *doc = &_documents[index];
+	_cacheBytes -= getNodesCost(doc->fileSize);
+
+	if (isFreed && doc->changeMap != NULL)
+	{
+		freeChangeMap(doc->changeMap);
+		discardJournal(doc->fileName);
+	}
+
+	if (isFreed)
+	{
+		for (TEXT *node = doc->headNode; node != NULL;)
+		{
+			TEXT *next = nextNode(node);
+			freeNode(node);
+			node = next;
+		}
+		trackNodes(-doc->fileSize);
+	}
+
+	_documents[index] = _documents[--_documentCount];
+}
+
+/**
+ * Evict the least recently used documents until the cache fits within its limits. Documents with unsaved edits are kept.
+ */
+static void evictDocuments(void)
+{
+	while (_documentCount > DOCUMENT_CACHE_SIZE - 1 || _cacheBytes > _cacheLimit)
+	{
+		int oldest = -1;
+		for (int i = 0; i < _documentCount; ++i)
+		{
+			bool isOlder = oldest == -1 || _documents[i].lastUse < _documents[oldest].lastUse;
+			oldest = _documents[i].changeMap == NULL && isOlder ? i : oldest;
+		}
+
+		if (oldest == -1)
+		{
+			return;
+		}
+		removeDocument(oldest, true);
+	}
+}
+
+/**
+ * Find the index of a cached document, -1 if it isn't cached.
+ */
+static int findDocument(const char *fileName)
+{
+	for (int i = 0; i < _documentCount; ++i)
+	{
+		if (strcmp(_documents[i].fileName, fileName) == 0)
+		{
+			return i;
+		}
+	}
+
+	return -1;
+}
+
+/**
+ * Keep a document that is switched away from, so switching back to it doesn't require the file to be loaded again.
+ * A document with unsaved edits takes its change map along, its journal is kept by the editor. Other documents are only cached
+ * if they hold the same text as their file. A document without a name is never cached, it couldn't be found again and is asked to be saved instead.
+ * Returns false if the document wasn't cached.
+ */
+bool cacheDocument(const char *fileName, TEXT *headNode, coordinates xy, int viewStart, long fileSize, long savedSize)
+{
+	struct stat fileStat;
+	bool isModified = isDocumentModified();
+	if (fileName == NULL || fileName[0] == '\0' || strlen(fileName) >= FILENAME_SIZE ||
+		(!isModified && (!isDocumentUnchanged(&fileStat) || getNodesCost(fileSize) > _cacheLimit)))
+	{
+		return false;
+	}
+
+	// Make room for the new document by evicting the oldest ones, one slot is always kept free.
+	int index = findDocument(fileName);
+	if (index != -1)
+	{
+		removeDocument(index, true);
+	}
+	_cacheBytes += getNodesCost(fileSize);
+	evictDocuments();
+
+	// Every slot may hold a document with unsaved edits.
+	if (_documentCount == DOCUMENT_CACHE_SIZE)
+	{
+		_cacheBytes -= getNodesCost(fileSize);
+		return false;
+	}
+
+	if (isModified && stat(fileName, &fileStat) != 0)
+	{
+		memset(&fileStat, 0, sizeof(fileStat));
+	}
+
+	document *doc = &_documents[_documentCount++];
+	strcpy(doc->fileName, fileName);
+	doc->headNode = headNode;
+	doc->xy = xy;
+	doc->viewStart = viewStart;
+	doc->fileSize = fileSize;
+	doc->savedSize = savedSize;
+	doc->lastUse = ++_useCount;
+	doc->fileStat = fileStat;
+	doc->changeMap = isModified ? takeChangeMap() : NULL;
+
+	return true;
+}
+
+/**
+ * Take a document out of the cache, restoring the cursor, view, change map and journal it had. The size it was saved with is set.
+ * If the file was changed since the document was cached an unmodified document is thrown away and NULL is returned,
+ * a modified one is kept but its journal no longer applies to the file and is started over from the changed file.
+ */
+TEXT *takeCachedDocument(const char *fileName, coordinates *xy, int *viewStart, long *savedSize)
+{
+	int index = findDocument(fileName);
+	if (index == -1)
+	{
+		return NULL;
+	}
+
+	struct stat current;
+	document *doc = &_documents[index];
+	bool isFileChanged = stat(fileName, &current) != 0 || current.st_ino != doc->fileStat.st_ino || current.st_size != doc->fileStat.st_size ||
+		current.st_mtim.tv_sec != doc->fileStat.st_mtim.tv_sec || current.st_mtim.tv_nsec != doc->fileStat.st_mtim.tv_nsec;
+	if (isFileChanged && doc->changeMap == NULL)
+	{
+		removeDocument(index, true);
+		return NULL;
+	}
+
+	TEXT *headNode = doc->headNode;
+	*xy = doc->xy;
+	*viewStart = doc->viewStart;
+	*savedSize = doc->savedSize;
+	if (doc->changeMap == NULL)
+	{
+		resetChangeMap(fileName, doc->fileSize);
+		openJournal(fileName);
+	}
+	else if (isFileChanged)
+	{
+		restoreChangeMap(doc->changeMap);
+		restartJournal(fileName, headNode);
+		*savedSize = -1;
+	}
+	else
+	{
+		restoreChangeMap(doc->changeMap);
+		openJournal(fileName);
+	}
+	removeDocument(index, false);
+
+	return headNode;
+}
+
+/**
+ * Check if a cached document has unsaved edits.
+ */
+bool isCachedDocumentModified(const char *fileName)
+{
+	int index = findDocument(fileName);
+	return index != -1 && _documents[index].changeMap != NULL;
+}
+
+/**
+ * Find a cached document with unsaved edits and copy its name, returns false if there is none.
+ */
+bool findModifiedDocument(char *fileName)
+{
+	for (int i = 0; i < _documentCount; ++i)
+	{
+		if (_documents[i].changeMap != NULL)
+		{
+			strcpy(fileName, _documents[i].fileName);
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/**
+ * Fill fileNames with the names of the cached documents, the most recently used first.
+ * Returns the number of documents.
+ */
+int getCachedDocuments(const char **fileNames)
+{
+	int count = 0;
+	for (long long lastUse = _useCount + 1; count < _documentCount; ++count)
+	{
+		int newest = -1;
+		for (int i = 0; i < _documentCount; ++i)
+		{
+			if (_documents[i].lastUse < lastUse && (newest == -1 || _documents[i].lastUse > _documents[newest].lastUse))
+			{
+				newest = i;
+			}
+		}
+
+		fileNames[count] = _documents[newest].fileName;
+		lastUse = _documents[newest].lastUse;
+	}
+
+	return count;
+}
+
+/**
+ * Free every cached document.
+ */
+void clearDocumentCache(void)
+{
+	while (_documentCount > 0)
+	{
+		removeDocument(_documentCount - 1, true);
+	}
+}
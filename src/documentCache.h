@@ -0,0 +1,29 @@
+/*
+	Writen by: Oscar Bergström
+	https://github.com/OSCARJFB
+
+	MIT License
+	Copyright (c) 2023 Oscar Bergström
+*/
+
+#ifndef DOCUMENTCACHE_H
+#define DOCUMENTCACHE_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include "textData.h"
+#include "allocHandler.h"
+#include "changeMap.h"
+
+#define DOCUMENT_CACHE_SIZE 9
+#define DOCUMENT_CACHE_MB 64
+
+void setDocumentCacheLimit(const char *megaBytes);
+bool cacheDocument(const char *fileName, TEXT *headNode, coordinates xy, int viewStart, long fileSize, long savedSize);
+TEXT *takeCachedDocument(const char *fileName, coordinates *xy, int *viewStart, long *savedSize);
+bool isCachedDocumentModified(const char *fileName);
+bool findModifiedDocument(char *fileName);
+int getCachedDocuments(const char **fileNames);
+void clearDocumentCache(void);
+
+#endif // DOCUMENTCACHE_H
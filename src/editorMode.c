@@ -6,6 +6,10 @@
 	Copyright (c) 2023 Oscar Bergström
 */
 
+#define _GNU_SOURCE
+#include <unistd.h>
+#include <poll.h>
+#include <limits.h>
 #include "editorMode.h"
 
 textMargins _margins = {MARGIN_SPACE_2, 0, 0, 0};
@@ -13,29 +17,114 @@ int _tabSize = 4;
 int _viewStart = 0;
 int _view = 0;
 long _fileSize = 0;
+static bool _showStats = false;
+static bool _showMemory = false;
+static bool _isFollowing = false;
+static int _hiddenLines = 0, _followLines = 0, _followPrevTop = 0, _followPrevLast = 0;
+static long _followSize = 0;
+static TEXT *_streamTail = NULL;
+static TEXT *_editedNode = NULL;
+static long _foldMark = -1, _lineMark = -1;
+static long _replayLine = 0, _replayLineCount = 0;
+static const char *_modeNames[] = {"edit", "save", "copy", "cut", "paste", "open file", "bracketed paste", "show stats", "show memory", "switch document", "file changed", "follow file", "read stream", "jump", "go to line", "go to top", "go to bottom", "text motion", "fold", "mark fold", "cursor above", "cursor below", "cursor at match", "clear cursors", "search project", "line operation", "mark lines", "record macro", "replay macro", "macro line", "exit"};
 
 static TEXT *createNewNode(int ch);
 static TEXT *addNode(TEXT **headNode, int ch, coordinates xy);
-static TEXT *deleteNode(TEXT **headNode, coordinates xy);
+static TEXT *findNodeAt(TEXT *headNode, coordinates xy);
+static TEXT *insertBuffer(TEXT **headNode, const char *buffer, long size, coordinates xy);
+static TEXT *appendBuffer(TEXT **headNode, TEXT *lastNode, const char *buffer, long size);
+static TEXT *pasteFromTerminal(TEXT **headNode, coordinates xy);
+static TEXT *openFile(TEXT *headNode, char *fileName, const char *path, coordinates *xy);
+static TEXT *reloadFile(TEXT *headNode, const char *fileName);
+static TEXT *loadFileAgain(TEXT *headNode, const char *fileName);
+static TEXT *followFile(TEXT *headNode, char *fileName);
+static TEXT *followAppended(TEXT *headNode, const char *fileName);
+static TEXT *trimFollowWindow(TEXT *headNode);
+static TEXT *loadFollowWindow(TEXT *headNode);
+static TEXT *readStreamInput(TEXT *headNode);
+static TEXT *movePagedWindow(TEXT *headNode);
+static TEXT *loadPageAbove(TEXT *headNode);
+static TEXT *loadPageBelow(TEXT *headNode);
+static TEXT *dropFirstPage(TEXT *headNode);
+static TEXT *dropLastPage(TEXT *headNode);
+static TEXT *deletePageNodes(TEXT *firstNode, long page, int *newLines);
+static TEXT *loadLineWindow(TEXT *headNode, long *line);
+static TEXT *goToLine(TEXT *headNode, long line, coordinates *xy);
+static TEXT *searchProject(TEXT *headNode, char *fileName, coordinates *xy);
+static TEXT *changeLines(TEXT **headNode, coordinates *xy);
+static char *copyLines(TEXT *firstNode, TEXT *endNode, long *size);
+static coordinates jumpInView(TEXT *headNode, int ch, coordinates xy);
+static coordinates fitCursorToText(TEXT *headNode, coordinates xy);
+static TEXT *moveByText(TEXT *headNode, int ch, coordinates xy);
+static TEXT *findLastNode(TEXT *headNode);
+static void showLine(long line, long lineCount);
+static long getLastViewStart(long lineCount);
+static void foldLines(TEXT *headNode, int mode, coordinates *xy);
+static long toggleFold(TEXT *headNode, long line);
+static long markFold(TEXT *headNode, long line);
+static int getIndent(TEXT *node);
+static void moveFolds(long line, long lines);
+static void moveLines(long line, long lines);
+static void shiftMarks(long line, long lines);
+static long shiftMark(long mark, long line, long lines);
+static void clearMarks(void);
+static void markLines(long line);
+static void addCursorLine(TEXT *headNode, coordinates xy, int mode);
+static void addCursorAtMatch(TEXT *headNode, coordinates xy);
+static TEXT *findColumnNode(TEXT *headNode, long line, int column);
+static bool isWordAt(TEXT *node, const char *word, int length);
+static TEXT *editCursors(TEXT **headNode, coordinates xy, int ch);
+static TEXT *insertAtCursor(TEXT **headNode, TEXT *node, TEXT *lastNode, int ch, long offset);
+static TEXT *deleteAtCursor(TEXT **headNode, TEXT *deleted, TEXT *node, long offset);
+static bool isNearListEnd(TEXT *headNode);
+static TEXT *deleteNode(TEXT **headNode, coordinates xy, int *deleted);
 static TEXT *getViewStartNode(TEXT *headNode);
-static TEXT *edit(TEXT **headNode, coordinates xy, int ch);
+static TEXT *edit(TEXT **headNode, coordinates xy, int ch, long *lines);
 static coordinates updateCursor(int ch, coordinates xy, TEXT *editedNode, TEXT *headNode);
 static void saveOnFileChange(TEXT *headNode, char *fileName);
 static void save(TEXT *headNode, char *fileName);
 static void deleteAllNodes(TEXT **headNode);
 static void updateCoordinatesInView(TEXT **headNode);
+static TEXT *skipFold(TEXT *headNode, TEXT *newLine, long *line);
+static void printLineNumber(long line);
+static void printNode(int row, TEXT *node, lexer *lx);
 static void printText(TEXT *headNode, coordinates xy);
+static void printLines(TEXT *headNode, int firstRow, int lastRow);
+static void scrollText(TEXT *headNode, coordinates xy, int lines, int firstRow);
+static void printFollowedLines(TEXT *headNode, coordinates xy);
+static void pinFollowView(void);
+static bool isScrollStep(int ch, int scrolled, int prevY, int prevLeftMargin);
 static void updateMargins(int y, int ch, TEXT *headNode);
 static void updateViewPort(coordinates xy, int ch, TEXT *headNode, TEXT *editedNode);
-static bool isEndNode(int y, TEXT *startNode);
-static inline void setLeftMargin(int NewLines);
-static inline void setRightMargin(int y, TEXT *headNode);
-static inline void setBottomMargin(TEXT *headNode);
+static bool isEndNode(int y, TEXT *headNode, TEXT *startNode);
+static inline void setLeftMargin(long newLines);
+static inline void setRightMargin(int y, TEXT *node, coordinates nodeXy);
+static inline void setBottomMargin(int y, TEXT *node);
 static long getFileSizeFromList(TEXT *headNode);
 static int setMode(int ch);
+static int readPendingKey(void);
+static int waitForKey(TEXT *headNode);
+static int waitForEvent(unsigned int events);
+static bool doIdleWork(TEXT *headNode);
+static int nextKey(TEXT *headNode);
+static int readKey(void);
+static long nextReplayLine(TEXT *headNode);
+static int mapMotionKey(int ch);
+static bool isTextKey(int ch);
 static int countNewLinesInView(TEXT *headNode);
+static int countNewLines(TEXT *headNode);
+static long askNumber(const char *prompt);
+static bool askPattern(const char *prompt, char *pattern);
+static int askLineOperation(void);
+static long pickSearchResult(void);
+static void printSearchResults(long count, long selected, long top);
 static char *newFileName(void);
+static void saveCompressedFile(TEXT *headNode, const char *fileName);
 static char *saveListToBuffer(TEXT *headNode, long fileSize);
+static char *readPastedText(long *size);
+static bool isPasteStart(void);
+static bool pickCachedDocument(char *path);
+static void saveModifiedDocuments(void);
 
 /**
  * Converts text from a buffer into a linked list.
@@ -48,25 +137,28 @@ void *createNodesFromBuffer(char *buffer, long fileSize)
 		return NULL;
 	}
 
-	coordinates xy = {0, 0};
-	TEXT *headNode = NULL;
+	traceBegin("createNodesFromBuffer");
+	TEXT *headNode = NULL, *lastNode = NULL;
 
-	// Add each character from the read file to the list.
-	for (int i = 0; i < fileSize; ++i)
+	// Add each character from the read file to the end of the list.
+	for (long i = 0; i < fileSize; ++i)
 	{
-		(void)addNode(&headNode, buffer[i], xy);
-
-		if (buffer[i] == '\n')
+		TEXT *newNode = createNewNode(buffer[i]);
+		if (lastNode == NULL)
 		{
-			++xy.y;
-			xy.x = 0;
-			continue;
+			headNode = newNode;
 		}
-
-		++xy.x;
+		else
+		{
+			setNext(lastNode, newNode);
+			setPrev(newNode, lastNode);
+		}
+		lastNode = newNode;
 	}
 
+	invalidateLineIndex();
 	updateCoordinatesInView(&headNode);
+	traceEnd("createNodesFromBuffer");
 	return headNode;
 }
 
@@ -77,14 +169,9 @@ void *createNodesFromBuffer(char *buffer, long fileSize)
 static long getFileSizeFromList(TEXT *headNode)
 {
 	long fileSize = 0;
-	for (long i = 0; headNode != NULL; ++i)
+	for (; headNode != NULL; headNode = nextNode(headNode))
 	{
-		headNode = headNode->next;
-		if (headNode->next == NULL)
-		{
-			fileSize = i + 1;
-			break;
-		}
+		++fileSize;
 	}
 
 	return fileSize;
@@ -94,12 +181,33 @@ static long getFileSizeFromList(TEXT *headNode)
  * Save the TEXT list to a file.
  * Data will be stored in whatever text string the file name pointer stores.
  * If this pointer is NULL, request a new file name from the user. 
+ * When the file is the one the text was loaded from, only the edited parts are written.
  */
 static void save(TEXT *headNode, char *fileName)
 {
-	FILE *fp = NULL;
-	_fileSize = getFileSizeFromList(headNode);
-	char *buffer = saveListToBuffer(headNode, _fileSize);
+	// A paged file can't be written from the list, it's saved over the file it was read from.
+	if (isPaged())
+	{
+		if (savePages(fileName, headNode))
+		{
+			_fileSize = getFileSizeFromList(headNode);
+			watchFile(fileName);
+			return;
+		}
+
+		wclear(stdscr);
+		printw("%s was changed on disk and can't be saved, press any key to continue", fileName);
+		wgetch(stdscr);
+		return;
+	}
+
+	if (saveChangedRanges(fileName, headNode))
+	{
+		_fileSize = getDocumentSize();
+		resetJournal();
+		watchFile(fileName);
+		return;
+	}
 
 	if (fileName == NULL)
 	{
@@ -108,18 +216,67 @@ static void save(TEXT *headNode, char *fileName)
 		strcpy(fileName, newName);
 	}
 
+	if (getCompression(fileName) != COMPRESSION_NONE)
+	{
+		saveCompressedFile(headNode, fileName);
+		return;
+	}
+
+	FILE *fp = NULL;
+	_fileSize = getFileSizeFromList(headNode);
+	char *buffer = saveListToBuffer(headNode, _fileSize);
+
 	fp = fopen(fileName, "w");
 
 	if (fp != NULL)
 	{
-		fprintf(fp, "%s", buffer);
+		if (buffer != NULL)
+		{
+			fwrite(buffer, sizeof(char), _fileSize, fp);
+		}
 		fclose(fp);
 		fp = NULL;
+		resetJournal();
+		resetChangeMap(fileName, _fileSize);
+		watchFile(fileName);
+	}
+
+	if (buffer != NULL)
+	{
+		trackMemory(MEM_BUFFERS, -(_fileSize + 1));
 	}
 	free(buffer);
 	buffer = NULL;
 }
 
+/**
+ * Save the list compressed, the text is streamed from the list to gzip or zstd so it's never copied to a buffer.
+ * A file that is still being decompressed isn't saved, the text that hasn't been read yet would be lost.
+ */
+static void saveCompressedFile(TEXT *headNode, const char *fileName)
+{
+	if (getStreamFd() != -1)
+	{
+		wclear(stdscr);
+		printw("%s is still being decompressed and can't be saved yet, press any key to continue", fileName);
+		wgetch(stdscr);
+		return;
+	}
+
+	if (!saveCompressed(fileName, headNode))
+	{
+		wclear(stdscr);
+		printw("%s could not be compressed, press any key to continue", fileName);
+		wgetch(stdscr);
+		return;
+	}
+
+	_fileSize = getFileSizeFromList(headNode);
+	resetJournal();
+	resetChangeMap(NULL, _fileSize);
+	watchFile(fileName);
+}
+
 /**
  * Will convert the TEXT list into a regular buffer,
  * this buffer will be needed when saving the text. 
@@ -131,13 +288,14 @@ static char *saveListToBuffer(TEXT *headNode, long fileSize)
 		return NULL;
 	}
 
-	char *buffer = memAlloc(malloc((fileSize + 2) * sizeof(char)), fileSize * sizeof(char) + 1);
-	for (int i = 0; headNode != NULL && i <= fileSize; headNode = headNode->next)
+	char *buffer = memAlloc(malloc((fileSize + 1) * sizeof(char)), (fileSize + 1) * sizeof(char));
+	trackMemory(MEM_BUFFERS, fileSize + 1);
+	for (long i = 0; headNode != NULL && i < fileSize; headNode = nextNode(headNode))
 	{
 		buffer[i++] = headNode->ch;
 	}
 
-	buffer[++fileSize] = '\0';
+	buffer[fileSize] = '\0';
 
 	return buffer;
 }
@@ -149,13 +307,13 @@ static char *saveListToBuffer(TEXT *headNode, long fileSize)
 static void saveOnFileChange(TEXT *headNode, char *fileName)
 {
 	long currentFileSize = getFileSizeFromList(headNode);
-	if (currentFileSize == _fileSize)
+	if (isPaged() ? !isPagedFileEdited() : currentFileSize == _fileSize)
 	{
 		return;
 	}
 
 	wclear(stdscr);
-	printw("%s have been modified, would you like to save? (Y/N)", fileName);
+	printw("%s have been modified, would you like to save? (Y/N)", fileName != NULL ? fileName : "The text");
 	int ch = wgetch(stdscr);
 	if (ch == 'y' || ch == 'Y')
 	{
@@ -177,7 +335,7 @@ static char *newFileName(void)
 {
 	char *fileName = memAlloc(malloc(sizeof(char) * FILENAME_SIZE), sizeof(char) * FILENAME_SIZE);
 	int index = 0;
-	for (int ch = 0; ch != '\n' && index < FILENAME_SIZE; ch = wgetch(stdscr))
+	for (int ch = 0; ch != '\n' && index < FILENAME_SIZE; ch = readKey())
 	{
 		if (ch != '\0')
 		{
@@ -204,6 +362,172 @@ static char *newFileName(void)
 	return fileName;
 }
 
+/**
+ * Request a number, the prompt is left with ESC or by not giving any number.
+ * Returns the number or -1 if no number was given.
+ */
+static long askNumber(const char *prompt)
+{
+	char number[20];
+	int length = 0;
+	for (int ch = 0; ch != '\n'; ch = readKey())
+	{
+		if (ch == ESC_KEY)
+		{
+			return -1;
+		}
+
+		if (ch == KEY_BACKSPACE && length > 0)
+		{
+			--length;
+		}
+		else if (ch >= '0' && ch <= '9' && length < (int)sizeof(number) - 1)
+		{
+			number[length++] = ch;
+		}
+
+		wclear(stdscr);
+		printw("%s%.*s", prompt, length, number);
+		wrefresh(stdscr);
+	}
+
+	number[length] = '\0';
+	return length > 0 ? strtol(number, NULL, 10) : -1;
+}
+
+/**
+ * Request a pattern, the prompt is left with ESC or by not giving any pattern.
+ * Returns false if no pattern was given.
+ */
+static bool askPattern(const char *prompt, char *pattern)
+{
+	int length = 0;
+	for (int ch = 0; ch != '\n'; ch = readKey())
+	{
+		if (ch == ESC_KEY)
+		{
+			return false;
+		}
+
+		if (ch == KEY_BACKSPACE && length > 0)
+		{
+			--length;
+		}
+		else if (ch >= ' ' && ch <= '~' && length < SEARCH_PATTERN_SIZE - 1)
+		{
+			pattern[length++] = ch;
+		}
+
+		wclear(stdscr);
+		printw("%s%.*s", prompt, length, pattern);
+		wrefresh(stdscr);
+	}
+
+	pattern[length] = '\0';
+	return length > 0;
+}
+
+/**
+ * Request the operation to apply to the lines, the prompt is left with ESC or any other key.
+ * Returns the operation or -1 if none was picked.
+ */
+static int askLineOperation(void)
+{
+	wclear(stdscr);
+	printw("Lines: s = sort, u = unique, r = reverse, k = keep matching, d = drop matching");
+	wrefresh(stdscr);
+
+	switch (readKey())
+	{
+		case 's':
+			return LINES_SORT;
+		case 'u':
+			return LINES_UNIQUE;
+		case 'r':
+			return LINES_REVERSE;
+		case 'k':
+			return LINES_KEEP;
+		case 'd':
+			return LINES_DROP;
+	}
+
+	return -1;
+}
+
+/**
+ * Let the user pick a search result while the search is running, the list is printed again whenever new results have come in.
+ * Returns the index of the picked result or -1 if the list was left with ESC.
+ */
+static long pickSearchResult(void)
+{
+	long selected = 0, top = 0, printedCount = -1;
+	bool wasDone = false;
+	for (int ch = EVENT_KEY;; ch = waitForEvent(EVENT_SEARCH_RESULTS))
+	{
+		long count = getResultCount(), rows = _view > 1 ? _view - 1 : 1;
+		bool isDone = isSearchDone();
+		if (ch == ESC_KEY)
+		{
+			selected = -1;
+			break;
+		}
+		else if (ch == '\n' && count > 0)
+		{
+			break;
+		}
+		else if (ch == KEY_UP || ch == KEY_PPAGE)
+		{
+			selected -= ch == KEY_UP ? 1 : rows;
+		}
+		else if (ch == KEY_DOWN || ch == KEY_NPAGE)
+		{
+			selected += ch == KEY_DOWN ? 1 : rows;
+		}
+		else if (ch == EVENT_KEY && count == printedCount && isDone == wasDone)
+		{
+			continue;
+		}
+
+		selected = selected >= count ? count - 1 : selected;
+		selected = selected < 0 ? 0 : selected;
+		top = selected < top ? selected : selected >= top + rows ? selected - rows + 1 : top;
+		printSearchResults(count, selected, top);
+		printedCount = count;
+		wasDone = isDone;
+	}
+
+	return selected;
+}
+
+/**
+ * Print the results that fit in the view below a status line, the selected result is printed reversed.
+ */
+static void printSearchResults(long count, long selected, long top)
+{
+	int width = getmaxx(stdscr);
+	wclear(stdscr);
+	printw("%ld matches%s, Enter opens and ESC leaves", count, isSearchDone() ? "" : " so far");
+	for (long i = top, row = 1; i < count && row < _view; ++i, ++row)
+	{
+		searchResult result;
+		if (!getSearchResult(i, &result))
+		{
+			break;
+		}
+
+		if (i == selected)
+		{
+			wattron(stdscr, A_REVERSE);
+		}
+		mvwprintw(stdscr, row, 0, "%.*s", width, "");
+		mvwprintw(stdscr, row, 0, "%s:%ld: ", result.path, result.line);
+		int used = getcurx(stdscr);
+		mvwprintw(stdscr, row, used, "%.*s", width > used ? width - used : 0, result.text);
+		wattroff(stdscr, A_REVERSE);
+	}
+	wrefresh(stdscr);
+}
+
 /**
  * Iterate the list and delete all nodes.
  * After calling free each pointer should be set to NULL. 
@@ -217,13 +541,20 @@ static void deleteAllNodes(TEXT **headNode)
 
 	// Delete and free every single node.
 	TEXT *temp = NULL;
+	long deleted = 0;
 	while(*headNode != NULL)
 	{
 		temp = *headNode;
-		*headNode = (*headNode)->next;
-		free(temp);
+		*headNode = nextNode(*headNode);
+		freeNode(temp);
 		temp = NULL;
+		++deleted;
 	}
+	trackNodes(-deleted);
+	invalidateLineIndex();
+	clearViewMap();
+	clearCursors();
+	_editedNode = NULL;
 }
 
 /**
@@ -232,70 +563,162 @@ static void deleteAllNodes(TEXT **headNode)
  */
 static TEXT *createNewNode(int ch)
 {
-	TEXT *newNode = memAlloc(malloc(sizeof(TEXT)), sizeof(TEXT));
+	TEXT *newNode = allocNode();
+	trackNodes(1);
 	newNode->ch = ch;
-	newNode->next = NULL;
-	newNode->prev = NULL;
+	setNext(newNode, NULL);
+	setPrev(newNode, NULL);
 	return newNode;
 }
 
+/**
+ * Find the node currently placed at the cursor coordinates (xy), only nodes inside the view are considered.
+ * Returns NULL if no node is placed at xy, which means that new text should be added at the end of the list.
+ */
+static TEXT *findNodeAt(TEXT *headNode, coordinates xy)
+{
+	return headNode != NULL ? getNodeAt(xy) : NULL;
+}
+
 /**
  * Check the list for a spefic coordinates marking the current cursor position. 
  * At this point the function will add a new character. Returns a pointer to the newly added node. 
  */
 static TEXT *addNode(TEXT **headNode, int ch, coordinates xy)
 {
-	TEXT *newNode = createNewNode(ch), *node = *headNode, *prevNode = NULL;
+	TEXT *newNode = createNewNode(ch), *node = NULL;
 	if (*headNode == NULL)
 	{
 		*headNode = newNode;
 		return newNode;
 	}
 
-	// Add the node and set it as the new headNode of the list.
-	if (node->x == xy.x && node->y == xy.y && _viewStart == 0)
+	node = findNodeAt(*headNode, xy);
+
+	// Add the node at the end of the list.
+	if (node == NULL)
 	{
-		node->prev = newNode;
-		*headNode = newNode;
-		newNode->next = node;
+		for (node = *headNode; nextNode(node) != NULL; node = nextNode(node))
+		{
+		}
+		setNext(node, newNode);
+		setPrev(newNode, node);
 		return newNode;
 	}
-	
-	// Add the node somewhere in the middle of the list.
-	for(int newLines = 0; node->next != NULL;)
-	{	 
-		newLines += node->ch == '\n' ? 1 : 0;
-		node = node->next;
-		if(newLines < _viewStart)
+
+	// Add the node before the node at xy, this might make it the new headNode of the list.
+	setNext(newNode, node);
+	setPrev(newNode, prevNode(node));
+	if (prevNode(node) != NULL)
+	{
+		setNext(prevNode(node), newNode);
+	}
+	else
+	{
+		*headNode = newNode;
+	}
+	setPrev(node, newNode);
+	return newNode;
+}
+
+/**
+ * Insert a whole buffer at the cursor position (xy) as one operation.
+ * The nodes are chained up first and then linked into the list, the insert position is only searched for once.
+ * The line index is left to the caller, which invalidates it after the insert is recorded. Returns a pointer to the last inserted node.
+ */
+static TEXT *insertBuffer(TEXT **headNode, const char *buffer, long size, coordinates xy)
+{
+	if (buffer == NULL || size <= 0)
+	{
+		return NULL;
+	}
+
+	// Create the chain of new nodes.
+	TEXT *first = createNewNode(buffer[0]), *last = first;
+	for (long i = 1; i < size; ++i)
+	{
+		TEXT *newNode = createNewNode(buffer[i]);
+		setPrev(newNode, last);
+		setNext(last, newNode);
+		last = newNode;
+	}
+
+	if (*headNode == NULL)
+	{
+		*headNode = first;
+		return last;
+	}
+
+	// Link the chain in front of the node at xy, or at the end of the list.
+	TEXT *node = findNodeAt(*headNode, xy);
+	if (node == NULL)
+	{
+		for (node = *headNode; nextNode(node) != NULL; node = nextNode(node))
 		{
-			continue; 
 		}
+		setNext(node, first);
+		setPrev(first, node);
+		return last;
+	}
+
+	setPrev(first, prevNode(node));
+	if (prevNode(node) != NULL)
+	{
+		setNext(prevNode(node), first);
+	}
+	else
+	{
+		*headNode = first;
+	}
+	setNext(last, node);
+	setPrev(node, last);
+	return last;
+}
+
+/**
+ * Add a buffer to the end of the list, lastNode is the last node of the list or NULL if it isn't known.
+ * Returns a pointer to the new last node.
+ */
+static TEXT *appendBuffer(TEXT **headNode, TEXT *lastNode, const char *buffer, long size)
+{
+	coordinates end = {-1, -1};
+	TEXT *first = NULL, *last = insertBuffer(&first, buffer, size, end);
+	if (first == NULL)
+	{
+		return lastNode;
+	}
+
+	if (*headNode == NULL)
+	{
+		*headNode = first;
+		return last;
+	}
 
-		if (node->x == xy.x && node->y == xy.y && node->prev != NULL)
+	if (lastNode == NULL)
+	{
+		for (lastNode = *headNode; nextNode(lastNode) != NULL; lastNode = nextNode(lastNode))
 		{
-			node->prev->next = newNode;
-			newNode->prev = node->prev;
-			node->prev = newNode;
-			newNode->next = node;
-			return newNode; 
 		}
 	}
-
-	// Add the node at the end of the list.
-	prevNode = node;
-	node->next = newNode;
-	newNode->prev = prevNode;
-	return newNode;
+	setNext(lastNode, first);
+	setPrev(first, lastNode);
+	if (memchr(buffer, '\n', size) != NULL)
+	{
+		invalidateLineIndex();
+	}
+	return last;
 }
 
 /**
  * This function will delete an item in the TEXT list.
  * It takes a list and searches the position of the list item to be deleted. It does so by looking at the cursor input (xy).
  * When found it will delete the item and relink the list. Returns NULL or a pointer to the prev node of the deleted node.  
+ * The character of the deleted node is put in deleted, 0 if nothing was deleted.
  */
-static TEXT *deleteNode(TEXT **headNode, coordinates xy)
+static TEXT *deleteNode(TEXT **headNode, coordinates xy, int *deleted)
 {
 	// We can't free/delete a node which is NULL or if at end of coordinates.
+	*deleted = 0;
 	if (*headNode == NULL || (_viewStart == 0 && xy.y == 0 && xy.x == _margins.left))
 	{
 		return NULL;
@@ -305,106 +728,136 @@ static TEXT *deleteNode(TEXT **headNode, coordinates xy)
 	TEXT *node = *headNode;
 	
 	// If both prev and next are NULL this is the only node in the list.
-	if (node->prev == NULL && node->next == NULL)
+	if (prevNode(node) == NULL && nextNode(node) == NULL)
 	{
-		free(*headNode);
+		*deleted = node->ch;
+		freeNode(*headNode);
 		*headNode = NULL;
+		trackNodes(-1);
+		invalidateLineIndex();
 		return NULL;
 	}
 	
-	// Find the node to be deleted. continue untill inside of the view. 
-	for(int newLines = 0; node->next != NULL; node = node->next)
-	{	 
-		newLines += node->ch == '\n' ? 1 : 0;
-		if(newLines < _viewStart)
-		{
-			continue; 
-		}		
-		
-		// Is a node in the middle of the list.
-		if (node->x == xy.x && node->y == xy.y)
-		{
-			node = node->prev;
-			isEndNode = false;
-			break;
-		}
-
-		// Is the node just before the last node in the list.
-		if (node->next->x == xy.x && node->next->y == xy.y && node->next->next == NULL)
-		{
-			isEndNode = false;
-			break;
-		}
+	// The node in front of the cursor is deleted, or the last node when the cursor is after the end of the text.
+	TEXT *atCursor = findNodeAt(*headNode, xy);
+	isEndNode = atCursor == NULL;
+	node = atCursor != NULL ? prevNode(atCursor) : findLastNode(*headNode);
+	if (node == NULL)
+	{
+		return NULL;
 	}
 
 	// Link the nodes depending on it being the last node or a node in the middle of the list.
 	if (isEndNode)
 	{
-		node->prev->next = NULL;
+		setNext(prevNode(node), NULL);
 	}
 	else if (!isEndNode)
 	{
-		if (node->prev != NULL && node->next != NULL)
+		if (prevNode(node) != NULL && nextNode(node) != NULL)
 		{
-			node->prev->next = node->next;
-			node->next->prev = node->prev;
+			setNext(prevNode(node), nextNode(node));
+			setPrev(nextNode(node), prevNode(node));
 		}
-		else if (node->prev == NULL && node->next != NULL)
+		else if (prevNode(node) == NULL && nextNode(node) != NULL)
 		{
-			node->next->prev = NULL;
-			*headNode = node->next;
+			setPrev(nextNode(node), NULL);
+			*headNode = nextNode(node);
 		}
 	}
 	
-	TEXT *editedNode = node->prev == NULL ? NULL : node->prev; 
-	free(node);
+	TEXT *editedNode = prevNode(node) == NULL ? NULL : prevNode(node); 
+	*deleted = node->ch;
+	if (node->ch == '\n')
+	{
+		removeIndexedLine(node);
+	}
+	freeNode(node);
 	node = NULL;
+	trackNodes(-1);
 	return editedNode;
 }
 
 /**
  * Will update the coordinates of the text inside the bounderies of the terminal view.
  * This needs to be done to display the TEXT list nodes at their correct location. 
- * We loop the list until we find the starting point (current view), then we update each item until the end of the view is reached.
+ * The starting point (current view) is found in the line index, then we update each item until the end of the view is reached.
+ * The coordinates are kept in the view map, the nodes keep no coordinates of their own.
  */
 static void updateCoordinatesInView(TEXT **headNode)
 {
+	clearViewMap();
 	if(*headNode == NULL)
 	{
 		return;
 	}
 
-	int x = _margins.left, y = 0, newLines = 0, nLinesInView = 0;
-	for(TEXT *node = *headNode; node != NULL; node = node->next)
+	int x = _margins.left, y = 0, nLinesInView = 0;
+	long line = _viewStart;
+	for(TEXT *node = findLineStart(*headNode, _viewStart); node != NULL && nLinesInView != _view; node = nextNode(node))
 	{
-		if(newLines >= _viewStart)
-		{
-			nLinesInView += node->ch == '\n' ? 1 : 0;
-			node->x = x;
-			node->y = y;
+		nLinesInView += node->ch == '\n' ? 1 : 0;
+		placeNode(node, x, y);
 
-			if(node->ch == '\t')
-			{
-				x += _tabSize;
-			}
-			else
-			{
-				++x;
-			}
+		if(node->ch == '\t')
+		{
+			x += _tabSize;
+		}
+		else
+		{
+			++x;
+		}
 
-			if(node->ch == '\n')
-			{
-				x = _margins.left;
-				++y;
-			}
+		if(node->ch == '\n')
+		{
+			x = _margins.left;
+			++y;
+			node = skipFold(*headNode, node, &line);
 		}
+	}
+}
 
-		newLines += node->ch == '\n' ? 1 : 0;
-		if(nLinesInView == _view)
+/**
+ * Skip the lines folded under a line, newLine is the newline ending the line and line is moved to the next line shown.
+ * Returns the newline ending the last folded line, or newLine if the line holds no fold.
+ */
+static TEXT *skipFold(TEXT *headNode, TEXT *newLine, long *line)
+{
+	long end = getFoldEnd(*line);
+	TEXT *foldEnd = end != -1 ? findNewLine(headNode, end) : NULL;
+	*line = foldEnd != NULL ? end + 1 : *line + 1;
+	return foldEnd != NULL ? foldEnd : newLine;
+}
+
+/**
+ * Print the number of a line of the list, a line holding a closed fold is marked with a + and an opened fold with a -.
+ */
+static void printLineNumber(long line)
+{
+	const char *format = getFoldEnd(line) != -1 ? "%ld+" : isFoldStart(line) ? "%ld-" : "%ld";
+	printw(format, line + _hiddenLines + 1);
+}
+
+/**
+ * Print a node at a row of the view, a node holding an extra cursor is printed in reverse.
+ */
+static void printNode(int row, TEXT *node, lexer *lx)
+{
+	chtype attributes = getHighlight(lx, node);
+	int x = getNodeCoordinates(node).x;
+	if (isCursorNode(node))
+	{
+		mvwaddch(stdscr, row, x, (node->ch == '\n' || node->ch == '\t' ? ' ' : node->ch) | A_REVERSE);
+
+		// The line numbers are printed where the newline leaves the terminal cursor.
+		if (node->ch == '\n')
 		{
-			break;
+			waddch(stdscr, '\n');
 		}
+		return;
 	}
+
+	mvwaddch(stdscr, row, x, node->ch | attributes);
 }
 
 /**
@@ -413,36 +866,38 @@ static void updateCoordinatesInView(TEXT **headNode)
  */
 static void printText(TEXT *headNode, coordinates xy)
 {
-	int lineNumber = 0, nLinesInView = 0;
+	long lineNumber = _viewStart;
+	int nLinesInView = 0;
 	bool nlFlag = true, pFlag = true; 
+	lexer lx;
 
 	if (headNode == NULL)
 	{
 		clear();
-		printw("%d", lineNumber + 1);
+		printw("%d", _hiddenLines + 1);
 		move(xy.y, xy.x);
-		refresh();
 		return;
 	}
 
 	clear();
-	for (TEXT *node = headNode; node != NULL; node = node->next)
+	for (TEXT *node = findLineStart(headNode, _viewStart); node != NULL; node = nextNode(node))
 	{
-		if (lineNumber >= _viewStart && pFlag)
+		if (pFlag)
 		{
 			if (nlFlag)
 			{
 				nlFlag = false;
-				printw("%d", lineNumber + 1);
+				printLineNumber(lineNumber);
+				lx = beginHighlight(headNode, lineNumber);
 				++nLinesInView;
 			}
-			mvwaddch(stdscr, node->y, node->x, node->ch);
+			printNode(getNodeCoordinates(node).y, node, &lx);
 		}
 
 		if (node->ch == '\n')
 		{
 			nlFlag = true;
-			++lineNumber;
+			node = skipFold(headNode, node, &lineNumber);
 		}
 
 		if (nLinesInView == _view)
@@ -452,18 +907,288 @@ static void printText(TEXT *headNode, coordinates xy)
 			{
 				break; 
 			}
-			mvwaddch(stdscr, node->y, node->x, node->ch);
+			printNode(getNodeCoordinates(node).y, node, &lx);
 		}
 	}
 
 	if (nlFlag && nLinesInView != _view)
 	{
 
-		printw("%d", lineNumber + 1);
+		printLineNumber(lineNumber);
 	}
 
 	move(xy.y, xy.x);
-	refresh();
+}
+
+/**
+ * Print the lines placed between two rows of the terminal view, line numbers included.
+ * Rows below the end of the text are left empty. 
+ */
+static void printLines(TEXT *headNode, int firstRow, int lastRow)
+{
+	// Find the first node of the line placed at the first row, the row is left empty if the text ends above it.
+	long lineNumber = getLineAtRow(_viewStart, firstRow), lineCount = getLineCount(headNode);
+	TEXT *node = findLineStart(headNode, lineNumber);
+
+	for (int row = firstRow; row <= lastRow; ++row)
+	{
+		move(row, 0);
+		clrtoeol();
+		if (lineNumber > lineCount)
+		{
+			continue;
+		}
+
+		printLineNumber(lineNumber);
+		lexer lx = beginHighlight(headNode, lineNumber);
+		for (; node != NULL && node->ch != '\n'; node = nextNode(node))
+		{
+			printNode(row, node, &lx);
+		}
+
+		if (node != NULL && isCursorNode(node))
+		{
+			printNode(row, node, &lx);
+		}
+
+		// The last line doesn't end with a newline.
+		if (node == NULL)
+		{
+			lineNumber = lineCount + 1;
+			continue;
+		}
+		node = nextNode(skipFold(headNode, node, &lineNumber));
+	}
+}
+
+/**
+ * Scroll the text in the terminal view by a number of lines, using the terminals scrolling region.
+ * Only the rows starting at firstRow (or the top row when scrolling backwards) are printed again.
+ */
+static void scrollText(TEXT *headNode, coordinates xy, int lines, int firstRow)
+{
+	scrollok(stdscr, TRUE);
+	setscrreg(0, _view - 1);
+	scrl(lines);
+	scrollok(stdscr, FALSE);
+
+	if (lines < 0)
+	{
+		printLines(headNode, 0, -lines - 1);
+	}
+	else
+	{
+		printLines(headNode, firstRow, _view - 1);
+	}
+
+	move(xy.y, xy.x);
+}
+
+/**
+ * Place the last line of the followed file at the bottom of the view.
+ */
+static void pinFollowView(void)
+{
+	_viewStart = _followLines - _hiddenLines + 1 - _view;
+	_viewStart = _viewStart > 0 ? _viewStart : 0;
+}
+
+/**
+ * Print the lines added to a followed file, the lines that were already printed are scrolled up instead.
+ * The whole view is printed if it moved too far.
+ */
+static void printFollowedLines(TEXT *headNode, coordinates xy)
+{
+	int top = _hiddenLines + _viewStart, scrolled = top - _followPrevTop, firstRow = _followPrevLast - top;
+	if (_followPrevTop < 0 || scrolled < 0 || scrolled >= _view || firstRow < 0 || _showStats || _showMemory)
+	{
+		printText(headNode, xy);
+		return;
+	}
+
+	if (scrolled > 0)
+	{
+		scrollText(headNode, xy, scrolled, firstRow);
+		return;
+	}
+
+	printLines(headNode, firstRow, _view - 1);
+	move(xy.y, xy.x);
+}
+
+/**
+ * Check if the last key moved the view a single line, without changing any text that is still in view.
+ * This is true when navigating past the top or bottom row, or when a newline is added at the bottom row.
+ */
+static bool isScrollStep(int ch, int scrolled, int prevY, int prevLeftMargin)
+{
+	if (_margins.left != prevLeftMargin || _showStats || _showMemory)
+	{
+		return false;
+	}
+
+	if (ch == KEY_DOWN || ch == KEY_UP)
+	{
+		return scrolled == 1 || scrolled == -1;
+	}
+
+	return ch == '\n' && scrolled == 1 && prevY == _view - 1;
+}
+
+/**
+ * A key ncurses has already read from the terminal, ERR if there is none. Keys already read wouldn't wake up poll.
+ */
+static int readPendingKey(void)
+{
+	nodelay(stdscr, TRUE);
+	int ch = getch();
+	nodelay(stdscr, FALSE);
+	return ch;
+}
+
+/**
+ * Wait for the next key without blocking changes to the open file or streamed text from being noticed.
+ * Returns FILE_CHANGED_KEY if the file was changed on disk while waiting, STREAM_INPUT_KEY if more text was streamed.
+ * Once no key has come for IDLE_DELAY_MS the idle work is done a step at a time, a step is never started while anything else is ready.
+ */
+static int waitForKey(TEXT *headNode)
+{
+	int ch = readPendingKey();
+	if (ch != ERR)
+	{
+		return mapMotionKey(ch);
+	}
+
+	setIdleTimer(IDLE_DELAY_MS);
+	bool isIdle = false;
+	struct pollfd fds[4] = {{getTerminalFd(), POLLIN, 0}, {getFileWatchFd(), POLLIN, 0}, {getStreamFd(), POLLIN, 0}, {getIdleTimerFd(), POLLIN, 0}};
+	for (int ready = 0; (ready = poll(fds, 4, isIdle ? 0 : -1)) >= 0 && !(fds[0].revents & POLLIN);)
+	{
+		if (ready == 0)
+		{
+			isIdle = doIdleWork(headNode);
+			continue;
+		}
+
+		// A stream that was closed by the writer counts as readable, reading it finds the end.
+		if (fds[2].revents & (POLLIN | POLLHUP | POLLERR))
+		{
+			return STREAM_INPUT_KEY;
+		}
+
+		if ((fds[1].revents & POLLIN) && readFileEvents() && getFileChange() != FILE_UNCHANGED)
+		{
+			return FILE_CHANGED_KEY;
+		}
+
+		isIdle = ((fds[3].revents & POLLIN) && readIdleTimer()) || isIdle;
+	}
+
+	return mapMotionKey(getch());
+}
+
+/**
+ * Wait for a key or for one of the events posted by a background task, EVENT_KEY is returned for the events.
+ * Without the eventfd the events are looked for every SEARCH_REFRESH_MS.
+ */
+static int waitForEvent(unsigned int events)
+{
+	int ch = readPendingKey();
+	if (ch != ERR)
+	{
+		return ch;
+	}
+
+	struct pollfd fds[2] = {{getTerminalFd(), POLLIN, 0}, {getEventFd(), POLLIN, 0}};
+	for (;;)
+	{
+		// An event posted before the wait doesn't wake up poll again, it's still waiting to be taken.
+		if (takeEvents(events) != 0)
+		{
+			return EVENT_KEY;
+		}
+
+		int ready = poll(fds, 2, getEventFd() != -1 ? -1 : SEARCH_REFRESH_MS);
+		if (ready == 0)
+		{
+			return EVENT_KEY;
+		}
+
+		if (ready < 0 || (fds[0].revents & POLLIN))
+		{
+			return getch();
+		}
+	}
+}
+
+/**
+ * One step of the work that is left until no key is pressed, the lines below the view are lexed ahead for highlighting.
+ * A view highlighted from a guessed state is printed again once the lexing reaches it. Returns false when there's nothing left to do.
+ */
+static bool doIdleWork(TEXT *headNode)
+{
+	bool isLexing = lexAhead(headNode, IDLE_LEX_LINES);
+	if (!isGuessVerified() || _showStats || _showMemory)
+	{
+		return isLexing;
+	}
+
+	coordinates xy = {0, 0};
+	getyx(stdscr, xy.y, xy.x);
+	printText(headNode, xy);
+	refresh();
+	return isLexing;
+}
+
+/**
+ * The next key for the editor, taken from the macro being replayed or waited for. Typed keys are added to the macro being recorded.
+ */
+static int nextKey(TEXT *headNode)
+{
+	if (isReplaying())
+	{
+		return replayKey();
+	}
+
+	int ch = waitForKey(headNode);
+	return ch == FILE_CHANGED_KEY || ch == STREAM_INPUT_KEY ? ch : recordKey(ch);
+}
+
+/**
+ * Read a key following another one, like the key after ESC or the keys of a prompt. Macros replay and record these keys as well.
+ */
+static int readKey(void)
+{
+	return isReplaying() ? replayKey() : recordKey(wgetch(stdscr));
+}
+
+/**
+ * Map Ctrl + arrow keys to the word and paragraph motion keys, their key codes are only known by the terminal description.
+ */
+static int mapMotionKey(int ch)
+{
+	static int keys[4] = {0, 0, 0, 0};
+	static const char *names[4] = {"kLFT5", "kRIT5", "kUP5", "kDN5"};
+	static bool isMapped = false;
+	if (!isMapped)
+	{
+		for (int i = 0; i < 4; ++i)
+		{
+			char *sequence = tigetstr(names[i]);
+			keys[i] = sequence != NULL && sequence != (char *)-1 ? key_defined(sequence) : 0;
+		}
+		isMapped = true;
+	}
+
+	for (int i = 0; i < 4; ++i)
+	{
+		if (keys[i] > 0 && ch == keys[i])
+		{
+			return WORD_LEFT_KEY + i;
+		}
+	}
+
+	return ch;
 }
 
 /**
@@ -471,14 +1196,41 @@ static void printText(TEXT *headNode, coordinates xy)
  */
 static int setMode(int ch)
 {
+	if (ch == FILE_CHANGED_KEY)
+	{
+		return FILE_CHANGED;
+	}
+
+	if (ch == STREAM_INPUT_KEY)
+	{
+		return READ_STREAM;
+	}
+
+	if (ch == KEY_PPAGE || ch == KEY_NPAGE || ch == KEY_HOME || ch == KEY_END)
+	{
+		return JUMP;
+	}
+
+	if (ch >= WORD_LEFT_KEY && ch <= PARAGRAPH_DOWN_KEY)
+	{
+		return TEXT_MOTION;
+	}
+
+	if (ch == MACRO_LINE_KEY)
+	{
+		return MACRO_LINE;
+	}
+
 	if(ch != ESC_KEY)
 	{
 		return EDIT;
 	}
 
-	ch = wgetch(stdscr);
+	ch = readKey();
 	switch(ch)
 	{
+		case '[':
+			return isPasteStart() ? BRACKETED_PASTE : EDIT;
 		case 's':
 			return SAVE;
 		case 'y':
@@ -491,51 +1243,220 @@ static int setMode(int ch)
 			return OPEN_FILE;
 		case 'e':
 			return EXIT;
+		case 't':
+			return SHOW_STATS;
+		case 'm':
+			return SHOW_MEMORY;
+		case 'b':
+			return SWITCH_DOCUMENT;
+		case 'f':
+			return FOLLOW_FILE;
+		case 'g':
+			return GO_TO_LINE;
+		case '<':
+			return GO_TO_TOP;
+		case '>':
+			return GO_TO_BOTTOM;
+		case 'z':
+			return FOLD;
+		case 'v':
+			return MARK_FOLD;
+		case 'k':
+			return CURSOR_ABOVE;
+		case 'j':
+			return CURSOR_BELOW;
+		case 'n':
+			return CURSOR_AT_MATCH;
+		case 'x':
+			return CLEAR_CURSORS;
+		case '/':
+			return SEARCH_PROJECT;
+		case 'l':
+			return LINE_OPERATION;
+		case 'a':
+			return MARK_LINES;
+		case 'q':
+			return RECORD_MACRO;
+		case 'r':
+			return REPLAY_MACRO;
 	}
 
 	return EDIT;
 }
 
 /**
- * This function will set the left margin. 
- * The size of the left margin is decided depending on the amount of rows in the file.  
+ * Read the rest of a control sequence following ESC + [.
+ * Returns true if the sequence marks the start of a bracketed paste.
+ */
+static bool isPasteStart(void)
+{
+	char sequence[16];
+	int length = 0;
+
+	// A control sequence ends with a character in the range @ to ~.
+	for (int ch = wgetch(stdscr); ch != ERR; ch = wgetch(stdscr))
+	{
+		if (length < (int)sizeof(sequence) - 1)
+		{
+			sequence[length++] = ch;
+		}
+
+		if (ch >= '@' && ch <= '~')
+		{
+			break;
+		}
+	}
+
+	sequence[length] = '\0';
+	return strcmp(sequence, "200~") == 0;
+}
+
+/**
+ * Read the pasted text directly from the terminal until the end of paste sequence is found.
+ * Reading in blocks skips the per character overhead of getch, any input following the paste is pushed back to curses.
+ * Carriage returns are converted into newlines. Returns the pasted text and sets its size.
+ */
+static char *readPastedText(long *size)
+{
+	const long endSize = sizeof(PASTE_END) - 1;
+	long bufferSize = 4096, length = 0;
+	char *buffer = memAlloc(malloc(bufferSize), bufferSize);
+	trackMemory(MEM_BUFFERS, bufferSize);
+
+	// Curses reads the terminal in blocks, the start of the paste may already be in its input queue. It's taken untranslated before the rest is read.
+	keypad(stdscr, FALSE);
+	nodelay(stdscr, TRUE);
+	for (int ch = getch(); ch != ERR; ch = getch())
+	{
+		if (length == bufferSize)
+		{
+			trackMemory(MEM_BUFFERS, bufferSize);
+			bufferSize *= 2;
+			buffer = memAlloc(realloc(buffer, bufferSize), bufferSize);
+		}
+		buffer[length++] = ch;
+	}
+	nodelay(stdscr, FALSE);
+	keypad(stdscr, TRUE);
+
+	// The pasted text may hold NUL characters, so the end sequence is searched by length.
+	char *end = memmem(buffer, length, PASTE_END, endSize);
+	*size = 0;
+	while (end == NULL)
+	{
+		if (bufferSize - length < 4096)
+		{
+			trackMemory(MEM_BUFFERS, bufferSize);
+			bufferSize *= 2;
+			buffer = memAlloc(realloc(buffer, bufferSize), bufferSize);
+		}
+
+		ssize_t bytesRead = read(getTerminalFd(), buffer + length, bufferSize - length);
+		if (bytesRead <= 0)
+		{
+			break;
+		}
+
+		// Only the newly read bytes (and a possibly split end sequence) need to be searched.
+		long searchFrom = length > endSize ? length - endSize : 0;
+		length += bytesRead;
+		end = memmem(buffer + searchFrom, length - searchFrom, PASTE_END, endSize);
+	}
+
+	if (end == NULL)
+	{
+		end = buffer + length;
+	}
+
+	// Give back anything that was typed after the paste, ungetch works as a stack.
+	for (char *ch = buffer + length - 1; ch >= end + endSize; --ch)
+	{
+		ungetch((unsigned char)*ch);
+	}
+
+	for (char *ch = buffer; ch < end; ++ch)
+	{
+		if (*ch == '\r' && ch + 1 < end && ch[1] == '\n')
+		{
+			continue;
+		}
+		buffer[(*size)++] = *ch == '\r' ? '\n' : *ch;
+	}
+
+	// Only keep the memory needed by the pasted text.
+	buffer = memAlloc(realloc(buffer, *size + 1), *size + 1);
+	trackMemory(MEM_BUFFERS, *size + 1 - bufferSize);
+	return buffer;
+}
+
+/**
+ * Insert a bracketed paste from the terminal at the cursor position.
+ * The view is moved forward if the pasted text ends below the terminal view. Returns a pointer to the last pasted node.
  */
-static inline void setLeftMargin(int newLines)
+static TEXT *pasteFromTerminal(TEXT **headNode, coordinates xy)
 {
-	if (newLines < LIM_1)
+	long size = 0;
+	char *buffer = readPastedText(&size);
+	TEXT *lastNode = insertBuffer(headNode, buffer, size, xy);
+	if (lastNode != NULL)
 	{
-		_margins.left = MARGIN_SPACE_3;
+		recordInsert(findNodeOffset(*headNode, lastNode) - size + 1, buffer, size);
 	}
-	else if (newLines < LIM_2)
+
+	if (lastNode != NULL && memchr(buffer, '\n', size) != NULL)
+	{
+		invalidateLineIndex();
+	}
+
+	int cursorLine = _viewStart + xy.y;
+	for (long i = 0; i < size; ++i)
 	{
-		_margins.left = MARGIN_SPACE_4;
+		cursorLine += buffer[i] == '\n' ? 1 : 0;
 	}
-	else if (newLines < LIM_3)
+
+	if (cursorLine >= _viewStart + _view)
 	{
-		_margins.left = MARGIN_SPACE_5;
+		_viewStart = cursorLine - _view + 1;
 	}
-	else if (newLines < LIM_4)
+
+	trackMemory(MEM_BUFFERS, -(size + 1));
+	free(buffer);
+	buffer = NULL;
+	return lastNode;
+}
+
+/**
+ * This function will set the left margin. 
+ * The size of the left margin is decided depending on the amount of rows in the file, one column for each digit of the line numbers.  
+ */
+static inline void setLeftMargin(long newLines)
+{
+	int digits = 1;
+	for (long limit = LIM_1; newLines >= limit && digits < 18; limit *= LIM_1)
 	{
-		_margins.left = MARGIN_SPACE_6;
+		++digits;
 	}
+
+	_margins.left = MARGIN_SPACE_2 + digits;
 }
 
 
 /**
  * The right margin is make sure the user can't navigate outside the bounds of the text.
  * Making sure we keep the cursor within the editor area. This value is found by looking at the current y rows x coordinate limit. 
+ * The coordinates of the node are looked up by the caller, which needs them as well.
  */
-static inline void setRightMargin(int y, TEXT *node)
+static inline void setRightMargin(int y, TEXT *node, coordinates nodeXy)
 {
-	if (node->y == y && node->ch != '\n')
+	if (nodeXy.y == y && node->ch != '\n')
 	{
-		if (node->next != NULL)
+		if (nextNode(node) != NULL)
 		{
-			_margins.right = node->next->ch == '\n' ? node->x + 1 : node->x + 2;
+			_margins.right = nextNode(node)->ch == '\n' ? nodeXy.x + 1 : nodeXy.x + 2;
 		}
 		else
 		{
-			_margins.right = node->x + 1;
+			_margins.right = nodeXy.x + 1;
 		}
 	}
 }
@@ -544,10 +1465,10 @@ static inline void setRightMargin(int y, TEXT *node)
  * Set the bottom margin.
  * This margin will prevent the user from navigating downwards outside the bounds of the TEXT list. 
  */
-static inline void setBottomMargin(TEXT *node)
+static inline void setBottomMargin(int y, TEXT *node)
 {
-	_margins.bottom = node->y;
-	if (node->next == NULL && node->ch == '\n')
+	_margins.bottom = y;
+	if (nextNode(node) == NULL && node->ch == '\n')
 	{
 		_margins.bottom += _margins.bottom < _view ? 1 : 0;
 	}
@@ -574,17 +1495,26 @@ static void updateMargins(int y, int ch, TEXT *headNode)
 		y += y <= _margins.bottom ? 1 : 0;
 	}
 
-	int newLines = 0;
-	for (TEXT *node = headNode; node != NULL; node = node->next)
+	// Start at the newline just above the view, the lines above it can't hold the cursor. Folded lines are skipped.
+	TEXT *newLine = _viewStart > 0 ? findNewLine(headNode, _viewStart - 1) : NULL;
+	long line = newLine != NULL ? _viewStart - 1 : 0;
+	int rows = newLine != NULL ? -1 : 0;
+	for (TEXT *node = newLine != NULL ? newLine : headNode; node != NULL; node = nextNode(node))
 	{
-		newLines += node->ch == '\n' ? 1 : 0;
-		if (newLines >= _view + _viewStart  || node->next == NULL)
+		coordinates nodeXy = getNodeCoordinates(node);
+		if (node->ch == '\n')
+		{
+			node = skipFold(headNode, node, &line);
+			++rows;
+		}
+
+		if (rows >= _view || nextNode(node) == NULL)
 		{	
-			setLeftMargin(newLines);
-			setBottomMargin(node);
+			setLeftMargin(line + _hiddenLines);
+			setBottomMargin(nodeXy.y, node);
 			break;
 		}
-		setRightMargin(y, node);
+		setRightMargin(y, node, nodeXy);
 	}
 }
 
@@ -594,6 +1524,7 @@ static void updateMargins(int y, int ch, TEXT *headNode)
  */
 static coordinates updateCursor(int ch, coordinates xy, TEXT *editedNode, TEXT *headNode)
 {
+	coordinates nodeXy;
 	if(headNode == NULL)
 	{
 		xy.x = _margins.left;
@@ -617,6 +1548,22 @@ static coordinates updateCursor(int ch, coordinates xy, TEXT *editedNode, TEXT *
 		case KEY_RIGHT:
 			xy.x += xy.x < _margins.right ? 1 : 0;
 			break;
+		case WORD_LEFT_KEY:
+		case WORD_RIGHT_KEY:
+		case PARAGRAPH_UP_KEY:
+		case PARAGRAPH_DOWN_KEY:
+			// A motion places the cursor on the node it stopped at, or after the last node at the end of the text.
+			if(editedNode != NULL)
+			{
+				xy = getNodeCoordinates(editedNode);
+				break;
+			}
+
+			editedNode = findLastNode(headNode);
+			nodeXy = getNodeCoordinates(editedNode);
+			xy.x = editedNode->ch == '\n' ? _margins.left : nodeXy.x + (editedNode->ch == '\t' ? _tabSize : 1);
+			xy.y = editedNode->ch == '\n' ? nodeXy.y + 1 : nodeXy.y;
+			break;
 		default:
 			if(editedNode == NULL)
 			{
@@ -625,6 +1572,7 @@ static coordinates updateCursor(int ch, coordinates xy, TEXT *editedNode, TEXT *
 				return xy; 
 			}
 			
+			nodeXy = getNodeCoordinates(editedNode);
 			if(editedNode->ch == '\t')
 			{	
 				if(ch == KEY_BACKSPACE)
@@ -635,12 +1583,12 @@ static coordinates updateCursor(int ch, coordinates xy, TEXT *editedNode, TEXT *
 				{
 					xy.x += _tabSize;
 				}
-				xy.y = editedNode->y;
+				xy.y = nodeXy.y;
 				return xy; 
 			}
 
-			xy.x = editedNode->ch == '\n' ? _margins.left : editedNode->x + 1;
-			xy.y = editedNode->ch == '\n' ? editedNode->y + 1 : editedNode->y;
+			xy.x = editedNode->ch == '\n' ? _margins.left : nodeXy.x + 1;
+			xy.y = editedNode->ch == '\n' ? nodeXy.y + 1 : nodeXy.y;
 			break;
 	}
 	return xy;
@@ -649,22 +1597,57 @@ static coordinates updateCursor(int ch, coordinates xy, TEXT *editedNode, TEXT *
 /*
  * If backspace is pressed delete a node at the current cursor location.
  * Else if ch is within the bounds of the condition add it in a new node.
+ * The lines added (or removed if negative) by the edit are put in lines.
  */
-static TEXT *edit(TEXT **headNode, coordinates xy, int ch)
+static TEXT *edit(TEXT **headNode, coordinates xy, int ch, long *lines)
 {
-	static TEXT *node = NULL; 
+	TEXT *node = _editedNode, *oldHeadNode = *headNode;
+	*lines = 0;
 	if(ch == KEY_BACKSPACE)
 	{
-		node = deleteNode(headNode, xy);
+		int deleted = 0;
+		node = deleteNode(headNode, xy, &deleted);
+		*lines = deleted == '\n' ? -1 : 0;
+
+		// Without a previous node it was the head node that got deleted, if any.
+		if (node != NULL)
+		{
+			recordDelete(findNodeOffset(*headNode, node) + 1, 1);
+		}
+		else if (*headNode != oldHeadNode)
+		{
+			recordDelete(0, 1);
+		}
 	}
-	else if((ch >= ' ' && ch <= '~') || (ch == '\t' || ch == '\n'))
+	else if(isTextKey(ch))
 	{
+		char text = ch;
 	 	node = addNode(headNode, ch, xy);
+		long offset = findNodeOffset(*headNode, node);
+		recordInsert(offset, &text, 1);
+		if (ch == '\n')
+		{
+			addIndexedLine(*headNode, offset);
+			*lines = 1;
+		}
 	}
 
+	if (*headNode != oldHeadNode)
+	{
+		setLineIndexHead(*headNode);
+	}
+	_editedNode = node;
 	return node;
 }
 
+/**
+ * Check if a key adds its character to the text.
+ */
+static bool isTextKey(int ch)
+{
+	return (ch >= ' ' && ch <= '~') || ch == '\t' || ch == '\n';
+}
+
 /**
  * Count how many newlines that exists within the bounds of the terminal view.
  * This is usefull to help determine when we've added more items to the TEXT list than may be viewed in the terminal. 
@@ -680,111 +1663,1515 @@ static int countNewLinesInView(TEXT *headNode)
 			++newlines;
 		}
 
-		headNode = headNode->next;
+		headNode = nextNode(headNode);
 	}
 	return newlines;
 }
 
-
-static bool isEndNode(int y, TEXT *startNode)
+/**
+ * Count every newline in the list.
+ */
+static int countNewLines(TEXT *headNode)
 {
-	for(TEXT *node = startNode; node != NULL; node = node->next)
+	int newLines = 0;
+	for (; headNode != NULL; headNode = nextNode(headNode))
 	{
-		if(node->ch == '\n' && node->y == y)
+		newLines += headNode->ch == '\n' ? 1 : 0;
+	}
+
+	return newLines;
+}
+
+
+static bool isEndNode(int y, TEXT *headNode, TEXT *startNode)
+{
+	long line = _viewStart;
+	for(TEXT *node = startNode; node != NULL; node = nextNode(node))
+	{
+		if(node->ch == '\n' && getNodeCoordinates(node).y == y)
+		{
+			return false;
+		}
+		node = node->ch == '\n' ? skipFold(headNode, node, &line) : node;
+	}
+
+	return true; 
+}
+
+static TEXT *getViewStartNode(TEXT *headNode)
+{
+	TEXT *node = findLineStart(headNode, _viewStart);
+	return node != NULL && nextNode(node) != NULL ? node : NULL; 
+}
+
+/**
+ * Update view port of the text.
+ * This could be seen as some kind of paging making editing possible outside of terminal max bounds for xy.
+ */
+static void updateViewPort(coordinates xy, int ch, TEXT *headNode, TEXT *editedNode)
+{
+	int newLines = countNewLinesInView(headNode); 
+	if(newLines >= _view && ch == '\n')
+	{
+		_viewStart = getNextVisibleLine(_viewStart);
+	}
+	else if(newLines >= _view - 1 && _viewStart != 0 && ch == KEY_BACKSPACE && editedNode->ch == '\n')
+	{
+		_viewStart = getPrevVisibleLine(_viewStart);
+	}
+	else if(xy.y <= 0 && _viewStart > 0 && ch == KEY_UP)
+	{
+		_viewStart = getPrevVisibleLine(_viewStart);
+	}
+	else if(ch == KEY_DOWN) 	
+	{
+		TEXT *startNode = getViewStartNode(headNode);
+		if(startNode == NULL)
+		{
+			return;
+		}
+		
+		if(xy.y == _view - 1 && newLines > _view && !isEndNode(xy.y, headNode, startNode))
+		{
+			_viewStart = getNextVisibleLine(_viewStart);
+		}
+	}
+}
+
+/**
+ * Let the user pick one of the cached documents, the most recently used is listed first.
+ * Returns false if no document was picked.
+ */
+static bool pickCachedDocument(char *path)
+{
+	const char *fileNames[DOCUMENT_CACHE_SIZE];
+	int count = getCachedDocuments(fileNames);
+
+	wclear(stdscr);
+	printw(count == 0 ? "No other files are open, press any key to continue\n" : "Open files:\n");
+	for (int i = 0; i < count; ++i)
+	{
+		printw("%d: %s%s\n", i + 1, fileNames[i], isCachedDocumentModified(fileNames[i]) ? " (modified)" : "");
+	}
+	wrefresh(stdscr);
+
+	int ch = readKey();
+	if (ch < '1' || ch >= '1' + count)
+	{
+		return false;
+	}
+
+	strcpy(path, fileNames[ch - '1']);
+	return true;
+}
+
+/**
+ * Ask to save each document that was switched away from with unsaved edits, this is done before the editor exits.
+ * The journal of a document that isn't saved is removed, like the journal of the open document.
+ */
+static void saveModifiedDocuments(void)
+{
+	char path[FILENAME_SIZE];
+	closeJournal();
+	while (findModifiedDocument(path))
+	{
+		coordinates xy;
+		int viewStart = 0;
+		TEXT *headNode = takeCachedDocument(path, &xy, &viewStart, &_fileSize);
+
+		// The size of the text doesn't tell if it was edited, the document is known to be.
+		_fileSize = -1;
+		saveOnFileChange(headNode, path);
+		closeJournal();
+		deleteAllNodes(&headNode);
+	}
+}
+
+/**
+ * Open a new file at path location, the file name buffer is updated with the path.
+ * The current document is kept in the document cache, and the new one is taken from the cache if it is there.
+ * A document with unsaved edits is cached with them and its journal is kept, it's only saved if it can't be cached.
+ * The cursor in xy is stored with the current document, and replaced by the cursor the opened document should have or -1 if it is a new one.
+ */
+static TEXT *openFile(TEXT *headNode, char *fileName, const char *path, coordinates *xy)
+{
+	if (path[0] == '\0')
+	{
+		wclear(stdscr);
+		printw("Couldn't open file");
+		wrefresh(stdscr);
+		return headNode;
+	}
+
+	if (strcmp(fileName, path) == 0)
+	{
+		return headNode;
+	}
+
+	// A paged file or a stream that is still being read can't be kept, the cache only holds whole documents.
+	bool isModified = isDocumentModified();
+	bool isCached = !isPaged() && getStreamFd() == -1 && cacheDocument(fileName, headNode, *xy, _viewStart, getFileSizeFromList(headNode), _fileSize);
+	if (!isCached)
+	{
+		saveOnFileChange(headNode, fileName[0] != '\0' ? fileName : NULL);
+	}
+
+	// The journal is kept on disk until it's known if the document is left, the opened document gets a journal of its own.
+	detachJournal();
+
+	coordinates cachedXy;
+	int viewStart = 0;
+	long savedSize = 0;
+	TEXT *newHeadNode = takeCachedDocument(path, &cachedXy, &viewStart, &savedSize);
+	if (newHeadNode != NULL)
+	{
+		closePagedFile();
+		_fileSize = savedSize;
+		*xy = cachedXy;
+	}
+	else
+	{
+		newHeadNode = reStart(path);
+		if (newHeadNode == NULL)
+		{
+			// Nothing was loaded, take the current document back.
+			if (isCached)
+			{
+				return takeCachedDocument(fileName, xy, &_viewStart, &_fileSize);
+			}
+
+			if (!isPaged())
+			{
+				openJournal(fileName[0] != '\0' ? fileName : NULL);
+			}
+			return headNode;
+		}
+		xy->x = xy->y = -1;
+		_fileSize = wasJournalReplayed() ? -1 : getFileSizeFromList(newHeadNode);
+		if (!isPaged())
+		{
+			openJournal(path);
+		}
+	}
+
+	// Only a document cached with unsaved edits keeps its journal.
+	if (fileName[0] != '\0' && !(isCached && isModified))
+	{
+		discardJournal(fileName);
+	}
+
+	if (!isCached)
+	{
+		deleteAllNodes(&headNode);
+	}
+
+	// The rest of a stream doesn't belong to the opened file.
+	closeStream();
+	closeDecompression();
+	invalidateLineIndex();
+	clearFolds();
+	clearMarks();
+	setHighlightLanguage(path);
+	_viewStart = viewStart;
+	_hiddenLines = 0;
+	watchFile(path);
+	snprintf(fileName, FILENAME_SIZE, "%s", path);
+
+	return newHeadNode;
+}
+
+/**
+ * Handle a change made to the open file by another program.
+ * Text appended to the file is added to the end of the list, any other change lets the user reload the whole file.
+ * The view is kept when the file is reloaded.
+ */
+static TEXT *reloadFile(TEXT *headNode, const char *fileName)
+{
+	// Text appended to a paged file is added as new pages, they are loaded when the view reaches them.
+	if (isPaged() && getFileChange() == FILE_APPENDED)
+	{
+		appendPages();
+		watchFile(fileName);
+		return headNode;
+	}
+
+	// Text appended to a compressed file can't be read without the rest of it.
+	if (getFileChange() == FILE_APPENDED && getCompression(fileName) == COMPRESSION_NONE)
+	{
+		long size = 0;
+		char *text = readAppendedText(&size);
+		coordinates end = {-1, -1};
+		insertBuffer(&headNode, text, size, end);
+		invalidateLineIndex();
+		recordAppendedSource(size);
+		_fileSize += _fileSize != -1 ? size : 0;
+
+		trackMemory(MEM_BUFFERS, -size);
+		free(text);
+		return headNode;
+	}
+
+	wclear(stdscr);
+	printw("%s was changed on disk, would you like to reload it? (Y/N)", fileName);
+	int ch = wgetch(stdscr);
+	if (ch != 'y' && ch != 'Y')
+	{
+		// The text no longer matches the file, so it counts as modified.
+		watchFile(fileName);
+		_fileSize = -1;
+		return headNode;
+	}
+
+	// Keep the view unless the file got too short for it.
+	int viewStart = _viewStart;
+	headNode = loadFileAgain(headNode, fileName);
+	_viewStart = countNewLines(headNode) < viewStart ? 0 : viewStart;
+
+	return headNode;
+}
+
+/**
+ * Replace the list with the file as it is on disk, the old list is kept if the file can't be loaded.
+ */
+static TEXT *loadFileAgain(TEXT *headNode, const char *fileName)
+{
+	closeJournal();
+	TEXT *newHeadNode = reStart(fileName);
+	if (!isPaged())
+	{
+		openJournal(fileName);
+	}
+	watchFile(fileName);
+	if (newHeadNode == NULL)
+	{
+		return headNode;
+	}
+
+	deleteAllNodes(&headNode);
+	clearFolds();
+	clearMarks();
+	resetHighlight();
+	_hiddenLines = 0;
+	_fileSize = getFileSizeFromList(newHeadNode);
+	return newHeadNode;
+}
+
+/**
+ * Turn follow mode on or off. While following, the file is read-only and the view is pinned to the end of it.
+ * Only the last FOLLOW_WINDOW_SIZE characters are read into the list, the whole file is loaded again when follow mode is turned off.
+ */
+static TEXT *followFile(TEXT *headNode, char *fileName)
+{
+	if (_isFollowing)
+	{
+		_isFollowing = false;
+		curs_set(1);
+		headNode = loadFileAgain(headNode, fileName);
+		_viewStart = (isPaged() ? 0 : countNewLines(headNode)) + 1 - _view;
+		_viewStart = _viewStart > 0 ? _viewStart : 0;
+		return headNode;
+	}
+
+	// A compressed file can't be read from its end.
+	if (fileName == NULL || getCompression(fileName) != COMPRESSION_NONE)
+	{
+		return headNode;
+	}
+
+	// The list is replaced by the end of the file, edits that weren't saved are dropped along with the journal.
+	saveOnFileChange(headNode, fileName);
+	closeJournal();
+	clearFolds();
+	_isFollowing = true;
+	curs_set(0);
+	headNode = loadFollowWindow(headNode);
+	pinFollowView();
+
+	return headNode;
+}
+
+/**
+ * Add text appended to the followed file to the end of the list.
+ * A file that was replaced, like a rotated or truncated log, is followed from its new start.
+ */
+static TEXT *followAppended(TEXT *headNode, const char *fileName)
+{
+	_followPrevTop = _hiddenLines + _viewStart;
+	_followPrevLast = _followLines;
+
+	if (getFileChange() == FILE_REPLACED)
+	{
+		watchFile(fileName);
+		headNode = loadFollowWindow(headNode);
+		_followPrevTop = -1;
+	}
+	else
+	{
+		long size = 0;
+		char *text = readAppendedText(&size);
+
+		// Only the end of a large amount of new text fits in the window, the rest is only counted.
+		long skipped = size > FOLLOW_WINDOW_SIZE ? size - FOLLOW_WINDOW_SIZE : 0;
+		int skippedLines = 0;
+		for (long i = 0; i < size; ++i)
+		{
+			skippedLines += i < skipped && text[i] == '\n' ? 1 : 0;
+			_followLines += text[i] == '\n' ? 1 : 0;
+		}
+
+		if (skipped > 0)
+		{
+			_hiddenLines = _followPrevLast + skippedLines;
+			deleteAllNodes(&headNode);
+			clearMarks();
+			_followSize = 0;
+		}
+
+		// Lines are trimmed before the new text is added, so the list never grows past the window.
+		coordinates end = {-1, -1};
+		_followSize += size - skipped;
+		headNode = trimFollowWindow(headNode);
+		insertBuffer(&headNode, text + skipped, size - skipped, end);
+		invalidateLineIndex();
+		trackMemory(MEM_BUFFERS, -size);
+		free(text);
+	}
+
+	pinFollowView();
+	return headNode;
+}
+
+/**
+ * Replace the list with the end of the followed file. Only the last FOLLOW_WINDOW_SIZE characters are read, the lines before them are only counted.
+ */
+static TEXT *loadFollowWindow(TEXT *headNode)
+{
+	long size = 0;
+	int skippedLines = 0;
+	char *text = readFileTail(FOLLOW_WINDOW_SIZE, &size, &skippedLines);
+
+	deleteAllNodes(&headNode);
+	closePagedFile();
+	clearMarks();
+	resetHighlight();
+	headNode = createNodesFromBuffer(text, size);
+	_followSize = size;
+	_hiddenLines = _followLines = skippedLines;
+	for (long i = 0; i < size; ++i)
+	{
+		_followLines += text[i] == '\n' ? 1 : 0;
+	}
+
+	trackMemory(MEM_BUFFERS, -size);
+	free(text);
+	return headNode;
+}
+
+/**
+ * Delete whole lines from the start of the list until it fits in FOLLOW_WINDOW_SIZE characters.
+ */
+static TEXT *trimFollowWindow(TEXT *headNode)
+{
+	long deleted = 0, hiddenLines = _hiddenLines;
+	for (bool isLineStart = true; headNode != NULL && nextNode(headNode) != NULL &&
+		 (_followSize - deleted > FOLLOW_WINDOW_SIZE || !isLineStart);)
+	{
+		isLineStart = headNode->ch == '\n';
+		_hiddenLines += isLineStart ? 1 : 0;
+
+		TEXT *next = nextNode(headNode);
+		freeNode(headNode);
+		headNode = next;
+		++deleted;
+	}
+
+	if (headNode != NULL)
+	{
+		setPrev(headNode, NULL);
+	}
+	trackNodes(-deleted);
+	invalidateLineIndex();
+	dropHighlightLines(_hiddenLines - hiddenLines);
+	shiftMarks(0, hiddenLines - _hiddenLines);
+	clearCursors();
+	_followSize -= deleted;
+
+	return headNode;
+}
+
+/**
+ * Add the text that has arrived on the stream to the end of the list.
+ * Streamed text isn't counted as an edit. Reading stops if the text doesn't fit within the memory budget.
+ */
+static TEXT *readStreamInput(TEXT *headNode)
+{
+	long size = 0, added = 0;
+	char *text = readStream(&size);
+
+	if (isWithinMemoryBudget(getNodesCost(size)))
+	{
+		added = size;
+	}
+	else
+	{
+		closeStream();
+		wclear(stdscr);
+		printw("The rest of the input is too large for the memory budget, press any key to continue");
+		wrefresh(stdscr);
+		wgetch(stdscr);
+	}
+
+	_streamTail = appendBuffer(&headNode, _streamTail, text, added);
+	recordAppendedSource(added);
+	_fileSize += _fileSize != -1 ? added : 0;
+
+	trackMemory(MEM_BUFFERS, -size);
+	free(text);
+	return headNode;
+}
+
+/**
+ * Keep the pages around the view in the list while a paged file is edited.
+ * A page is loaded before the view reaches the edge of the list, pages far from the view are dropped once the list holds more than PAGED_WINDOW_PAGES.
+ */
+static TEXT *movePagedWindow(TEXT *headNode)
+{
+	if (!isPaged())
+	{
+		return headNode;
+	}
+
+	// A file without newlines can't be paged by lines, the window then stops growing at twice its size.
+	while (_viewStart < _view && getFirstPage() > 0 && getLastPage() - getFirstPage() < 2 * PAGED_WINDOW_PAGES)
+	{
+		headNode = loadPageAbove(headNode);
+	}
+
+	while (getLastPage() < getPageCount() - 1 && getLastPage() - getFirstPage() < 2 * PAGED_WINDOW_PAGES && isNearListEnd(headNode))
+	{
+		headNode = loadPageBelow(headNode);
+	}
+
+	for (TEXT *oldHeadNode = NULL; getLastPage() - getFirstPage() >= PAGED_WINDOW_PAGES && oldHeadNode != headNode;)
+	{
+		oldHeadNode = headNode;
+		headNode = dropFirstPage(headNode);
+	}
+
+	for (long lastPage = -1; getLastPage() - getFirstPage() >= PAGED_WINDOW_PAGES && lastPage != getLastPage();)
+	{
+		lastPage = getLastPage();
+		headNode = dropLastPage(headNode);
+	}
+
+	return headNode;
+}
+
+/**
+ * Check if the list ends less than a view below the view.
+ */
+static bool isNearListEnd(TEXT *headNode)
+{
+	int newLines = 0;
+	for (TEXT *node = headNode; node != NULL; node = nextNode(node))
+	{
+		newLines += node->ch == '\n' ? 1 : 0;
+		if (newLines >= _viewStart + 2 * _view)
 		{
 			return false;
 		}
 	}
 
-	return true; 
+	return true;
+}
+
+/**
+ * Add the page before the window to the start of the list.
+ */
+static TEXT *loadPageAbove(TEXT *headNode)
+{
+	long page = getFirstPage() - 1, size = 0;
+	const char *text = readPage(page, &size);
+
+	TEXT *first = NULL;
+	coordinates end = {-1, -1};
+	TEXT *last = insertBuffer(&first, text, size, end);
+	invalidateLineIndex();
+	if (last != NULL)
+	{
+		setNext(last, headNode);
+		if (headNode != NULL)
+		{
+			setPrev(headNode, last);
+		}
+		headNode = first;
+	}
+
+	int newLines = 0;
+	for (long i = 0; i < size; ++i)
+	{
+		newLines += text[i] == '\n' ? 1 : 0;
+	}
+	_viewStart += newLines;
+	_hiddenLines -= newLines;
+	shiftFolds(0, newLines);
+	shiftMarks(0, newLines);
+	resetHighlight();
+	clearCursors();
+
+	setWindow(page, getLastPage());
+	return headNode;
+}
+
+/**
+ * Add the page after the window to the end of the list.
+ */
+static TEXT *loadPageBelow(TEXT *headNode)
+{
+	long page = getLastPage() + 1, size = 0;
+	const char *text = readPage(page, &size);
+	appendBuffer(&headNode, NULL, text, size);
+
+	setWindow(getFirstPage(), page);
+	return headNode;
+}
+
+/**
+ * Delete the nodes of a page in the window starting at firstNode, an edited page keeps its text.
+ * Returns the node following the page and counts the newlines that were deleted.
+ */
+static TEXT *deletePageNodes(TEXT *firstNode, long page, int *newLines)
+{
+	long size = getPageSize(page);
+	bool isEdited = isPageEdited(page);
+	char *text = isEdited ? memAlloc(malloc(size > 0 ? size : 1), size > 0 ? size : 1) : NULL;
+	trackMemory(MEM_BUFFERS, isEdited ? size : 0);
+
+	TEXT *node = firstNode;
+	*newLines = 0;
+	clearCursors();
+	for (long i = 0; i < size && node != NULL; ++i)
+	{
+		TEXT *next = nextNode(node);
+		*newLines += node->ch == '\n' ? 1 : 0;
+		if (text != NULL)
+		{
+			text[i] = node->ch;
+		}
+		freeNode(node);
+		node = next;
+	}
+	trackNodes(-size);
+	invalidateLineIndex();
+
+	if (text != NULL)
+	{
+		storePage(page, text, size);
+		trackMemory(MEM_BUFFERS, -size);
+		free(text);
+	}
+
+	return node;
+}
+
+/**
+ * Drop the first page of the window if the view is at least a view below it.
+ */
+static TEXT *dropFirstPage(TEXT *headNode)
+{
+	int newLines = 0;
+	TEXT *node = headNode;
+	for (long i = getPageSize(getFirstPage()); node != NULL && i > 0; --i, node = nextNode(node))
+	{
+		newLines += node->ch == '\n' ? 1 : 0;
+	}
+
+	if (node == NULL || newLines > _viewStart - _view)
+	{
+		return headNode;
+	}
+
+	headNode = deletePageNodes(headNode, getFirstPage(), &newLines);
+	setPrev(headNode, NULL);
+	_editedNode = NULL;
+	_viewStart -= newLines;
+	_hiddenLines += newLines;
+	shiftFolds(0, -newLines);
+	shiftMarks(0, -newLines);
+	dropHighlightLines(newLines);
+
+	setWindow(getFirstPage() + 1, getLastPage());
+	return headNode;
+}
+
+/**
+ * Drop the last page of the window if it starts at least a view below the view.
+ */
+static TEXT *dropLastPage(TEXT *headNode)
+{
+	long offset = 0;
+	for (long page = getFirstPage(); page < getLastPage(); ++page)
+	{
+		offset += getPageSize(page);
+	}
+
+	int newLines = 0;
+	TEXT *node = headNode;
+	for (; node != NULL && offset > 0; --offset, node = nextNode(node))
+	{
+		newLines += node->ch == '\n' ? 1 : 0;
+	}
+
+	if (node == NULL || prevNode(node) == NULL || newLines < _viewStart + 2 * _view)
+	{
+		return headNode;
+	}
+
+	setNext(prevNode(node), NULL);
+	deletePageNodes(node, getLastPage(), &newLines);
+	_editedNode = NULL;
+
+	setWindow(getFirstPage(), getLastPage() - 1);
+	return headNode;
+}
+
+/**
+ * Replace the window of a paged file with the page where a line starts, the pages of the old window keep their edits.
+ * If the pages aren't counted that far yet the old window is loaded again, and the line is changed to the top line of the view.
+ */
+static TEXT *loadLineWindow(TEXT *headNode, long *line)
+{
+	long topLine = _hiddenLines + _viewStart;
+	int newLines = 0;
+	for (long page = getFirstPage(); page <= getLastPage(); ++page)
+	{
+		headNode = deletePageNodes(headNode, page, &newLines);
+	}
+	_editedNode = NULL;
+
+	long page = findLinePage(*line);
+	if (page == -1)
+	{
+		wclear(stdscr);
+		printw("The lines of the file are still being counted, press any key to continue");
+		wrefresh(stdscr);
+		wgetch(stdscr);
+		*line = topLine;
+		page = findLinePage(topLine);
+	}
+
+	long size = 0;
+	const char *text = readPage(page, &size);
+	appendBuffer(&headNode, NULL, text, size);
+	setWindow(page, page);
+	shiftFolds(0, _hiddenLines - getLinesBefore(page));
+	shiftMarks(0, _hiddenLines - getLinesBefore(page));
+	resetHighlight();
+	_hiddenLines = getLinesBefore(page);
+	_viewStart = 0;
+	return headNode;
+}
+
+/**
+ * Move the cursor to the start of a line (counted from 0), a line past the end of the text moves it to the last line.
+ * A line outside the view is placed in the middle of it, the view never moves further than needed to show the last line.
+ * The cursor is only placed in xy, the view is printed once no matter how far away the line was.
+ */
+static TEXT *goToLine(TEXT *headNode, long line, coordinates *xy)
+{
+	if (line < 0)
+	{
+		return headNode;
+	}
+
+	// A line outside the window of a paged file is found in the line counts of the pages instead of the list.
+	if (isPaged() && (line < _hiddenLines || (line > _hiddenLines + getLineCount(headNode) && getLastPage() < getPageCount() - 1)))
+	{
+		headNode = loadLineWindow(headNode, &line);
+	}
+
+	long lineCount = getLineCount(headNode);
+	line -= _hiddenLines;
+	line = line < lineCount ? line : lineCount;
+	line = line > 0 ? line : 0;
+	if (getFoldStart(line) != -1)
+	{
+		removeFold(line);
+	}
+	showLine(line, lineCount);
+
+	// The margin isn't known until the view is updated, the cursor is moved onto the text afterwards.
+	xy->x = 0;
+	xy->y = getRowOfLine(_viewStart, line, _view);
+	return headNode;
+}
+
+/**
+ * Search every file below the working directory for a pattern and open the file of the picked result at the matching line.
+ * The search runs in the background while the results are listed, it's stopped once a result is picked or the list is left.
+ */
+static TEXT *searchProject(TEXT *headNode, char *fileName, coordinates *xy)
+{
+	char pattern[SEARCH_PATTERN_SIZE];
+	if (!askPattern("Search files: ", pattern) || !startSearch(".", pattern))
+	{
+		return headNode;
+	}
+
+	searchResult result;
+	long picked = pickSearchResult();
+	bool isPicked = picked != -1 && getSearchResult(picked, &result);
+	stopSearch();
+	if (!isPicked)
+	{
+		return headNode;
+	}
+
+	headNode = openFile(headNode, fileName, result.path, xy);
+	return strcmp(fileName, result.path) == 0 ? goToLine(headNode, result.line - 1, xy) : headNode;
+}
+
+/**
+ * The line the next iteration of a macro replayed on every line starts at, the line after the previous one moved by the lines it added or removed.
+ * The replay is stopped when the end of the text is reached, -1 is returned then.
+ */
+static long nextReplayLine(TEXT *headNode)
+{
+	long lineCount = getLineCount(headNode);
+	_replayLine += 1 + lineCount - _replayLineCount;
+	_replayLineCount = lineCount;
+	if (_replayLine > lineCount || findLineStart(headNode, _replayLine) == NULL)
+	{
+		stopReplay();
+		return -1;
+	}
+
+	return _replayLine;
+}
+
+/**
+ * Sort, remove duplicates from, reverse or filter lines. The lines from a line marked with ESC + a to the cursor line are changed, or every line if none is marked.
+ * The new text is written over the nodes of the old lines in one pass and recorded as a single replacement of them, the nodes left over are deleted.
+ * The cursor is moved to the first changed line.
+ */
+static TEXT *changeLines(TEXT **headNode, coordinates *xy)
+{
+	char pattern[SEARCH_PATTERN_SIZE] = "";
+	int operation = askLineOperation();
+	if (operation == -1 || ((operation == LINES_KEEP || operation == LINES_DROP) && !askPattern("Pattern: ", pattern)))
+	{
+		return *headNode;
+	}
+
+	long lineCount = getLineCount(*headNode), line = getLineAtRow(_viewStart, xy->y);
+	long first = _lineMark == -1 ? 0 : _lineMark < line ? _lineMark : line;
+	long last = _lineMark == -1 ? lineCount : _lineMark < line ? line : _lineMark;
+	last = last < lineCount ? last : lineCount;
+	_lineMark = -1;
+
+	// The empty line after the last newline isn't one of the lines.
+	last -= last > first && findLineStart(*headNode, last) == NULL ? 1 : 0;
+	TEXT *firstNode = findLineStart(*headNode, first), *endNode = findNewLine(*headNode, last);
+	if (firstNode == NULL || firstNode == endNode)
+	{
+		return *headNode;
+	}
+
+	long offset = findNodeOffset(*headNode, firstNode), size = 0, newSize = 0;
+	char *text = copyLines(firstNode, endNode, &size);
+	char *newText = applyLineOperation(operation, text, size, pattern, &newSize);
+
+	TEXT *node = firstNode, *before = prevNode(firstNode);
+	for (long i = 0; i < newSize; ++i, node = nextNode(node))
+	{
+		node->ch = newText[i];
+		before = node;
+	}
+
+	// Lines that are all removed take the newline ending them along, the last lines take the newline before them.
+	long replaced = size, deleted = 0;
+	if (newSize == 0 && endNode != NULL)
+	{
+		endNode = nextNode(endNode);
+		++replaced;
+	}
+	else if (newSize == 0 && before != NULL)
+	{
+		TEXT *newLine = before;
+		before = prevNode(newLine);
+		freeNode(newLine);
+		--offset;
+		++replaced;
+		++deleted;
+	}
+
+	while (node != endNode)
+	{
+		TEXT *next = nextNode(node);
+		freeNode(node);
+		node = next;
+		++deleted;
+	}
+
+	if (before != NULL)
+	{
+		setNext(before, endNode);
+	}
+	else
+	{
+		*headNode = endNode;
+	}
+
+	if (endNode != NULL)
+	{
+		setPrev(endNode, before);
+	}
+
+	trackNodes(-deleted);
+	invalidateLineIndex();
+	_editedNode = NULL;
+	recordDelete(offset, replaced);
+	recordInsert(offset, newText, newSize);
+
+	// Both buffers were allocated for the size of the old lines.
+	free(text);
+	free(newText);
+	trackMemory(MEM_BUFFERS, -(size + 1) * 2);
+
+	// The lines may have moved anywhere in the range, so no fold or mark is kept.
+	clearFolds();
+	clearMarks();
+	editHighlight(first, last, getLineCount(*headNode) - lineCount);
+	return goToLine(*headNode, first, xy);
+}
+
+/**
+ * Copy the text from a node up to an end node (or the end of the list), the end node isn't copied.
+ * The buffer is counted as MEM_BUFFERS memory.
+ */
+static char *copyLines(TEXT *firstNode, TEXT *endNode, long *size)
+{
+	long bufferSize = COPY_LINES_SIZE;
+	char *buffer = memAlloc(malloc(bufferSize), bufferSize);
+	*size = 0;
+	for (TEXT *node = firstNode; node != endNode; node = nextNode(node))
+	{
+		// One byte is kept for the ending null character.
+		if (*size == bufferSize - 1)
+		{
+			buffer = memAlloc(realloc(buffer, bufferSize * 2), bufferSize * 2);
+			bufferSize *= 2;
+		}
+		buffer[(*size)++] = node->ch;
+	}
+	buffer[*size] = '\0';
+
+	trackMemory(MEM_BUFFERS, *size + 1);
+	return buffer;
+}
+
+/**
+ * Move the view to show a line of the list, a line outside the view is placed in the middle of it.
+ * The view never moves further than needed to show the last line.
+ */
+static void showLine(long line, long lineCount)
+{
+	if (line >= _viewStart && getRowOfLine(_viewStart, line, _view) < _view)
+	{
+		return;
+	}
+
+	long viewStart = line, lastViewStart = getLastViewStart(lineCount);
+	for (int row = 0; row < _view / 2 && viewStart > 0; ++row)
+	{
+		viewStart = getPrevVisibleLine(viewStart);
+	}
+	_viewStart = viewStart < lastViewStart ? viewStart : lastViewStart;
+}
+
+/**
+ * The line the view starts at when the last line is shown at the bottom row, folded lines don't take up any rows.
+ */
+static long getLastViewStart(long lineCount)
+{
+	long viewStart = lineCount;
+	for (int row = 1; row < _view && viewStart > 0; ++row)
+	{
+		viewStart = getPrevVisibleLine(viewStart);
+	}
+
+	return viewStart;
+}
+
+/**
+ * Find the node a word or paragraph motion moves the cursor to, and move the view to show its line.
+ * Returns the node the cursor is placed on, NULL if the cursor is placed at the end of the text.
+ */
+static TEXT *moveByText(TEXT *headNode, int ch, coordinates xy)
+{
+	if (headNode == NULL)
+	{
+		return NULL;
+	}
+
+	TEXT *node = findNodeAt(headNode, xy), *prev = node != NULL ? prevNode(node) : findLastNode(headNode);
+	long lines = 0, line = getLineAtRow(_viewStart, xy.y);
+	switch (ch)
+	{
+		case WORD_RIGHT_KEY:
+			node = node != NULL ? findNextWord(node, &lines) : NULL;
+			break;
+		case PARAGRAPH_DOWN_KEY:
+			node = node != NULL ? findNextParagraph(node, &lines) : NULL;
+			break;
+		case WORD_LEFT_KEY:
+			node = prev != NULL ? findPrevWord(prev, &lines) : node;
+			lines = -lines;
+			break;
+		case PARAGRAPH_UP_KEY:
+			node = prev != NULL ? findPrevParagraph(prev, &lines) : node;
+			lines = -lines;
+			break;
+	}
+
+	// A motion into folded lines opens the fold.
+	if (getFoldStart(line + lines) != -1)
+	{
+		removeFold(line + lines);
+	}
+	showLine(line + lines, getLineCount(headNode));
+	return node;
+}
+
+/**
+ * Find the last node of the list, only the last line is walked.
+ */
+static TEXT *findLastNode(TEXT *headNode)
+{
+	long lineCount = getLineCount(headNode);
+	TEXT *node = findLineStart(headNode, lineCount);
+	if (node == NULL)
+	{
+		return findNewLine(headNode, lineCount - 1);
+	}
+
+	for (; nextNode(node) != NULL; node = nextNode(node))
+	{
+	}
+	return node;
+}
+
+/**
+ * Move the cursor to the start or end of its line (Home/End), or the view a whole view up or down (PgUp/PgDn).
+ * The cursor keeps its row unless the view can't move any further, it is then moved to the first or last line.
+ */
+static coordinates jumpInView(TEXT *headNode, int ch, coordinates xy)
+{
+	long lineCount = getLineCount(headNode), lastViewStart = getLastViewStart(lineCount), viewStart = getLineAtRow(_viewStart, _view > 1 ? _view - 1 : 1);
+
+	switch (ch)
+	{
+		case KEY_HOME:
+			xy.x = 0;
+			break;
+		case KEY_END:
+			xy.x = INT_MAX;
+			break;
+		case KEY_PPAGE:
+			xy.y = _viewStart == 0 ? 0 : xy.y;
+			for (int row = 1; row < _view && _viewStart > 0; ++row)
+			{
+				_viewStart = getPrevVisibleLine(_viewStart);
+			}
+			break;
+		case KEY_NPAGE:
+			xy.y = _viewStart >= lastViewStart ? getRowOfLine(_viewStart, lineCount, _view) : xy.y;
+			_viewStart = viewStart < lastViewStart ? viewStart : (_viewStart > lastViewStart ? _viewStart : lastViewStart);
+			break;
+	}
+
+	return xy;
+}
+
+/**
+ * Keep a cursor that was moved by a jump on the text, at most at the end of its row.
+ */
+static coordinates fitCursorToText(TEXT *headNode, coordinates xy)
+{
+	int end = _margins.left;
+	TEXT *node = findLineStart(headNode, getLineAtRow(_viewStart, xy.y));
+	for (; node != NULL && node->ch != '\n'; node = nextNode(node))
+	{
+		int x = getNodeCoordinates(node).x;
+		end = x != -1 ? x + (node->ch == '\t' ? _tabSize : 1) : end;
+	}
+	end = node != NULL && getNodeCoordinates(node).x != -1 ? getNodeCoordinates(node).x : end;
+
+	xy.x = xy.x < end ? xy.x : end;
+	xy.x = xy.x > _margins.left ? xy.x : _margins.left;
+	return xy;
+}
+
+/**
+ * Fold or open the lines at the cursor, the view is moved to show the line holding the fold and the cursor is placed on it.
+ */
+static void foldLines(TEXT *headNode, int mode, coordinates *xy)
+{
+	long line = getLineAtRow(_viewStart, xy->y);
+	line = mode == FOLD ? toggleFold(headNode, line) : markFold(headNode, line);
+	if (line == -1)
+	{
+		return;
+	}
+
+	// The view can't start at a line that was just folded.
+	_viewStart = getFoldStart(_viewStart) != -1 ? getFoldStart(_viewStart) : _viewStart;
+	showLine(line, getLineCount(headNode));
+	xy->y = getRowOfLine(_viewStart, line, _view);
+}
+
+/**
+ * Fold the lines below a line that are indented further than it, or open the fold the line holds.
+ * Empty lines between the indented lines are folded as well. Returns the line or -1 if nothing could be folded.
+ */
+static long toggleFold(TEXT *headNode, long line)
+{
+	if (flipFold(line))
+	{
+		return line;
+	}
+
+	int indent = getIndent(findLineStart(headNode, line));
+	TEXT *node = findNewLine(headNode, line);
+	if (node == NULL || indent == -1)
+	{
+		return -1;
+	}
+
+	// Only lines ending with a newline can be folded, the last line of the text stays in view.
+	long last = line;
+	for (long current = line + 1; nextNode(node) != NULL; ++current)
+	{
+		int lineIndent = getIndent(nextNode(node));
+		for (node = nextNode(node); node != NULL; node = nextNode(node))
+		{
+			if (node->ch == '\n')
+			{
+				break;
+			}
+		}
+
+		if (node == NULL || (lineIndent != -1 && lineIndent <= indent))
+		{
+			break;
+		}
+		last = lineIndent != -1 ? current : last;
+	}
+
+	return last != line && addFold(line, last) ? line : -1;
+}
+
+/**
+ * Mark the first line of a fold, the second time the lines between the marked line and this line are folded.
+ * Returns the line holding the fold or -1 if nothing was folded.
+ */
+static long markFold(TEXT *headNode, long line)
+{
+	if (_foldMark == -1)
+	{
+		_foldMark = line;
+		return -1;
+	}
+
+	long first = _foldMark < line ? _foldMark : line, last = _foldMark < line ? line : _foldMark;
+	long lineCount = getLineCount(headNode);
+	last = last < lineCount ? last : lineCount - 1;
+	_foldMark = -1;
+
+	return addFold(first, last) ? first : -1;
+}
+
+/**
+ * The indentation of the line starting at a node, -1 if the line is empty or only holds whitespace.
+ */
+static int getIndent(TEXT *node)
+{
+	int indent = 0;
+	for (; node != NULL && (node->ch == ' ' || node->ch == '\t'); node = nextNode(node))
+	{
+		indent += node->ch == '\t' ? _tabSize : 1;
+	}
+
+	return node == NULL || node->ch == '\n' ? -1 : indent;
 }
 
-static TEXT *getViewStartNode(TEXT *headNode)
+/**
+ * Keep the folds and the highlighted lines in step with text added or removed at a line, lines is the amount of lines added (or removed if negative).
+ * Removing the newline above the line joins it with the line above, which is then the first edited line.
+ */
+static void moveLines(long line, long lines)
+{
+	long first = lines < 0 && line > 0 ? line - 1 : line;
+	editHighlight(first, first + (lines > 0 ? lines : 0), lines);
+	moveFolds(line, lines);
+
+	// Added lines come after the edited line, a mark on it stays.
+	shiftMarks(lines > 0 ? line + 1 : line, lines);
+}
+
+/**
+ * Keep the marked lines on their lines after a number of lines were added or removed at a line.
+ */
+static void shiftMarks(long line, long lines)
+{
+	_foldMark = shiftMark(_foldMark, line, lines);
+	_lineMark = shiftMark(_lineMark, line, lines);
+}
+
+/**
+ * The line a mark is on after lines were added or removed at a line. A mark on a removed line moves to the line it was joined with,
+ * a mark moved above the first line of the list is dropped (-1).
+ */
+static long shiftMark(long mark, long line, long lines)
+{
+	if (mark < line)
+	{
+		return mark;
+	}
+
+	return mark + lines > line - 1 ? mark + lines : line - 1;
+}
+
+/**
+ * Drop the marks set with ESC + v and ESC + a, used when the lines they were on are gone.
+ */
+static void clearMarks(void)
+{
+	_foldMark = -1;
+	_lineMark = -1;
+}
+
+/**
+ * Mark the first line for ESC + l, marking the same line again removes the mark.
+ */
+static void markLines(long line)
+{
+	_lineMark = _lineMark == line ? -1 : line;
+}
+
+/**
+ * Keep the folds on their lines after a number of lines were added or removed at a line.
+ * The folds are thrown away if more than one line was removed.
+ */
+static void moveFolds(long line, long lines)
+{
+	if (!hasFolds())
+	{
+		return;
+	}
+
+	if (lines < -1)
+	{
+		clearFolds();
+		return;
+	}
+
+	shiftFolds(line, lines);
+}
+
+/**
+ * Add a cursor on the line above the highest cursor (CURSOR_ABOVE) or below the lowest one (CURSOR_BELOW).
+ * The cursor is placed at the column of the primary cursor, or at the end of the line if it's shorter.
+ */
+static void addCursorLine(TEXT *headNode, coordinates xy, int mode)
+{
+	cursor *cursors = getCursors();
+	int count = getCursorCount();
+	long line = getLineAtRow(_viewStart, xy.y), from = line;
+	if (mode == CURSOR_BELOW)
+	{
+		from = count > 0 && cursors[count - 1].line > line ? cursors[count - 1].line : line;
+		line = getNextVisibleLine(from);
+	}
+	else
+	{
+		from = count > 0 && cursors[0].line < line ? cursors[0].line : line;
+		line = getPrevVisibleLine(from);
+	}
+
+	if (line >= 0 && line <= getLineCount(headNode))
+	{
+		addCursor(findColumnNode(headNode, line, xy.x - _margins.left), line, mode == CURSOR_BELOW);
+	}
+}
+
+/**
+ * Add a cursor at the next match of the word at the primary cursor, searching from the last cursor.
+ * The cursor is placed as far into the match as the primary cursor is into its word.
+ */
+static void addCursorAtMatch(TEXT *headNode, coordinates xy)
 {
-	int newLines = 0; 
-	for(TEXT *node = headNode; node->next != NULL; node = node->next)
+	TEXT *primary = findNodeAt(headNode, xy);
+	TEXT *start = primary != NULL && getCharClass(primary->ch) == CLASS_WORD ? primary : primary != NULL ? prevNode(primary) : findLastNode(headNode);
+	if (start == NULL || getCharClass(start->ch) != CLASS_WORD)
+	{
+		return;
+	}
+
+	// Find the start of the word and how far into it the cursor is.
+	int offset = primary == start ? 0 : 1;
+	for (; prevNode(start) != NULL && getCharClass(prevNode(start)->ch) == CLASS_WORD; start = prevNode(start))
 	{
-		if(newLines == _viewStart) 
+		++offset;
+	}
+
+	char word[MATCH_WORD_SIZE];
+	int length = 0;
+	for (TEXT *node = start; node != NULL && getCharClass(node->ch) == CLASS_WORD; node = nextNode(node))
+	{
+		if (length == MATCH_WORD_SIZE)
 		{
-			return node; 
+			return;
+		}
+		word[length++] = node->ch;
+	}
+
+	// Search after the primary cursor, or after the last cursor if it's further down.
+	cursor *cursors = getCursors();
+	int count = getCursorCount();
+	long line = getLineAtRow(_viewStart, xy.y);
+	TEXT *node = start;
+	if (count > 0 && cursors[count - 1].line >= line)
+	{
+		node = cursors[count - 1].node;
+		line = cursors[count - 1].line;
+	}
+
+	for (; node != NULL; node = nextNode(node))
+	{
+		if (!isWordAt(nextNode(node), word, length))
+		{
+			line += node->ch == '\n' ? 1 : 0;
+			continue;
+		}
+
+		TEXT *match = nextNode(node);
+		line += node->ch == '\n' ? 1 : 0;
+		for (int i = 0; i < offset && match != NULL; ++i)
+		{
+			match = nextNode(match);
+		}
+
+		if (match != NULL && match != primary && addCursor(match, line, true))
+		{
+			return;
 		}
-		newLines += node->ch == '\n' ? 1 : 0; 
 	}
-	
-	return NULL; 
 }
 
 /**
- * Update view port of the text.
- * This could be seen as some kind of paging making editing possible outside of terminal max bounds for xy.
+ * Check if a whole word starts at a node.
  */
-static void updateViewPort(coordinates xy, int ch, TEXT *headNode, TEXT *editedNode)
+static bool isWordAt(TEXT *node, const char *word, int length)
 {
-	int newLines = countNewLinesInView(headNode); 
-	if(newLines >= _view && ch == '\n')
+	if (node == NULL || (prevNode(node) != NULL && getCharClass(prevNode(node)->ch) == CLASS_WORD))
 	{
-		++_viewStart;
+		return false;
 	}
-	else if(newLines >= _view - 1 && _viewStart != 0 && ch == KEY_BACKSPACE && editedNode->ch == '\n')
+
+	for (int i = 0; i < length; ++i, node = nextNode(node))
 	{
-		--_viewStart;
+		if (node == NULL || node->ch != word[i])
+		{
+			return false;
+		}
 	}
-	else if(xy.y <= 0 && _viewStart > 0 && ch == KEY_UP)
+
+	return node == NULL || getCharClass(node->ch) != CLASS_WORD;
+}
+
+/**
+ * Find the node placed at a column of a line, tabs count as _tabSize columns.
+ * Returns the newline ending the line if it's shorter, or NULL at the end of the text.
+ */
+static TEXT *findColumnNode(TEXT *headNode, long line, int column)
+{
+	int x = 0;
+	TEXT *node = findLineStart(headNode, line);
+	for (; node != NULL && node->ch != '\n'; node = nextNode(node))
 	{
-		--_viewStart;
+		x += node->ch == '\t' ? _tabSize : 1;
+		if (x > column)
+		{
+			break;
+		}
 	}
-	else if(ch == KEY_DOWN) 	
+
+	return node;
+}
+
+/**
+ * Type a key at the primary cursor and every extra cursor as one edit.
+ * The list is walked once to find the offsets of the cursors, then the key is applied at each cursor in the order of the text,
+ * the nodes are linked in place so no cursor is searched for by its coordinates. Returns the node edited at the primary cursor, like edit.
+ */
+static TEXT *editCursors(TEXT **headNode, coordinates xy, int ch)
+{
+	TEXT *primary = findNodeAt(*headNode, xy), *lastNode = NULL, *editedNode = NULL;
+	mergeCursors(primary);
+
+	cursor *cursors = getCursors();
+	int count = getCursorCount(), next = 0;
+	long offset = 0, primaryOffset = -1;
+	for (TEXT *node = *headNode; node != NULL && (next < count || primaryOffset == -1); node = nextNode(node), ++offset)
 	{
-		TEXT *startNode = getViewStartNode(headNode);
-		if(startNode == NULL)
+		primaryOffset = node == primary ? offset : primaryOffset;
+		if (next < count && cursors[next].node == node)
 		{
-			return;
+			cursors[next++].offset = offset;
 		}
-		
-		if(xy.y == _view - 1 && newLines > _view && !isEndNode(xy.y, editedNode))
+		lastNode = node;
+	}
+	primaryOffset = primary == NULL ? offset : primaryOffset;
+
+	// The cursors are edited from the start of the text, so an edit only moves the offsets and lines of the cursors after it.
+	long primaryLine = getLineAtRow(_viewStart, xy.y), firstLine = count > 0 && cursors[0].line < primaryLine ? cursors[0].line : primaryLine;
+	long shift = 0, lines = 0;
+	for (int i = 0, isPrimaryDone = false; i < count || !isPrimaryDone;)
+	{
+		bool isPrimary = !isPrimaryDone && (i == count || primaryOffset < cursors[i].offset);
+		TEXT *node = isPrimary ? primary : cursors[i].node, *edited = NULL;
+		long at = (isPrimary ? primaryOffset : cursors[i].offset) + shift;
+
+		if (ch != KEY_BACKSPACE)
+		{
+			edited = insertAtCursor(headNode, node, lastNode, ch, at);
+			lastNode = node == NULL ? edited : lastNode;
+			lines += ch == '\n' ? 1 : 0;
+			++shift;
+		}
+		else if ((node != NULL ? prevNode(node) : lastNode) != NULL)
 		{
-			++_viewStart;
+			TEXT *deleted = node != NULL ? prevNode(node) : lastNode;
+			lines -= deleted->ch == '\n' ? 1 : 0;
+			lastNode = deleted == lastNode ? prevNode(deleted) : lastNode;
+			primary = deleted == primary ? node : primary;
+			edited = deleteAtCursor(headNode, deleted, node, at);
+			--shift;
+		}
+
+		if (isPrimary)
+		{
+			editedNode = edited;
+			primaryLine += lines;
+			isPrimaryDone = true;
+			continue;
 		}
+		cursors[i++].line += lines;
 	}
+
+	// A cursor whose node was deleted by the cursor after it now shares its node.
+	mergeCursors(primary);
+	cursors = getCursors();
+	count = getCursorCount();
+
+	long lastLine = count > 0 && cursors[count - 1].line > primaryLine ? cursors[count - 1].line : primaryLine;
+	firstLine -= ch == KEY_BACKSPACE && firstLine > 0 ? 1 : 0;
+	editHighlight(firstLine, lastLine, lines);
+	if (lines != 0)
+	{
+		clearFolds();
+		clearMarks();
+	}
+
+	// An edit at the start of the text may have replaced the head node.
+	setLineIndexHead(*headNode);
+	_editedNode = editedNode;
+	return editedNode;
 }
 
 /**
- * Open a new file at path location (fileName).
- * Freeing old data and setting the new filesize. 
+ * Add a node in front of the node a cursor is on, or at the end of the text if the cursor is on NULL. Returns the new node.
  */
-static TEXT *openFile(TEXT *headNode, char *fileName)
+static TEXT *insertAtCursor(TEXT **headNode, TEXT *node, TEXT *lastNode, int ch, long offset)
 {
-	char *path = newFileName();
-	if (path == NULL)
+	TEXT *newNode = createNewNode(ch);
+	char text = ch;
+	if (node == NULL)
 	{
-		wclear(stdscr);
-		printw("Couldn't open file");
-		wrefresh(stdscr);
-		return headNode;
+		setPrev(newNode, lastNode);
+		if (lastNode != NULL)
+		{
+			setNext(lastNode, newNode);
+		}
+		else
+		{
+			*headNode = newNode;
+		}
+	}
+	else
+	{
+		setNext(newNode, node);
+		setPrev(newNode, prevNode(node));
+		if (prevNode(node) != NULL)
+		{
+			setNext(prevNode(node), newNode);
+		}
+		else
+		{
+			*headNode = newNode;
+		}
+		setPrev(node, newNode);
 	}
 
-	saveOnFileChange(headNode, fileName);
+	recordInsert(offset, &text, 1);
+	if (ch == '\n')
+	{
+		addIndexedLine(*headNode, offset);
+	}
+	return newNode;
+}
 
-	if (fileName != NULL)
+/**
+ * Delete the node in front of the node a cursor is on, offset is the offset of the cursor. Returns the node in front of the deleted one.
+ * A cursor on the deleted node is moved to the node of this cursor, they are merged afterwards.
+ */
+static TEXT *deleteAtCursor(TEXT **headNode, TEXT *deleted, TEXT *node, long offset)
+{
+	if (prevNode(deleted) != NULL)
 	{
-		strcpy(fileName, path);
+		setNext(prevNode(deleted), nextNode(deleted));
 	}
 	else
 	{
-		fileName = path;
+		*headNode = nextNode(deleted);
 	}
 
-	TEXT *newHeadNode = reStart(fileName);
-	if (newHeadNode == NULL)
+	if (nextNode(deleted) != NULL)
 	{
-		return headNode;
+		setPrev(nextNode(deleted), prevNode(deleted));
 	}
 
-	deleteAllNodes(&headNode);
-	headNode = newHeadNode;
-	_fileSize = getFileSizeFromList(headNode);
+	cursor *cursors = getCursors();
+	for (int i = getCursorCount() - 1; i >= 0; --i)
+	{
+		if (cursors[i].node == deleted)
+		{
+			cursors[i].node = node;
+			break;
+		}
+	}
 
-	return headNode;
+	if (deleted->ch == '\n')
+	{
+		removeIndexedLine(deleted);
+	}
+
+	TEXT *prev = prevNode(deleted);
+	recordDelete(offset - 1, 1);
+	freeNode(deleted);
+	trackNodes(-1);
+	return prev;
 }
 
 /**
@@ -796,48 +3183,319 @@ void runApp(TEXT *headNode, char *fileName)
 	TEXT *editedNode = NULL;
 	dataCopied cpyData = {NULL, {0, 0}, {0, 0}, false, false, 0};
 	coordinates xy = {_margins.left + 1, 0};
+	char name[FILENAME_SIZE] = "", path[FILENAME_SIZE];
+	snprintf(name, FILENAME_SIZE, "%s", fileName != NULL ? fileName : "");
+	fileName = fileName != NULL ? name : NULL;
 	
 	updateCoordinatesInView(&headNode);
 	printText(headNode, xy);
-	_fileSize = getFileSizeFromList(headNode);
+	refresh();
+
+	// A file recovered from its journal differs from the file on disk.
+	_fileSize = wasJournalReplayed() ? -1 : getFileSizeFromList(headNode);
 
-	for (int ch = 0, is_running = true; is_running; ch = getch())
+	watchFile(fileName);
+	setHighlightLanguage(fileName);
+	openEventLoop();
+	bool isPrintSkipped = false;
+	// No key is read after the last one, the loop ends as soon as the editor exits.
+	for (int ch = 0, is_running = true; is_running; ch = is_running ? nextKey(headNode) : 0)
 	{
 		_view = getmaxy(stdscr); 
+		int prevViewStart = _viewStart, prevLeftMargin = _margins.left, prevY = xy.y, mode = setMode(ch);
+		coordinates openedXy = {-1, -1};
+		long long keyTime = getTimeNs(), stageTime = keyTime;
+		long editLine = getLineAtRow(_viewStart, xy.y), lines = 0;
+
+		// The lines before the key are only counted for the modes that compare them to the lines afterwards, typing counts its own.
+		long lineCount = mode == CUT || mode == PASTE || mode == BRACKETED_PASTE || mode == REPLAY_MACRO ? getLineCount(headNode) : 0;
+
+		// Only the file itself can change the text while it is followed.
+		if (_isFollowing && mode != FOLLOW_FILE && mode != FILE_CHANGED && mode != SHOW_STATS && mode != SHOW_MEMORY && mode != EXIT)
+		{
+			continue;
+		}
+
+		// Any other mode may have changed the end of the list.
+		_streamTail = mode == READ_STREAM ? _streamTail : NULL;
+
+		// The extra cursors only follow typing and moving along the line, any other change to the text removes them.
+		if (mode == CUT || mode == PASTE || mode == BRACKETED_PASTE || mode == OPEN_FILE || mode == SWITCH_DOCUMENT || mode == FILE_CHANGED || mode == FOLLOW_FILE || mode == SEARCH_PROJECT || mode == LINE_OPERATION)
+		{
+			clearCursors();
+		}
+
+		setLatencySizeClass(_fileSize);
+		traceBegin(_modeNames[mode]);
 		
-		switch (setMode(ch))
+		switch (mode)
 		{
 			case EDIT:  
-				editedNode = edit(&headNode, xy, ch);
+				if (hasCursors() && (ch == KEY_BACKSPACE || isTextKey(ch)))
+				{
+					editedNode = editCursors(&headNode, xy, ch);
+					break;
+				}
+
+				// The extra cursors follow the cursor along its line.
+				if (hasCursors() && (ch == KEY_LEFT || ch == KEY_RIGHT))
+				{
+					moveCursors(ch == KEY_LEFT ? -1 : 1);
+				}
+				editedNode = edit(&headNode, xy, ch, &lines);
+				if (ch == KEY_BACKSPACE || isTextKey(ch))
+				{
+					moveLines(editLine, lines);
+				}
 				break;
 			case SAVE: 
 				save(headNode, fileName);
 				break;
 			case COPY: 
 				cpyData = copy(cpyData, headNode, xy);
+				recordLatency(STAGE_EDIT, stageTime);
+				traceEnd(_modeNames[mode]);
 				continue; 
 			case CUT: 
 				cpyData = cut(cpyData, &headNode, xy);
+				if (getLineCount(headNode) != lineCount)
+				{
+					clearFolds();
+					clearMarks();
+				}
+
+				// The cut text was marked in the view.
+				editHighlight(_viewStart, getLineAtRow(_viewStart, _view - 1), getLineCount(headNode) - lineCount);
+				recordLatency(STAGE_EDIT, stageTime);
+				traceEnd(_modeNames[mode]);
 				continue;
 			case PASTE: 
-				paste(&headNode, cpyData, xy);
+				cpyData = paste(&headNode, cpyData, xy);
+				moveLines(editLine, getLineCount(headNode) - lineCount);
+				break;
+			case BRACKETED_PASTE:
+				editedNode = pasteFromTerminal(&headNode, xy);
+				moveLines(editLine, getLineCount(headNode) - lineCount);
 				break;
 			case OPEN_FILE:  
-				headNode = openFile(headNode, fileName);
+			{
+				char *newPath = newFileName();
+				openedXy = xy;
+				headNode = openFile(headNode, name, newPath, &openedXy);
+				fileName = name[0] != '\0' ? name : NULL;
+				editedNode = NULL;
+				free(newPath);
+				break;
+			}
+			case LINE_OPERATION:
+				openedXy = xy;
+				headNode = changeLines(&headNode, &openedXy);
+				editedNode = NULL;
+				break;
+			case MARK_LINES:
+				markLines(getLineAtRow(_viewStart, xy.y));
+				recordLatency(STAGE_EDIT, stageTime);
+				traceEnd(_modeNames[mode]);
+				continue;
+			case RECORD_MACRO:
+				if (isRecording())
+				{
+					// ESC + q isn't part of the macro.
+					dropKeys(2);
+					stopRecording();
+				}
+				else
+				{
+					startRecording();
+				}
+				break;
+			case REPLAY_MACRO:
+			{
+				openedXy = xy;
+
+				// A macro can't replay itself, so ESC + r is left out of the macro being recorded.
+				if (isRecording())
+				{
+					dropKeys(2);
+					break;
+				}
+
+				_replayLine = editLine - 1;
+				_replayLineCount = lineCount;
+				// The empty line after the last newline isn't replayed on.
+				long lastLine = findLineStart(headNode, lineCount) == NULL ? lineCount - 1 : lineCount;
+				long times = askNumber("Replay macro, times or 0 for every line: ");
+				startReplay(times == 0 ? lastLine - editLine + 1 : times, times == 0);
+				break;
+			}
+			case MACRO_LINE:
+				openedXy = xy;
+				headNode = goToLine(headNode, nextReplayLine(headNode), &openedXy);
+				editedNode = NULL;
+				break;
+			case SEARCH_PROJECT:
+				openedXy = xy;
+				headNode = searchProject(headNode, name, &openedXy);
+				fileName = name[0] != '\0' ? name : NULL;
+				editedNode = NULL;
+				break;
+			case SWITCH_DOCUMENT:
+				openedXy = xy;
+				headNode = pickCachedDocument(path) ? openFile(headNode, name, path, &openedXy) : headNode;
+				fileName = name[0] != '\0' ? name : NULL;
+				editedNode = NULL;
+				break;
+			case FILE_CHANGED:
+				openedXy = xy;
+				headNode = _isFollowing ? followAppended(headNode, fileName) : reloadFile(headNode, fileName);
+				editedNode = NULL;
+				break;
+			case FOLLOW_FILE:
+				headNode = followFile(headNode, fileName);
+				editedNode = NULL;
+				break;
+			case READ_STREAM:
+				// The cursor is placed at the start of the text when the first text arrives.
+				openedXy = headNode != NULL ? xy : openedXy;
+				headNode = readStreamInput(headNode);
+				editedNode = NULL;
+				break;
+			case JUMP:
+				openedXy = jumpInView(headNode, ch, xy);
+				editedNode = NULL;
+				break;
+			case TEXT_MOTION:
+				editedNode = moveByText(headNode, ch, xy);
+				break;
+			case FOLD:
+			case MARK_FOLD:
+				openedXy = xy;
+				foldLines(headNode, mode, &openedXy);
+				editedNode = NULL;
+				break;
+			case GO_TO_LINE:
+				openedXy = xy;
+				headNode = goToLine(headNode, askNumber("Go to line: ") - 1, &openedXy);
+				editedNode = NULL;
+				break;
+			case GO_TO_TOP:
+				openedXy = xy;
+				headNode = goToLine(headNode, 0, &openedXy);
+				editedNode = NULL;
+				break;
+			case GO_TO_BOTTOM:
+				openedXy = xy;
+				headNode = goToLine(headNode, LONG_MAX, &openedXy);
+				editedNode = NULL;
+				break;
+			case CURSOR_ABOVE:
+			case CURSOR_BELOW:
+				openedXy = xy;
+				addCursorLine(headNode, xy, mode);
+				break;
+			case CURSOR_AT_MATCH:
+				openedXy = xy;
+				addCursorAtMatch(headNode, xy);
+				break;
+			case CLEAR_CURSORS:
+				openedXy = xy;
+				clearCursors();
+				break;
+			case SHOW_STATS:
+				_showStats = !_showStats;
+				break;
+			case SHOW_MEMORY:
+				_showMemory = !_showMemory;
 				break;
 			case EXIT:  
-				saveOnFileChange(headNode, fileName);
+				if (!_isFollowing)
+				{
+					saveOnFileChange(headNode, fileName);
+				}
+				saveModifiedDocuments();
 				is_running = false;
+				traceEnd(_modeNames[mode]);
 				continue; 
 		}
+		stageTime = recordLatency(STAGE_EDIT, stageTime);
+		traceEnd(_modeNames[mode]);
 		
+		traceBegin("render");
 		updateViewPort(xy, ch, headNode, editedNode);
+
+		// Moving the window of a paged file shifts the lines of the list, not the text in view. Typing never moves it.
+		int hiddenLines = _hiddenLines;
+		headNode = mode != EDIT || ch == KEY_UP || ch == KEY_DOWN || _viewStart != prevViewStart ? movePagedWindow(headNode) : headNode;
+		prevViewStart += hiddenLines - _hiddenLines;
+		editedNode = mode == EDIT ? _editedNode : editedNode;
+		stageTime = recordLatency(STAGE_VIEWPORT, stageTime);
 		updateMargins(xy.y, ch, headNode);
+		stageTime = recordLatency(STAGE_MARGINS, stageTime);
 		updateCoordinatesInView(&headNode);
+		stageTime = recordLatency(STAGE_COORDINATES, stageTime);
 		
 		xy = updateCursor(ch, xy, editedNode, headNode);
-		printText(headNode, xy);
+		openedXy.x += mode == READ_STREAM ? _margins.left - prevLeftMargin : 0;
+		xy = openedXy.y != -1 ? openedXy : xy;
+		bool isJump = mode == JUMP || mode == GO_TO_LINE || mode == GO_TO_TOP || mode == GO_TO_BOTTOM || mode == FOLD || mode == MARK_FOLD || mode == MACRO_LINE;
+		xy = isJump ? fitCursorToText(headNode, xy) : xy;
+
+		// The text moves right when the line numbers get wider, the cursor can't be left in the margin.
+		xy.x = xy.x > _margins.left ? xy.x : _margins.left;
+
+		// A replayed macro is printed once, after its last key.
+		if (isReplaying())
+		{
+			isPrintSkipped = true;
+			traceEnd("render");
+			continue;
+		}
+
+		// Scrolling a single line only requires the new line to be printed.
+		int scrolled = _viewStart - prevViewStart;
+		if (_isFollowing && mode == FILE_CHANGED && _margins.left == prevLeftMargin)
+		{
+			printFollowedLines(headNode, xy);
+		}
+		else if (!isPrintSkipped && isScrollStep(ch, scrolled, prevY, prevLeftMargin))
+		{
+			scrollText(headNode, xy, scrolled, ch == '\n' ? _view - 2 : _view - 1);
+		}
+		else
+		{
+			printText(headNode, xy);
+		}
+		isPrintSkipped = false;
+
+		if (_showStats)
+		{
+			printLatencyStats();
+			move(xy.y, xy.x);
+		}
+
+		if (_showMemory)
+		{
+			printMemoryStats();
+			move(xy.y, xy.x);
+		}
+		stageTime = recordLatency(STAGE_PRINT, stageTime);
+
+		refresh();
+		recordLatency(STAGE_REFRESH, stageTime);
+		recordLatency(STAGE_TOTAL, keyTime);
+		traceEnd("render");
 	}
 
+	stopWatchingFile();
+	closeJournal();
 	deleteAllNodes(&headNode);
+	clearLineIndex();
+	resetHighlight();
+	clearCursors();
+	clearMacro();
+	closeSharedClipboard();
+	clearDocumentCache();
+	closeEventLoop();
+	freeViewMap();
+	clearNodePool();
 }
@@ -19,6 +19,34 @@
 #include "fileHandler.h"
 #include "allocHandler.h"
 #include "copy.h"
+#include "latencyStats.h"
+#include "eventTrace.h"
+#include "changeMap.h"
+#include "documentCache.h"
+#include "fileWatch.h"
+#include "streamInput.h"
+#include "lineIndex.h"
+#include "textMotion.h"
+#include "highlight.h"
+#include "multiCursor.h"
+#include "projectSearch.h"
+#include "lineOperation.h"
+#include "viewMap.h"
+#include "macro.h"
+#include "compressedFile.h"
+#include "eventLoop.h"
+
+#define FILE_CHANGED_KEY (KEY_MAX + 1)
+#define STREAM_INPUT_KEY (KEY_MAX + 2)
+#define WORD_LEFT_KEY (KEY_MAX + 3)
+#define WORD_RIGHT_KEY (KEY_MAX + 4)
+#define PARAGRAPH_UP_KEY (KEY_MAX + 5)
+#define PARAGRAPH_DOWN_KEY (KEY_MAX + 6)
+#define EVENT_KEY (KEY_MAX + 8)
+#define MATCH_WORD_SIZE 64
+#define SEARCH_REFRESH_MS 50
+#define COPY_LINES_SIZE 4096
+#define FOLLOW_WINDOW_SIZE (1024L * 1024L)
 
 void *createNodesFromBuffer(char *buffer, long fileSize);
 void runApp(TEXT *headNode, char *fileName);
@@ -0,0 +1,130 @@
+/*
+	Writen by: Oscar Bergström
+	https://github.com/OSCARJFB
+
+	MIT License
+	Copyright (c) 2023 Oscar Bergström
+*/
+
+#define _POSIX_C_SOURCE 200809L
+#include <unistd.h>
+#include <stdint.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include "eventLoop.h"
+
+// Background tasks wake up the editor through the eventfd, the events they posted are kept in the mask.
+static int _eventFd = -1, _timerFd = -1;
+static unsigned int _postedEvents = 0;
+
+/**
+ * Create the descriptors the editor waits on besides the terminal. Without them the editor still works, it only isn't woken up.
+ */
+void openEventLoop(void)
+{
+	if (_eventFd == -1)
+	{
+		_eventFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	}
+
+	if (_timerFd == -1)
+	{
+		_timerFd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+	}
+}
+
+/**
+ * Close the descriptors, the background tasks have to be stopped first.
+ */
+void closeEventLoop(void)
+{
+	if (_eventFd != -1)
+	{
+		close(_eventFd);
+	}
+
+	if (_timerFd != -1)
+	{
+		close(_timerFd);
+	}
+
+	_eventFd = _timerFd = -1;
+	__atomic_store_n(&_postedEvents, 0, __ATOMIC_RELAXED);
+}
+
+/**
+ * The descriptor that is readable when an event was posted.
+ */
+int getEventFd(void)
+{
+	return _eventFd;
+}
+
+/**
+ * The descriptor that is readable when the idle timer expired.
+ */
+int getIdleTimerFd(void)
+{
+	return _timerFd;
+}
+
+/**
+ * Post an event from any thread. The editor is only woken up if the event wasn't already waiting to be taken.
+ */
+void postEvent(unsigned int event)
+{
+	unsigned int posted = __atomic_fetch_or(&_postedEvents, event, __ATOMIC_RELEASE);
+	if ((posted & event) != event && _eventFd != -1)
+	{
+		uint64_t count = 1;
+		ssize_t written = write(_eventFd, &count, sizeof(count));
+		(void)written;
+	}
+}
+
+/**
+ * Take some of the posted events, the others stay posted. Returns the events that were taken.
+ * The eventfd is drained after the events are taken, it's signaled again if events are left so they still wake up the editor.
+ */
+unsigned int takeEvents(unsigned int events)
+{
+	unsigned int taken = __atomic_fetch_and(&_postedEvents, ~events, __ATOMIC_ACQUIRE) & events;
+	if (_eventFd == -1)
+	{
+		return taken;
+	}
+
+	uint64_t count = 0;
+	ssize_t bytes = read(_eventFd, &count, sizeof(count));
+	(void)bytes;
+
+	// An event posted before the read had its wakeup drained along with the others.
+	if (__atomic_load_n(&_postedEvents, __ATOMIC_ACQUIRE) != 0)
+	{
+		count = 1;
+		bytes = write(_eventFd, &count, sizeof(count));
+	}
+
+	return taken;
+}
+
+/**
+ * Let the idle timer expire once after a delay, 0 stops it. Setting it again restarts the delay.
+ */
+void setIdleTimer(int delayMs)
+{
+	struct itimerspec delay = {{0, 0}, {delayMs / 1000, (delayMs % 1000) * 1000000L}};
+	if (_timerFd != -1)
+	{
+		timerfd_settime(_timerFd, 0, &delay, NULL);
+	}
+}
+
+/**
+ * Check if the idle timer expired since it was set.
+ */
+bool readIdleTimer(void)
+{
+	uint64_t expirations = 0;
+	return _timerFd != -1 && read(_timerFd, &expirations, sizeof(expirations)) == sizeof(expirations) && expirations > 0;
+}
@@ -0,0 +1,33 @@
+/*
+	Writen by: Oscar Bergström
+	https://github.com/OSCARJFB
+
+	MIT License
+	Copyright (c) 2023 Oscar Bergström
+*/
+
+#ifndef EVENTLOOP_H
+#define EVENTLOOP_H
+
+#include <stdio.h>
+#include <stdbool.h>
+
+#define IDLE_DELAY_MS 100
+#define IDLE_LEX_LINES 256
+
+// Events posted by background tasks, each is a bit so events posted before they're taken are merged.
+enum postedEvent
+{
+	EVENT_SEARCH_RESULTS = 1
+};
+
+void openEventLoop(void);
+void closeEventLoop(void);
+int getEventFd(void);
+int getIdleTimerFd(void);
+void postEvent(unsigned int event);
+unsigned int takeEvents(unsigned int events);
+void setIdleTimer(int delayMs);
+bool readIdleTimer(void);
+
+#endif // EVENTLOOP_H
@@ -0,0 +1,231 @@
+/*
+	Writen by: Oscar Bergström
+	https://github.com/OSCARJFB
+
+	MIT License
+	Copyright (c) 2023 Oscar Bergström
+*/
+
+#define _POSIX_C_SOURCE 200809L
+#include <pthread.h>
+#include <time.h>
+#include "eventTrace.h"
+#include "allocHandler.h"
+#include "latencyStats.h"
+
+#define TRACE_RING_SIZE 16384
+#define MAX_TRACE_THREADS 32
+#define FLUSH_INTERVAL_NS 50000000L
+
+typedef struct traceEvent
+{
+	const char *name;
+	long long time;
+	char phase;
+} traceEvent;
+
+typedef struct traceBuffer
+{
+	traceEvent events[TRACE_RING_SIZE];
+	unsigned long head, tail, dropped;
+	int id;
+} traceBuffer;
+
+static FILE *_traceFile = NULL;
+static bool _isTracing = false;
+static bool _isFlushing = false;
+static bool _isFirstEvent = true;
+static long long _traceStart = 0;
+static pthread_t _flushThread;
+static traceBuffer *_buffers[MAX_TRACE_THREADS];
+static int _bufferCount = 0;
+static __thread traceBuffer *_threadBuffer = NULL;
+
+static traceBuffer *getThreadBuffer(void);
+static void addTraceEvent(const char *name, char phase);
+static void flushTraceBuffer(traceBuffer *buffer);
+static void *flushTrace(void *arg);
+
+/**
+ * Start writing trace events to a file in the Chrome trace format.
+ * Tracing stays disabled if path is NULL or the file can't be created.
+ */
+void startTrace(const char *path)
+{
+	if (path == NULL || _isTracing)
+	{
+		return;
+	}
+
+	_traceFile = fopen(path, "w");
+	if (_traceFile == NULL)
+	{
+		return;
+	}
+
+	fprintf(_traceFile, "{\"traceEvents\":[");
+	_traceStart = getTimeNs();
+	_isFlushing = true;
+	if (pthread_create(&_flushThread, NULL, flushTrace, NULL) != 0)
+	{
+		fclose(_traceFile);
+		_traceFile = NULL;
+		return;
+	}
+
+	__atomic_store_n(&_isTracing, true, __ATOMIC_RELEASE);
+}
+
+/**
+ * Stop tracing, write any remaining events and close the trace file.
+ */
+void stopTrace(void)
+{
+	if (!_isTracing)
+	{
+		return;
+	}
+
+	__atomic_store_n(&_isTracing, false, __ATOMIC_RELEASE);
+	__atomic_store_n(&_isFlushing, false, __ATOMIC_RELEASE);
+	pthread_join(_flushThread, NULL);
+
+	int bufferCount = __atomic_load_n(&_bufferCount, __ATOMIC_ACQUIRE);
+	for (int i = 0; i < bufferCount && i < MAX_TRACE_THREADS; ++i)
+	{
+		if (_buffers[i] == NULL)
+		{
+			continue;
+		}
+
+		flushTraceBuffer(_buffers[i]);
+		if (_buffers[i]->dropped > 0)
+		{
+			fprintf(_traceFile, "%s\n{\"name\":\"dropped %lu events\",\"ph\":\"i\",\"s\":\"t\",\"pid\":1,\"tid\":%d,\"ts\":0}",
+					_isFirstEvent ? "" : ",", _buffers[i]->dropped, _buffers[i]->id);
+			_isFirstEvent = false;
+		}
+	}
+
+	fprintf(_traceFile, "\n]}\n");
+	fclose(_traceFile);
+	_traceFile = NULL;
+}
+
+/**
+ * Mark the start of an operation, name must point to a string that outlives the trace (a string literal).
+ */
+void traceBegin(const char *name)
+{
+	if (__atomic_load_n(&_isTracing, __ATOMIC_ACQUIRE))
+	{
+		addTraceEvent(name, 'B');
+	}
+}
+
+/**
+ * Mark the end of an operation started with traceBegin.
+ */
+void traceEnd(const char *name)
+{
+	if (__atomic_load_n(&_isTracing, __ATOMIC_ACQUIRE))
+	{
+		addTraceEvent(name, 'E');
+	}
+}
+
+/**
+ * Every thread writes its events into a buffer of its own, this buffer is created the first time the thread traces anything.
+ * Returns NULL if there are too many threads.
+ */
+static traceBuffer *getThreadBuffer(void)
+{
+	if (_threadBuffer != NULL)
+	{
+		return _threadBuffer;
+	}
+
+	int id = __atomic_fetch_add(&_bufferCount, 1, __ATOMIC_ACQ_REL);
+	if (id >= MAX_TRACE_THREADS)
+	{
+		return NULL;
+	}
+
+	traceBuffer *buffer = memAlloc(malloc(sizeof(traceBuffer)), sizeof(traceBuffer));
+	buffer->head = buffer->tail = buffer->dropped = 0;
+	buffer->id = id + 1;
+	__atomic_store_n(&_buffers[id], buffer, __ATOMIC_RELEASE);
+	_threadBuffer = buffer;
+	return buffer;
+}
+
+/**
+ * Add an event to the ring buffer of the calling thread without taking any lock.
+ * Only this thread moves the head and only the flushing thread moves the tail, if the ring is full the event is dropped.
+ */
+static void addTraceEvent(const char *name, char phase)
+{
+	traceBuffer *buffer = getThreadBuffer();
+	if (buffer == NULL)
+	{
+		return;
+	}
+
+	unsigned long head = buffer->head;
+	if (head - __atomic_load_n(&buffer->tail, __ATOMIC_ACQUIRE) == TRACE_RING_SIZE)
+	{
+		++buffer->dropped;
+		return;
+	}
+
+	traceEvent *event = &buffer->events[head % TRACE_RING_SIZE];
+	event->name = name;
+	event->time = getTimeNs();
+	event->phase = phase;
+	__atomic_store_n(&buffer->head, head + 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * Write all events added to a buffer since the last flush to the trace file.
+ */
+static void flushTraceBuffer(traceBuffer *buffer)
+{
+	if (buffer == NULL)
+	{
+		return;
+	}
+
+	unsigned long tail = buffer->tail, head = __atomic_load_n(&buffer->head, __ATOMIC_ACQUIRE);
+	for (; tail != head; ++tail)
+	{
+		const traceEvent *event = &buffer->events[tail % TRACE_RING_SIZE];
+		fprintf(_traceFile, "%s\n{\"name\":\"%s\",\"ph\":\"%c\",\"pid\":1,\"tid\":%d,\"ts\":%.3f}", _isFirstEvent ? "" : ",",
+				event->name, event->phase, buffer->id, (event->time - _traceStart) / 1000.0);
+		_isFirstEvent = false;
+	}
+
+	__atomic_store_n(&buffer->tail, tail, __ATOMIC_RELEASE);
+}
+
+/**
+ * The trace file is written by a thread of its own, keeping file writes out of the traced operations.
+ */
+static void *flushTrace(void *arg)
+{
+	(void)arg;
+	const struct timespec interval = {0, FLUSH_INTERVAL_NS};
+
+	while (__atomic_load_n(&_isFlushing, __ATOMIC_ACQUIRE))
+	{
+		int bufferCount = __atomic_load_n(&_bufferCount, __ATOMIC_ACQUIRE);
+		for (int i = 0; i < bufferCount && i < MAX_TRACE_THREADS; ++i)
+		{
+			flushTraceBuffer(__atomic_load_n(&_buffers[i], __ATOMIC_ACQUIRE));
+		}
+
+		fflush(_traceFile);
+		nanosleep(&interval, NULL);
+	}
+
+	return NULL;
+}
@@ -0,0 +1,20 @@
+/*
+	Writen by: Oscar Bergström
+	https://github.com/OSCARJFB
+
+	MIT License
+	Copyright (c) 2023 Oscar Bergström
+*/
+
+#ifndef EVENTTRACE_H
+#define EVENTTRACE_H
+
+#include <stdio.h>
+#include <stdbool.h>
+
+void startTrace(const char *path);
+void stopTrace(void);
+void traceBegin(const char *name);
+void traceEnd(const char *name);
+
+#endif // EVENTTRACE_H
@@ -6,14 +6,24 @@
 	Copyright (c) 2023 Oscar Bergström
 */
 
+#define _POSIX_C_SOURCE 200809L
+#include <unistd.h>
+#include <string.h>
+#include <sys/stat.h>
 #include "fileHandler.h"
 
+static FILE *_terminal = NULL;
+
 static FILE *getFileFromArg(int argc, char **argv);
 static FILE *getFile(const char *path);
 static void closeFile(FILE *fp);
 static long getFileSize(FILE *fp);
 static char *allocateBuffer(int fileSize);
-static void freeBuffer(char *buffer);
+static void freeBuffer(char *buffer, long fileSize);
+static bool isOpenWithinBudget(long fileSize);
+static bool isStreamed(FILE *fp);
+static char *loadFirstPage(const char *fileName, long *fileSize);
+static void *loadCompressedFile(const char *fileName);
 static void loadBuffer(char *buffer, FILE *fp, long fileSize);
 
 /**
@@ -26,6 +36,12 @@ static FILE *getFileFromArg(int argc, char **argv)
 		return NULL;
 	}
 
+	// "-" reads the text from stdin, unless stdin is the terminal.
+	if (strcmp(argv[1], "-") == 0)
+	{
+		return isatty(STDIN_FILENO) ? NULL : fdopen(dup(STDIN_FILENO), "r");
+	}
+
 	FILE *fp = fopen(argv[1], "r");
 	if (fp == NULL)
 	{
@@ -99,19 +115,21 @@ static char *allocateBuffer(int fileSize)
 	}
 
 	char *buffer = memAlloc(malloc(fileSize), fileSize);
+	trackMemory(MEM_BUFFERS, fileSize);
 	return buffer;
 }
 
 /**
  * Allocate a buffer having the size of the file.
  */
-static void freeBuffer(char *buffer)
+static void freeBuffer(char *buffer, long fileSize)
 {
 	if (buffer == NULL)
 	{
 		return;
 	}
 
+	trackMemory(MEM_BUFFERS, -fileSize);
 	free(buffer);
 	buffer = NULL;
 }
@@ -132,6 +150,47 @@ static void loadBuffer(char *buffer, FILE *fp, long fileSize)
 	};
 }
 
+/**
+ * Check if a file can be loaded without going over the memory budget.
+ * Loading needs the file buffer and one node for each character.
+ */
+static bool isOpenWithinBudget(long fileSize)
+{
+	return fileSize <= 0 || isWithinMemoryBudget(fileSize + getNodesCost(fileSize));
+}
+
+/**
+ * Files that can't be seeked, like pipes, are read as a stream instead of being loaded at once.
+ */
+static bool isStreamed(FILE *fp)
+{
+	struct stat fileStat;
+	return fp != NULL && fstat(fileno(fp), &fileStat) == 0 && !S_ISREG(fileStat.st_mode);
+}
+
+/**
+ * Open a file that is too large to be loaded at once, only its first page is loaded into the buffer.
+ * Returns NULL if the file can't be opened.
+ */
+static char *loadFirstPage(const char *fileName, long *fileSize)
+{
+	if (!openPagedFile(fileName))
+	{
+		*fileSize = 0;
+		return NULL;
+	}
+
+	return readWindow(0, fileSize);
+}
+
+/**
+ * The descriptor keys are read from.
+ */
+int getTerminalFd(void)
+{
+	return _terminal != NULL ? fileno(_terminal) : STDIN_FILENO;
+}
+
 /**
  * ncurses settings.
  */
@@ -139,33 +198,115 @@ static void curseMode(bool isCurse)
 {
 	if (isCurse)
 	{
-		initscr();
+		// When the text is read from stdin the keys have to be read from the terminal itself.
+		if (!isatty(STDIN_FILENO) && (_terminal = fopen("/dev/tty", "r+")) != NULL)
+		{
+			newterm(NULL, _terminal, _terminal);
+		}
+		else
+		{
+			initscr();
+		}
 		cbreak();
 		noecho();
 		curs_set(1);
 		keypad(stdscr, TRUE);
+		idlok(stdscr, TRUE);
+
+		// Let the terminal mark pasted text, so it can be inserted as one block.
+		fputs(PASTE_MODE_ON, _terminal != NULL ? _terminal : stdout);
+		fflush(_terminal != NULL ? _terminal : stdout);
 	}
 	else
 	{
+		fputs(PASTE_MODE_OFF, _terminal != NULL ? _terminal : stdout);
+		fflush(_terminal != NULL ? _terminal : stdout);
 		endwin();
+
+		if (_terminal != NULL)
+		{
+			fclose(_terminal);
+			_terminal = NULL;
+		}
 	}
 }
 
+/**
+ * Decompress a whole file and create the list from it, a file opened from the editor is loaded before it's shown.
+ */
+static void *loadCompressedFile(const char *fileName)
+{
+	long fileSize = 0;
+	char *buffer = readDecompressed(fileName, &fileSize);
+	if (!isOpenWithinBudget(fileSize))
+	{
+		freeBuffer(buffer, fileSize);
+		wclear(stdscr);
+		printw("%s is too large for the memory budget, press any key to continue", fileName);
+		wgetch(stdscr);
+		return NULL;
+	}
+
+	void *newHeadNode = createNodesFromBuffer(buffer, fileSize);
+	freeBuffer(buffer, fileSize);
+	if (newHeadNode != NULL)
+	{
+		resetChangeMap(NULL, fileSize);
+		closePagedFile();
+	}
+	return newHeadNode;
+}
+
 /**
  * This function is very similar to startUp.
  * It is used when loading a new file.
  */
-void *reStart(char *fileName)
+void *reStart(const char *fileName)
 {
 	FILE *fp = getFile(fileName);
+	traceBegin("getFileSize");
 	long fileSize = getFileSize(fp);
+	traceEnd("getFileSize");
+
+	if (fp != NULL && getCompression(fileName) != COMPRESSION_NONE)
+	{
+		closeFile(fp);
+		return loadCompressedFile(fileName);
+	}
+
+	// Files too large to be loaded at once are edited a few pages at a time.
+	if (isPagedSize(fileSize))
+	{
+		closeFile(fp);
+		char *buffer = loadFirstPage(fileName, &fileSize);
+		void *newHeadNode = createNodesFromBuffer(buffer, fileSize);
+		freeBuffer(buffer, fileSize);
+		resetChangeMap(NULL, fileSize);
+		return newHeadNode;
+	}
+
+	if (!isOpenWithinBudget(fileSize))
+	{
+		closeFile(fp);
+		wclear(stdscr);
+		printw("%s is too large for the memory budget, press any key to continue", fileName);
+		wgetch(stdscr);
+		return NULL;
+	}
 
 	char *buffer = allocateBuffer(fileSize);
+	traceBegin("loadBuffer");
 	loadBuffer(buffer, fp, fileSize);
-	createNodesFromBuffer(buffer, fileSize);
-
+	traceEnd("loadBuffer");
+	closeFile(fp);
+	buffer = replayJournal(fileName, buffer, &fileSize);
 	void *newHeadNode = createNodesFromBuffer(buffer, fileSize);
-	freeBuffer(buffer);
+	freeBuffer(buffer, fileSize);
+	if (newHeadNode != NULL)
+	{
+		resetChangeMap(wasJournalReplayed() ? NULL : fileName, fileSize);
+		closePagedFile();
+	}
 	return newHeadNode;
 }
 
@@ -177,14 +318,72 @@ void *reStart(char *fileName)
 void startUp(int argc, char **argv)
 {
 	allocateBackUp();
+	setMemoryBudget(getenv("OB_MEM_BUDGET"));
+	startTrace(getenv("OB_TRACE_FILE"));
+	setDocumentCacheLimit(getenv("OB_CACHE_MB"));
+	setPagedFileLimit(getenv("OB_PAGED_MB"));
 	FILE *fp = getFileFromArg(argc, argv);
+	char *fileName = argc >= 2 ? argv[1] : NULL;
+
+	// Text from stdin or a pipe is read while editing, a file name is asked for when it's saved.
+	if (isStreamed(fp))
+	{
+		openStream(dup(fileno(fp)));
+		closeFile(fp);
+		fp = NULL;
+		fileName = NULL;
+	}
+
+	// A compressed file is decompressed in the background and read as a stream, the first screen is shown before all of it has arrived.
+	if (fp != NULL && getCompression(fileName) != COMPRESSION_NONE)
+	{
+		closeFile(fp);
+		fp = NULL;
+		int fd = openDecompression(fileName);
+		if (fd == -1)
+		{
+			stopTrace();
+			fprintf(stderr, "%s can't be decompressed, gzip or zstd is needed\n", fileName);
+			return;
+		}
+		openStream(fd);
+	}
+
+	traceBegin("getFileSize");
 	long fileSize = getFileSize(fp);
-	char *buffer = allocateBuffer(fileSize);
-	loadBuffer(buffer, fp, fileSize);
+	traceEnd("getFileSize");
+
+	bool isPagedFile = fileName != NULL && isPagedSize(fileSize);
+	if (!isPagedFile && !isOpenWithinBudget(fileSize))
+	{
+		closeFile(fp);
+		stopTrace();
+		fprintf(stderr, "%s is too large for the memory budget (%ld MB needed)\n", argv[1],
+				(fileSize + getNodesCost(fileSize)) / (1024L * 1024L) + 1);
+		return;
+	}
+	char *buffer = isPagedFile ? loadFirstPage(fileName, &fileSize) : allocateBuffer(fileSize);
+	traceBegin("loadBuffer");
+	loadBuffer(isPagedFile ? NULL : buffer, fp, fileSize);
+	traceEnd("loadBuffer");
 	closeFile(fp);
+
+	// Recover any edits that weren't saved the last time the file was open, a paged file isn't journaled.
+	if (fileName != NULL && !isPagedFile)
+	{
+		buffer = replayJournal(fileName, buffer, &fileSize);
+		openJournal(fileName);
+	}
+	resetChangeMap(!isPagedFile && !wasJournalReplayed() ? fileName : NULL, fileSize);
 	void *headNode = createNodesFromBuffer(buffer, fileSize);
-	freeBuffer(buffer);
+	freeBuffer(buffer, fileSize);
 	curseMode(true);
-	runApp(headNode, argv[1]);
+	runApp(headNode, fileName);
 	curseMode(false);
+	closeStream();
+	closeDecompression();
+	closePagedFile();
+	dumpLatencyStats(getenv("OB_STATS_FILE"));
+	stopTrace();
+	reportMemoryUsage(stderr);
 }
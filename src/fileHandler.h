@@ -14,8 +14,11 @@
 #include <stdbool.h>
 #include "allocHandler.h"
 #include "editorMode.h"
+#include "streamInput.h"
+#include "compressedFile.h"
 
-void *reStart(char *fileName);
+void *reStart(const char *fileName);
 void startUp(int argc, char **argv);
+int getTerminalFd(void);
 
 #endif // FILEHANDLER_H
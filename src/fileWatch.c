@@ -0,0 +1,311 @@
+/*
+	Writen by: Oscar Bergström
+	https://github.com/OSCARJFB
+
+	MIT License
+	Copyright (c) 2023 Oscar Bergström
+*/
+
+#define _POSIX_C_SOURCE 200809L
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdint.h>
+#include <sys/stat.h>
+#include <sys/inotify.h>
+#include "fileWatch.h"
+
+#define WATCH_EVENTS (IN_MODIFY | IN_CLOSE_WRITE | IN_ATTRIB | IN_CREATE | IN_DELETE | IN_MOVED_TO | IN_MOVED_FROM)
+
+static int _watchFd = -1, _watchId = -1;
+static char *_fileName = NULL;
+static const char *_baseName = NULL;
+static struct stat _fileStat;
+static bool _isKnown = false;
+static uint64_t _tailHash = 0;
+
+static uint64_t hashTail(int fd, long end);
+static void updateFileState(void);
+
+/**
+ * Hash the last FILE_TAIL_SIZE bytes before the end offset.
+ * If the hash is the same later on, the text before the end offset is taken to be the same.
+ */
+static uint64_t hashTail(int fd, long end)
+{
+	char tail[FILE_TAIL_SIZE];
+	long start = end > FILE_TAIL_SIZE ? end - FILE_TAIL_SIZE : 0;
+	ssize_t length = pread(fd, tail, end - start, start);
+
+	// FNV-1a
+	uint64_t hash = 14695981039346656037ULL;
+	for (ssize_t i = 0; i < length; ++i)
+	{
+		hash = (hash ^ (unsigned char)tail[i]) * 1099511628211ULL;
+	}
+
+	return length == end - start ? hash : 0;
+}
+
+/**
+ * Store the state of the watched file, later changes are compared to this state.
+ */
+static void updateFileState(void)
+{
+	int fd = open(_fileName, O_RDONLY);
+	_isKnown = fd != -1 && fstat(fd, &_fileStat) == 0;
+	_tailHash = _isKnown ? hashTail(fd, _fileStat.st_size) : 0;
+
+	if (fd != -1)
+	{
+		close(fd);
+	}
+}
+
+/**
+ * Start watching a file for changes made by other programs, the file as it is now is the known state.
+ * This is called again after the editor itself has written the file.
+ */
+void watchFile(const char *fileName)
+{
+	if (fileName == NULL)
+	{
+		return;
+	}
+
+	if (_watchFd == -1 && (_watchFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC)) == -1)
+	{
+		return;
+	}
+
+	if (_watchId != -1)
+	{
+		inotify_rm_watch(_watchFd, _watchId);
+		_watchId = -1;
+	}
+
+	long size = strlen(fileName) + 1;
+	char *name = memAlloc(malloc(size), size);
+	strcpy(name, fileName);
+	free(_fileName);
+	_fileName = name;
+
+	// Files are often saved by renaming a new file over the old one, so the directory is watched rather than the file.
+	char *slash = strrchr(_fileName, '/');
+	if (slash == NULL)
+	{
+		_watchId = inotify_add_watch(_watchFd, ".", WATCH_EVENTS);
+		_baseName = _fileName;
+	}
+	else
+	{
+		*slash = '\0';
+		_watchId = inotify_add_watch(_watchFd, slash == _fileName ? "/" : _fileName, WATCH_EVENTS);
+		*slash = '/';
+		_baseName = slash + 1;
+	}
+
+	updateFileState();
+}
+
+/**
+ * Stop watching and release the inotify instance.
+ */
+void stopWatchingFile(void)
+{
+	if (_watchFd != -1)
+	{
+		close(_watchFd);
+	}
+
+	_watchFd = _watchId = -1;
+	free(_fileName);
+	_fileName = NULL;
+	_baseName = NULL;
+}
+
+/**
+ * The descriptor is readable when there are events to read, -1 if no file is watched.
+ */
+int getFileWatchFd(void)
+{
+	return _watchId != -1 ? _watchFd : -1;
+}
+
+/**
+ * Read every waiting event without blocking.
+ * Returns true if any of them concerns the watched file.
+ */
+bool readFileEvents(void)
+{
+	union
+	{
+		struct inotify_event event;
+		char data[4096];
+	} events;
+
+	bool isWatchedFile = false;
+	for (ssize_t length = 0; _watchFd != -1 && (length = read(_watchFd, events.data, sizeof(events.data))) > 0;)
+	{
+		for (char *next = events.data; next < events.data + length;)
+		{
+			struct inotify_event *event = (struct inotify_event *)next;
+			isWatchedFile = isWatchedFile || (event->mask & IN_Q_OVERFLOW) || (event->len > 0 && strcmp(event->name, _baseName) == 0);
+			next += sizeof(struct inotify_event) + event->len;
+		}
+	}
+
+	return isWatchedFile;
+}
+
+/**
+ * Compare the watched file to its known state.
+ * The file counts as appended to if it grew and the end of the known text is still the same. A removed file counts as unchanged.
+ */
+int getFileChange(void)
+{
+	struct stat current;
+	if (_fileName == NULL || stat(_fileName, &current) != 0)
+	{
+		return FILE_UNCHANGED;
+	}
+
+	if (_isKnown && current.st_ino == _fileStat.st_ino && current.st_size == _fileStat.st_size &&
+		current.st_mtim.tv_sec == _fileStat.st_mtim.tv_sec && current.st_mtim.tv_nsec == _fileStat.st_mtim.tv_nsec)
+	{
+		return FILE_UNCHANGED;
+	}
+
+	if (!_isKnown || current.st_ino != _fileStat.st_ino || current.st_size <= _fileStat.st_size)
+	{
+		return FILE_REPLACED;
+	}
+
+	int fd = open(_fileName, O_RDONLY);
+	bool isAppended = fd != -1 && hashTail(fd, _fileStat.st_size) == _tailHash;
+	if (fd != -1)
+	{
+		close(fd);
+	}
+
+	return isAppended ? FILE_APPENDED : FILE_REPLACED;
+}
+
+/**
+ * Read the text appended to the watched file since its known state, which then includes the text.
+ * The returned buffer is counted as MEM_BUFFERS memory, NULL is returned if nothing was appended.
+ */
+char *readAppendedText(long *size)
+{
+	*size = 0;
+	struct stat current;
+	int fd = _fileName != NULL ? open(_fileName, O_RDONLY) : -1;
+	if (fd == -1 || fstat(fd, &current) != 0 || current.st_size <= _fileStat.st_size)
+	{
+		if (fd != -1)
+		{
+			close(fd);
+		}
+		return NULL;
+	}
+
+	long length = current.st_size - _fileStat.st_size;
+	char *text = memAlloc(malloc(length), length);
+	for (long done = 0; done < length;)
+	{
+		ssize_t bytes = pread(fd, text + done, length - done, _fileStat.st_size + done);
+		if (bytes <= 0)
+		{
+			length = done;
+			break;
+		}
+		done += bytes;
+	}
+
+	trackMemory(MEM_BUFFERS, length);
+
+	// If less was read than expected the rest is found by the next check.
+	current.st_size = _fileStat.st_size + length;
+	_fileStat = current;
+	_tailHash = hashTail(fd, _fileStat.st_size);
+	close(fd);
+
+	*size = length;
+	return text;
+}
+
+/**
+ * Read the end of the watched file, at most maxSize characters starting at a line, the file as it is now becomes the known state.
+ * The lines before the returned text are only counted into skippedLines. The buffer is counted as MEM_BUFFERS memory, NULL is returned if nothing was read.
+ */
+char *readFileTail(long maxSize, long *size, int *skippedLines)
+{
+	*size = *skippedLines = 0;
+	int fd = _fileName != NULL ? open(_fileName, O_RDONLY) : -1;
+	if (fd == -1 || fstat(fd, &_fileStat) != 0)
+	{
+		_isKnown = false;
+		if (fd != -1)
+		{
+			close(fd);
+		}
+		return NULL;
+	}
+
+	// The skipped text is streamed through a small buffer, only its newlines are needed.
+	char chunk[FILE_TAIL_SIZE * 16];
+	long start = _fileStat.st_size > maxSize ? _fileStat.st_size - maxSize : 0;
+	for (long offset = 0; offset < start;)
+	{
+		ssize_t bytes = pread(fd, chunk, start - offset < (long)sizeof(chunk) ? start - offset : (long)sizeof(chunk), offset);
+		if (bytes <= 0)
+		{
+			break;
+		}
+
+		for (char *newLine = chunk; (newLine = memchr(newLine, '\n', chunk + bytes - newLine)) != NULL; ++newLine)
+		{
+			++*skippedLines;
+		}
+		offset += bytes;
+	}
+
+	long length = _fileStat.st_size - start;
+	char *text = length > 0 ? memAlloc(malloc(length), length) : NULL;
+	for (long done = 0; done < length;)
+	{
+		ssize_t bytes = pread(fd, text + done, length - done, start + done);
+		if (bytes <= 0)
+		{
+			length = done;
+			break;
+		}
+		done += bytes;
+	}
+
+	// The text starts after the first newline unless it begins the file, a line cut in half isn't shown.
+	char *newLine = start > 0 ? memchr(text, '\n', length) : NULL;
+	long cut = newLine != NULL && newLine + 1 < text + length ? newLine + 1 - text : 0;
+	if (cut > 0)
+	{
+		memmove(text, text + cut, length - cut);
+		++*skippedLines;
+		length -= cut;
+	}
+
+	_fileStat.st_size = start + cut + length;
+	_isKnown = true;
+	_tailHash = hashTail(fd, _fileStat.st_size);
+	close(fd);
+
+	if (length == 0)
+	{
+		free(text);
+		return NULL;
+	}
+
+	text = memAlloc(realloc(text, length), length);
+	trackMemory(MEM_BUFFERS, length);
+	*size = length;
+	return text;
+}
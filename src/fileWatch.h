@@ -0,0 +1,33 @@
+/*
+	Writen by: Oscar Bergström
+	https://github.com/OSCARJFB
+
+	MIT License
+	Copyright (c) 2023 Oscar Bergström
+*/
+
+#ifndef FILEWATCH_H
+#define FILEWATCH_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include "allocHandler.h"
+
+#define FILE_TAIL_SIZE 4096
+
+enum fileChange
+{
+	FILE_UNCHANGED,
+	FILE_APPENDED,
+	FILE_REPLACED
+};
+
+void watchFile(const char *fileName);
+void stopWatchingFile(void);
+int getFileWatchFd(void);
+bool readFileEvents(void);
+int getFileChange(void);
+char *readAppendedText(long *size);
+char *readFileTail(long maxSize, long *size, int *skippedLines);
+
+#endif // FILEWATCH_H
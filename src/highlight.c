@@ -0,0 +1,470 @@
+/*
+	Writen by: Oscar Bergström
+	https://github.com/OSCARJFB
+
+	MIT License
+	Copyright (c) 2023 Oscar Bergström
+*/
+
+#include <ctype.h>
+#include <string.h>
+#include "highlight.h"
+
+typedef struct keyword
+{
+	const char *word;
+	int highlightClass;
+} keyword;
+
+static const keyword _cKeywords[] =
+{
+	{"auto", HIGHLIGHT_KEYWORD}, {"bool", HIGHLIGHT_KEYWORD}, {"break", HIGHLIGHT_KEYWORD}, {"case", HIGHLIGHT_KEYWORD},
+	{"char", HIGHLIGHT_KEYWORD}, {"const", HIGHLIGHT_KEYWORD}, {"continue", HIGHLIGHT_KEYWORD}, {"default", HIGHLIGHT_KEYWORD},
+	{"do", HIGHLIGHT_KEYWORD}, {"double", HIGHLIGHT_KEYWORD}, {"else", HIGHLIGHT_KEYWORD}, {"enum", HIGHLIGHT_KEYWORD},
+	{"extern", HIGHLIGHT_KEYWORD}, {"false", HIGHLIGHT_KEYWORD}, {"float", HIGHLIGHT_KEYWORD}, {"for", HIGHLIGHT_KEYWORD},
+	{"goto", HIGHLIGHT_KEYWORD}, {"if", HIGHLIGHT_KEYWORD}, {"inline", HIGHLIGHT_KEYWORD}, {"int", HIGHLIGHT_KEYWORD},
+	{"long", HIGHLIGHT_KEYWORD}, {"NULL", HIGHLIGHT_KEYWORD}, {"register", HIGHLIGHT_KEYWORD}, {"restrict", HIGHLIGHT_KEYWORD},
+	{"return", HIGHLIGHT_KEYWORD}, {"short", HIGHLIGHT_KEYWORD}, {"signed", HIGHLIGHT_KEYWORD}, {"sizeof", HIGHLIGHT_KEYWORD},
+	{"static", HIGHLIGHT_KEYWORD}, {"struct", HIGHLIGHT_KEYWORD}, {"switch", HIGHLIGHT_KEYWORD}, {"true", HIGHLIGHT_KEYWORD},
+	{"typedef", HIGHLIGHT_KEYWORD}, {"union", HIGHLIGHT_KEYWORD}, {"unsigned", HIGHLIGHT_KEYWORD}, {"void", HIGHLIGHT_KEYWORD},
+	{"volatile", HIGHLIGHT_KEYWORD}, {"while", HIGHLIGHT_KEYWORD}, {NULL, HIGHLIGHT_NONE}
+};
+
+static const keyword _jsonKeywords[] =
+{
+	{"true", HIGHLIGHT_KEYWORD}, {"false", HIGHLIGHT_KEYWORD}, {"null", HIGHLIGHT_KEYWORD}, {NULL, HIGHLIGHT_NONE}
+};
+
+// Log levels are compared in upper case.
+static const keyword _logKeywords[] =
+{
+	{"FATAL", HIGHLIGHT_ERROR}, {"CRITICAL", HIGHLIGHT_ERROR}, {"CRIT", HIGHLIGHT_ERROR}, {"ERROR", HIGHLIGHT_ERROR},
+	{"ERR", HIGHLIGHT_ERROR}, {"WARNING", HIGHLIGHT_WARNING}, {"WARN", HIGHLIGHT_WARNING}, {"NOTICE", HIGHLIGHT_INFO},
+	{"INFO", HIGHLIGHT_INFO}, {"DEBUG", HIGHLIGHT_DEBUG}, {"TRACE", HIGHLIGHT_DEBUG}, {NULL, HIGHLIGHT_NONE}
+};
+
+static int _language = LANGUAGE_NONE;
+static chtype _attributes[HIGHLIGHT_CLASSES];
+static bool _isColorReady = false;
+
+// The lexer state at the start of each line, only C has states that continue on the next line.
+// States up to _verifiedLine are right, the states after it are from before the last edit and are checked against the lexed text.
+static unsigned char *_lineStates = NULL;
+static long _stateCount = 0, _stateCapacity = 0, _verifiedLine = 0, _changedEnd = -1;
+
+// The first line printed from a guessed state, -1 if none was. The view is printed again once the states reach it.
+static long _guessedLine = -1;
+
+static void startColors(void);
+static int lexNode(lexer *lx, TEXT *node);
+static int lexWord(lexer *lx, TEXT *node);
+static int findKeyword(const char *word);
+static int startRun(lexer *lx, int highlightClass, int run);
+static int getLineState(TEXT *headNode, long line);
+static int guessLineState(TEXT *headNode, long line);
+static void reserveStates(long count);
+
+/**
+ * Pick the language to highlight from the extension of a file name, files of other types aren't highlighted.
+ */
+void setHighlightLanguage(const char *fileName)
+{
+	const char *extension = fileName != NULL ? strrchr(fileName, '.') : NULL;
+	_language = LANGUAGE_NONE;
+	if (extension != NULL && (strcmp(extension, ".c") == 0 || strcmp(extension, ".h") == 0))
+	{
+		_language = LANGUAGE_C;
+	}
+	else if (extension != NULL && strcmp(extension, ".json") == 0)
+	{
+		_language = LANGUAGE_JSON;
+	}
+	else if (extension != NULL && strcmp(extension, ".log") == 0)
+	{
+		_language = LANGUAGE_LOG;
+	}
+
+	resetHighlight();
+	if (_language != LANGUAGE_NONE)
+	{
+		startColors();
+	}
+}
+
+/**
+ * Set up a color pair for each highlight class, the text is made bold instead on terminals without colors.
+ */
+static void startColors(void)
+{
+	static const short colors[HIGHLIGHT_CLASSES] =
+	{
+		COLOR_WHITE, COLOR_YELLOW, COLOR_GREEN, COLOR_MAGENTA, COLOR_CYAN, COLOR_MAGENTA, COLOR_RED, COLOR_YELLOW, COLOR_GREEN, COLOR_BLUE
+	};
+
+	if (_isColorReady)
+	{
+		return;
+	}
+
+	_isColorReady = true;
+	bool hasColors = has_colors() && start_color() == OK;
+	short background = hasColors && use_default_colors() == OK ? -1 : COLOR_BLACK;
+	for (int i = HIGHLIGHT_KEYWORD; i < HIGHLIGHT_CLASSES; ++i)
+	{
+		_attributes[i] = hasColors && init_pair(i, colors[i], background) == OK ? COLOR_PAIR(i) : A_BOLD;
+	}
+}
+
+/**
+ * Start highlighting a line, the lexer continues from the state the line starts in.
+ */
+lexer beginHighlight(TEXT *headNode, long line)
+{
+	lexer lx = {getLineState(headNode, line), 0, HIGHLIGHT_NONE, true};
+	return lx;
+}
+
+/**
+ * The attribute a node is printed with, the nodes of a line have to be passed in order starting at its first node.
+ */
+chtype getHighlight(lexer *lx, TEXT *node)
+{
+	if (_language == LANGUAGE_NONE)
+	{
+		return 0;
+	}
+
+	return _attributes[lexNode(lx, node)];
+}
+
+/**
+ * Lex a node and return its highlight class. Words, numbers and escaped characters are lexed as a run of nodes when their first node is reached.
+ */
+static int lexNode(lexer *lx, TEXT *node)
+{
+	// Only a block comment continues on the next line.
+	if (node->ch == '\n')
+	{
+		lx->state = lx->state == LEX_BLOCK_COMMENT ? LEX_BLOCK_COMMENT : LEX_CODE;
+		lx->run = 0;
+		lx->isLineStart = true;
+		return HIGHLIGHT_NONE;
+	}
+
+	if (lx->run > 0)
+	{
+		--lx->run;
+		return lx->runClass;
+	}
+
+	int ch = node->ch, next = nextNode(node) != NULL ? nextNode(node)->ch : '\0';
+	bool isLineStart = lx->isLineStart;
+	lx->isLineStart = isLineStart && (ch == ' ' || ch == '\t');
+
+	switch (lx->state)
+	{
+		case LEX_BLOCK_COMMENT:
+			if (ch == '*' && next == '/')
+			{
+				lx->state = LEX_CODE;
+				return startRun(lx, HIGHLIGHT_COMMENT, 1);
+			}
+			return HIGHLIGHT_COMMENT;
+		case LEX_LINE_COMMENT:
+			return HIGHLIGHT_COMMENT;
+		case LEX_STRING:
+		case LEX_CHAR:
+			if (ch == '\\' && next != '\n' && next != '\0')
+			{
+				return startRun(lx, HIGHLIGHT_STRING, 1);
+			}
+			lx->state = ch == (lx->state == LEX_STRING ? '"' : '\'') ? LEX_CODE : lx->state;
+			return HIGHLIGHT_STRING;
+		default:
+			break;
+	}
+
+	if (_language == LANGUAGE_C && ch == '/' && (next == '/' || next == '*'))
+	{
+		lx->state = next == '/' ? LEX_LINE_COMMENT : LEX_BLOCK_COMMENT;
+		return startRun(lx, HIGHLIGHT_COMMENT, 1);
+	}
+
+	if (lx->state == LEX_PREPROCESSOR)
+	{
+		return HIGHLIGHT_PREPROCESSOR;
+	}
+
+	if (_language == LANGUAGE_C && ch == '#' && isLineStart)
+	{
+		lx->state = LEX_PREPROCESSOR;
+		return HIGHLIGHT_PREPROCESSOR;
+	}
+
+	if (_language != LANGUAGE_LOG && (ch == '"' || (_language == LANGUAGE_C && ch == '\'')))
+	{
+		lx->state = ch == '"' ? LEX_STRING : LEX_CHAR;
+		return HIGHLIGHT_STRING;
+	}
+
+	return getCharClass(ch) == CLASS_WORD ? lexWord(lx, node) : HIGHLIGHT_NONE;
+}
+
+/**
+ * Lex the word starting at a node, a keyword or a number colors the whole word.
+ */
+static int lexWord(lexer *lx, TEXT *node)
+{
+	char word[HIGHLIGHT_WORD_SIZE + 1];
+	int length = 0;
+	for (; node != NULL && getCharClass(node->ch) == CLASS_WORD; node = nextNode(node), ++length)
+	{
+		if (length < HIGHLIGHT_WORD_SIZE)
+		{
+			word[length] = _language == LANGUAGE_LOG ? toupper((unsigned char)node->ch) : node->ch;
+		}
+	}
+	word[length < HIGHLIGHT_WORD_SIZE ? length : HIGHLIGHT_WORD_SIZE] = '\0';
+
+	int highlightClass = length <= HIGHLIGHT_WORD_SIZE ? findKeyword(word) : HIGHLIGHT_NONE;
+	if (highlightClass == HIGHLIGHT_NONE && _language != LANGUAGE_LOG && isdigit((unsigned char)word[0]))
+	{
+		highlightClass = HIGHLIGHT_NUMBER;
+	}
+
+	return startRun(lx, highlightClass, length - 1);
+}
+
+/**
+ * The highlight class of a keyword of the current language, HIGHLIGHT_NONE for any other word.
+ */
+static int findKeyword(const char *word)
+{
+	const keyword *keywords = _language == LANGUAGE_C ? _cKeywords : _language == LANGUAGE_JSON ? _jsonKeywords : _logKeywords;
+	for (; keywords->word != NULL; ++keywords)
+	{
+		if (strcmp(keywords->word, word) == 0)
+		{
+			return keywords->highlightClass;
+		}
+	}
+
+	return HIGHLIGHT_NONE;
+}
+
+/**
+ * Color the next nodes the same as the current one, returns the class.
+ */
+static int startRun(lexer *lx, int highlightClass, int run)
+{
+	lx->run = run;
+	lx->runClass = highlightClass;
+	return highlightClass;
+}
+
+/**
+ * The lexer state at the start of a line. Lines below the known states are lexed from the last known state,
+ * after an edit the lines are lexed until a line ends in the state the next line was already known to start in.
+ */
+static int getLineState(TEXT *headNode, long line)
+{
+	if (_language != LANGUAGE_C || line < 0)
+	{
+		return LEX_CODE;
+	}
+
+	if (_stateCount == 0)
+	{
+		reserveStates(1);
+		_lineStates[0] = LEX_CODE;
+		_stateCount = 1;
+		_verifiedLine = 0;
+		_changedEnd = -1;
+	}
+
+	if (line <= _verifiedLine)
+	{
+		return _lineStates[line];
+	}
+
+	// Lexing every line up to a line far below the known states, like after a jump to the end, is left to the idle work.
+	if (line - _verifiedLine > HIGHLIGHT_GUESS_LINES)
+	{
+		return guessLineState(headNode, line);
+	}
+
+	lexer lx = {_lineStates[_verifiedLine], 0, HIGHLIGHT_NONE, true};
+	for (TEXT *node = findLineStart(headNode, _verifiedLine); _verifiedLine < line; node = nextNode(node))
+	{
+		for (; node != NULL && node->ch != '\n'; node = nextNode(node))
+		{
+			lexNode(&lx, node);
+		}
+
+		// The line is past the end of the text.
+		if (node == NULL)
+		{
+			return LEX_CODE;
+		}
+		lexNode(&lx, node);
+
+		// The rest of the old states are right again once a line past the edit ends in the state it used to.
+		long next = _verifiedLine + 1;
+		if (next < _stateCount && _verifiedLine >= _changedEnd && _lineStates[next] == lx.state)
+		{
+			_verifiedLine = _stateCount - 1;
+			return getLineState(headNode, line);
+		}
+
+		reserveStates(next + 1);
+		_lineStates[next] = lx.state;
+		_stateCount = next < _stateCount ? _stateCount : next + 1;
+		_verifiedLine = next;
+	}
+
+	return _lineStates[line];
+}
+
+/**
+ * Guess the state a line starts in by lexing the few lines above it as code, a block comment starting further up is missed.
+ * The guess isn't kept, the line is remembered so the view is printed again once its real state is known.
+ */
+static int guessLineState(TEXT *headNode, long line)
+{
+	_guessedLine = _guessedLine == -1 || line < _guessedLine ? line : _guessedLine;
+
+	long first = line - HIGHLIGHT_CONTEXT_LINES;
+	lexer lx = {LEX_CODE, 0, HIGHLIGHT_NONE, true};
+	TEXT *node = findLineStart(headNode, first);
+	for (long lines = 0; node != NULL && lines < HIGHLIGHT_CONTEXT_LINES; node = nextNode(node))
+	{
+		lexNode(&lx, node);
+		lines += node->ch == '\n' ? 1 : 0;
+	}
+
+	return lx.state;
+}
+
+/**
+ * Check if the states reached the lines that were printed from a guessed state, it's only reported once.
+ */
+bool isGuessVerified(void)
+{
+	if (_guessedLine == -1 || _verifiedLine < _guessedLine)
+	{
+		return false;
+	}
+
+	_guessedLine = -1;
+	return true;
+}
+
+/**
+ * Lex a number of lines after the last known state ahead of time, so the lines are ready when the view reaches them.
+ * Returns false once the states reach the end of the text.
+ */
+bool lexAhead(TEXT *headNode, long lines)
+{
+	if (_language != LANGUAGE_C || headNode == NULL)
+	{
+		return false;
+	}
+
+	long verifiedLine = _verifiedLine;
+	getLineState(headNode, _verifiedLine + lines);
+	return _verifiedLine != verifiedLine;
+}
+
+/**
+ * Make room for the states of a number of lines.
+ */
+static void reserveStates(long count)
+{
+	if (count <= _stateCapacity)
+	{
+		return;
+	}
+
+	long capacity = _stateCapacity > 0 ? _stateCapacity : 1024;
+	for (; capacity < count; capacity *= 2)
+	{
+	}
+	_lineStates = memAlloc(realloc(_lineStates, capacity), capacity);
+	trackMemory(MEM_STRUCTURE, capacity - _stateCapacity);
+	_stateCapacity = capacity;
+}
+
+/**
+ * Keep the line states after lines first to last were edited, lines were added (or removed) right after the first line.
+ * Only the edited lines are lexed again the next time they're printed, and the lines after them until the states are the same as before.
+ */
+void editHighlight(long first, long last, long lines)
+{
+	_guessedLine = -1;
+	if (_stateCount == 0)
+	{
+		return;
+	}
+
+	// An edit below a pending check can't be told apart from the first edit, the unchecked states are dropped.
+	if (first > _verifiedLine)
+	{
+		_stateCount = _verifiedLine + 1;
+		_changedEnd = -1;
+		return;
+	}
+
+	bool isPending = _verifiedLine < _stateCount - 1;
+	long moved = _stateCount - first - 1;
+	if (lines > 0)
+	{
+		reserveStates(_stateCount + lines);
+		memmove(&_lineStates[first + 1 + lines], &_lineStates[first + 1], moved);
+		memset(&_lineStates[first + 1], LEX_CODE, lines);
+		_stateCount += lines;
+	}
+	else if (lines < 0)
+	{
+		long removed = -lines < moved ? -lines : moved;
+		memmove(&_lineStates[first + 1], &_lineStates[first + 1 + removed], moved - removed);
+		_stateCount -= removed;
+	}
+
+	_changedEnd = isPending && _changedEnd + lines > last ? _changedEnd + lines : last;
+	_verifiedLine = first;
+}
+
+/**
+ * Remove the states of lines removed from the start of the text, the line now first keeps the state it had.
+ */
+void dropHighlightLines(long lines)
+{
+	_guessedLine = -1;
+	if (lines <= 0 || _stateCount == 0)
+	{
+		return;
+	}
+
+	if (lines > _verifiedLine)
+	{
+		resetHighlight();
+		return;
+	}
+
+	memmove(&_lineStates[0], &_lineStates[lines], _stateCount - lines);
+	_stateCount -= lines;
+	_verifiedLine -= lines;
+	_changedEnd -= lines;
+}
+
+/**
+ * Forget every line state, they are lexed again from the start of the text when needed.
+ */
+void resetHighlight(void)
+{
+	trackMemory(MEM_STRUCTURE, -_stateCapacity);
+	free(_lineStates);
+	_lineStates = NULL;
+	_stateCount = _stateCapacity = _verifiedLine = 0;
+	_changedEnd = _guessedLine = -1;
+}
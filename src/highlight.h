@@ -0,0 +1,72 @@
+/*
+	Writen by: Oscar Bergström
+	https://github.com/OSCARJFB
+
+	MIT License
+	Copyright (c) 2023 Oscar Bergström
+*/
+
+#ifndef HIGHLIGHT_H
+#define HIGHLIGHT_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <ncurses.h>
+#include "textData.h"
+#include "allocHandler.h"
+#include "lineIndex.h"
+#include "textMotion.h"
+
+#define HIGHLIGHT_WORD_SIZE 16
+#define HIGHLIGHT_GUESS_LINES 4096
+#define HIGHLIGHT_CONTEXT_LINES 64
+
+enum language
+{
+	LANGUAGE_NONE,
+	LANGUAGE_C,
+	LANGUAGE_JSON,
+	LANGUAGE_LOG
+};
+
+enum lexState
+{
+	LEX_CODE,
+	LEX_BLOCK_COMMENT,
+	LEX_LINE_COMMENT,
+	LEX_STRING,
+	LEX_CHAR,
+	LEX_PREPROCESSOR
+};
+
+enum highlightClass
+{
+	HIGHLIGHT_NONE,
+	HIGHLIGHT_KEYWORD,
+	HIGHLIGHT_STRING,
+	HIGHLIGHT_NUMBER,
+	HIGHLIGHT_COMMENT,
+	HIGHLIGHT_PREPROCESSOR,
+	HIGHLIGHT_ERROR,
+	HIGHLIGHT_WARNING,
+	HIGHLIGHT_INFO,
+	HIGHLIGHT_DEBUG,
+	HIGHLIGHT_CLASSES
+};
+
+typedef struct lexer
+{
+	int state, run, runClass;
+	bool isLineStart;
+} lexer;
+
+void setHighlightLanguage(const char *fileName);
+lexer beginHighlight(TEXT *headNode, long line);
+chtype getHighlight(lexer *lx, TEXT *node);
+void editHighlight(long first, long last, long lines);
+void dropHighlightLines(long lines);
+void resetHighlight(void);
+bool lexAhead(TEXT *headNode, long lines);
+bool isGuessVerified(void);
+
+#endif // HIGHLIGHT_H
@@ -0,0 +1,548 @@
+/*
+	Writen by: Oscar Bergström
+	https://github.com/OSCARJFB
+
+	MIT License
+	Copyright (c) 2023 Oscar Bergström
+*/
+
+#define _POSIX_C_SOURCE 200809L
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/stat.h>
+#include "journal.h"
+#include "compressedFile.h"
+
+#define JOURNAL_MAGIC "OBJ1"
+#define JOURNAL_MAGIC_SIZE 4
+#define JOURNAL_HEADER_SIZE ((long)(JOURNAL_MAGIC_SIZE + 2 * sizeof(int64_t)))
+#define JOURNAL_RECORD_MAX_HEAD 21
+#define JOURNAL_RESTART_CHUNK 65536
+
+static int _journalFd = -1;
+static char *_journalPath = NULL;
+static char *_baseName = NULL;
+static char *_pending = NULL;
+static long _pendingSize = 0, _pendingCapacity = 0;
+static long _generation = 0;
+
+// Memory of records freed by the syncing thread, the thread can't track memory itself so it's accounted by the editor when it next takes the lock.
+static long _releasedBytes = 0;
+static bool _isSyncing = false, _wasReplayed = false;
+static pthread_t _syncThread;
+static pthread_mutex_t _pendingLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t _writeLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t _syncWake = PTHREAD_COND_INITIALIZER;
+
+static char *getJournalPath(const char *fileName);
+static void createHeader(const char *fileName, char *header);
+static bool isHeaderValid(const char *fileName, const char *header);
+static void addRecord(int operation, long offset, const char *text, long size);
+static long putVarint(char *record, long value);
+static long getVarint(const char *data, long size, long *index);
+static void writeRecords(char *records, long size, long generation);
+static void *syncJournal(void *arg);
+static void stopJournal(bool isKept);
+
+/**
+ * The journal is stored next to the file it belongs to, "dir/name" gets the journal "dir/.name.ob-journal".
+ */
+static char *getJournalPath(const char *fileName)
+{
+	const char *base = strrchr(fileName, '/');
+	int dirLength = base == NULL ? 0 : (int)(base - fileName) + 1;
+	base = base == NULL ? fileName : base + 1;
+
+	long size = strlen(fileName) + sizeof(".ob-journal") + 1;
+	char *path = memAlloc(malloc(size), size);
+	sprintf(path, "%.*s.%s.ob-journal", dirLength, fileName, base);
+	return path;
+}
+
+/**
+ * The header holds the size and modification time of the file the journal was started from.
+ * It's used to make sure that the journal is only replayed over that same file.
+ */
+static void createHeader(const char *fileName, char *header)
+{
+	struct stat fileStat;
+	int64_t size = 0, modified = 0;
+
+	if (stat(fileName, &fileStat) == 0)
+	{
+		size = fileStat.st_size;
+		modified = (int64_t)fileStat.st_mtim.tv_sec * 1000000000LL + fileStat.st_mtim.tv_nsec;
+	}
+
+	memcpy(header, JOURNAL_MAGIC, JOURNAL_MAGIC_SIZE);
+	memcpy(header + JOURNAL_MAGIC_SIZE, &size, sizeof(size));
+	memcpy(header + JOURNAL_MAGIC_SIZE + sizeof(size), &modified, sizeof(modified));
+}
+
+/**
+ * Check that a journal header belongs to the current version of the file.
+ */
+static bool isHeaderValid(const char *fileName, const char *header)
+{
+	char current[JOURNAL_HEADER_SIZE];
+	createHeader(fileName, current);
+	return memcmp(current, header, JOURNAL_HEADER_SIZE) == 0;
+}
+
+/**
+ * Store a number using 7 bits per byte, small numbers only need a single byte.
+ * Returns the amount of bytes used.
+ */
+static long putVarint(char *record, long value)
+{
+	long size = 0;
+	do
+	{
+		record[size++] = (char)((value & 0x7f) | (value > 0x7f ? 0x80 : 0));
+		value >>= 7;
+	} while (value > 0);
+
+	return size;
+}
+
+/**
+ * Read a number stored by putVarint, moving the index past it.
+ * Returns -1 if the data ends before the number does.
+ */
+static long getVarint(const char *data, long size, long *index)
+{
+	long value = 0;
+	for (int shift = 0; *index < size && shift < 63; shift += 7)
+	{
+		unsigned char byte = data[(*index)++];
+		value |= (long)(byte & 0x7f) << shift;
+		if ((byte & 0x80) == 0)
+		{
+			return value;
+		}
+	}
+
+	return -1;
+}
+
+/**
+ * Apply the journal of a file (if any) to the buffer holding the content of the file.
+ * Journals of another version of the file are removed. Returns the buffer, which may have been reallocated, and sets the new file size.
+ * A compressed file isn't journaled, it's read as a stream and isn't in a buffer when it's opened.
+ */
+char *replayJournal(const char *fileName, char *buffer, long *fileSize)
+{
+	if (fileName == NULL || getCompression(fileName) != COMPRESSION_NONE)
+	{
+		return buffer;
+	}
+
+	char *path = getJournalPath(fileName);
+	FILE *fp = fopen(path, "rb");
+	if (fp == NULL)
+	{
+		free(path);
+		return buffer;
+	}
+
+	// Read the whole journal.
+	fseek(fp, 0, SEEK_END);
+	long journalSize = ftell(fp), index = JOURNAL_HEADER_SIZE;
+	char *journal = memAlloc(malloc(journalSize + 1), journalSize + 1);
+	rewind(fp);
+	journalSize = (long)fread(journal, 1, journalSize, fp);
+	fclose(fp);
+
+	if (journalSize < JOURNAL_HEADER_SIZE || !isHeaderValid(fileName, journal))
+	{
+		unlink(path);
+		free(journal);
+		free(path);
+		return buffer;
+	}
+
+	long size = *fileSize > 0 ? *fileSize : 0, capacity = size;
+	while (index < journalSize)
+	{
+		int operation = journal[index++];
+		long offset = getVarint(journal, journalSize, &index);
+		long length = getVarint(journal, journalSize, &index);
+
+		// A record that was cut short by a crash ends the replay.
+		if (offset < 0 || length < 0 || offset > size)
+		{
+			break;
+		}
+
+		if (operation == JOURNAL_INSERT && length <= journalSize - index)
+		{
+			if (size + length > capacity)
+			{
+				capacity = (size + length) * 2;
+				buffer = memAlloc(realloc(buffer, capacity), capacity);
+			}
+
+			memmove(buffer + offset + length, buffer + offset, size - offset);
+			memcpy(buffer + offset, journal + index, length);
+			index += length;
+			size += length;
+		}
+		else if (operation == JOURNAL_DELETE && offset + length <= size)
+		{
+			memmove(buffer + offset, buffer + offset + length, size - offset - length);
+			size -= length;
+		}
+		else
+		{
+			break;
+		}
+
+		_wasReplayed = true;
+	}
+
+	if (size != capacity && size > 0)
+	{
+		buffer = memAlloc(realloc(buffer, size), size);
+	}
+	trackMemory(MEM_BUFFERS, size - (*fileSize > 0 ? *fileSize : 0));
+	*fileSize = size;
+
+	free(journal);
+	free(path);
+	return buffer;
+}
+
+/**
+ * Returns true if the loaded file was recovered from a journal.
+ */
+bool wasJournalReplayed(void)
+{
+	return _wasReplayed;
+}
+
+/**
+ * Open the journal of a file for appending, a new journal is started unless a valid one exists.
+ * Records are written to disk by a thread of its own every JOURNAL_SYNC_MS milliseconds.
+ */
+void openJournal(const char *fileName)
+{
+	if (fileName == NULL || _journalFd != -1 || getCompression(fileName) != COMPRESSION_NONE)
+	{
+		return;
+	}
+
+	_journalPath = getJournalPath(fileName);
+	_journalFd = open(_journalPath, O_RDWR | O_CREAT | O_APPEND, 0600);
+	if (_journalFd == -1)
+	{
+		free(_journalPath);
+		_journalPath = NULL;
+		return;
+	}
+
+	long size = strlen(fileName) + 1;
+	_baseName = memAlloc(malloc(size), size);
+	strcpy(_baseName, fileName);
+
+	char header[JOURNAL_HEADER_SIZE];
+	if (read(_journalFd, header, JOURNAL_HEADER_SIZE) != JOURNAL_HEADER_SIZE || !isHeaderValid(fileName, header))
+	{
+		resetJournal();
+	}
+
+	_isSyncing = true;
+	if (pthread_create(&_syncThread, NULL, syncJournal, NULL) != 0)
+	{
+		_isSyncing = false;
+	}
+}
+
+/**
+ * Stop syncing and remove the journal, this is done when the file is closed by the user.
+ */
+void closeJournal(void)
+{
+	stopJournal(false);
+}
+
+/**
+ * Stop syncing and close the journal but keep it on disk, the records still waiting are written to it first.
+ * This is done when an edited file is switched away from, the journal is opened again when the file is switched back to.
+ */
+void detachJournal(void)
+{
+	stopJournal(true);
+}
+
+/**
+ * Remove the journal of a file that isn't open, this is done when its records no longer apply to the file.
+ */
+void discardJournal(const char *fileName)
+{
+	char *path = getJournalPath(fileName);
+	unlink(path);
+	free(path);
+}
+
+/**
+ * Start the journal of a file over, this is done when the file was changed on disk under a document with unsaved edits.
+ * The old records no longer apply, the new journal replaces all of the file by the text of the document.
+ */
+void restartJournal(const char *fileName, TEXT *headNode)
+{
+	discardJournal(fileName);
+	openJournal(fileName);
+	if (_journalFd == -1)
+	{
+		return;
+	}
+
+	struct stat fileStat;
+	journalDelete(0, stat(fileName, &fileStat) == 0 ? (long)fileStat.st_size : 0);
+
+	// The text is recorded in chunks, so the whole document is never copied at once.
+	char chunk[JOURNAL_RESTART_CHUNK];
+	long offset = 0, size = 0;
+	for (TEXT *node = headNode; node != NULL; node = nextNode(node))
+	{
+		chunk[size++] = node->ch;
+		if (size == JOURNAL_RESTART_CHUNK || nextNode(node) == NULL)
+		{
+			journalInsert(offset, chunk, size);
+			offset += size;
+			size = 0;
+		}
+	}
+}
+
+/**
+ * Stop the syncing thread and close the journal, it's removed unless it is kept.
+ */
+static void stopJournal(bool isKept)
+{
+	if (_journalFd == -1)
+	{
+		return;
+	}
+
+	if (_isSyncing)
+	{
+		pthread_mutex_lock(&_pendingLock);
+		_isSyncing = false;
+		pthread_cond_signal(&_syncWake);
+		pthread_mutex_unlock(&_pendingLock);
+		pthread_join(_syncThread, NULL);
+	}
+
+	trackMemory(MEM_BUFFERS, -_pendingCapacity - _releasedBytes);
+	_releasedBytes = 0;
+	if (isKept)
+	{
+		writeRecords(_pending, _pendingSize, _generation);
+	}
+	else
+	{
+		free(_pending);
+	}
+	_pending = NULL;
+	_pendingSize = _pendingCapacity = 0;
+
+	close(_journalFd);
+	_journalFd = -1;
+	if (!isKept)
+	{
+		unlink(_journalPath);
+	}
+	free(_journalPath);
+	_journalPath = NULL;
+	free(_baseName);
+	_baseName = NULL;
+	_wasReplayed = false;
+}
+
+/**
+ * Start the journal over, this is done when the file has been saved.
+ */
+void resetJournal(void)
+{
+	if (_journalFd == -1)
+	{
+		return;
+	}
+
+	// Records taken by the syncing thread before this point belong to an older generation and are thrown away.
+	pthread_mutex_lock(&_pendingLock);
+	trackMemory(MEM_BUFFERS, -_pendingCapacity - _releasedBytes);
+	_releasedBytes = 0;
+	free(_pending);
+	_pending = NULL;
+	_pendingSize = _pendingCapacity = 0;
+	__atomic_add_fetch(&_generation, 1, __ATOMIC_ACQ_REL);
+	pthread_mutex_unlock(&_pendingLock);
+
+	char header[JOURNAL_HEADER_SIZE];
+	createHeader(_baseName, header);
+
+	pthread_mutex_lock(&_writeLock);
+	if (ftruncate(_journalFd, 0) == 0 && write(_journalFd, header, JOURNAL_HEADER_SIZE) == JOURNAL_HEADER_SIZE)
+	{
+		fdatasync(_journalFd);
+	}
+	pthread_mutex_unlock(&_writeLock);
+	_wasReplayed = false;
+}
+
+/**
+ * Update the header to the current version of the file while keeping the records.
+ * This is done when text appended to the file by another program was added to the end of the text.
+ */
+void refreshJournalHeader(void)
+{
+	if (_journalFd == -1)
+	{
+		return;
+	}
+
+	char header[JOURNAL_HEADER_SIZE];
+	createHeader(_baseName, header);
+
+	// The journal is opened for appending, which pwrite doesn't bypass on Linux.
+	pthread_mutex_lock(&_writeLock);
+	int flags = fcntl(_journalFd, F_GETFL);
+	if (fcntl(_journalFd, F_SETFL, flags & ~O_APPEND) == 0)
+	{
+		if (pwrite(_journalFd, header, JOURNAL_HEADER_SIZE, 0) == JOURNAL_HEADER_SIZE)
+		{
+			fdatasync(_journalFd);
+		}
+		fcntl(_journalFd, F_SETFL, flags);
+	}
+	pthread_mutex_unlock(&_writeLock);
+}
+
+/**
+ * Add a record to the records waiting to be written.
+ */
+static void addRecord(int operation, long offset, const char *text, long size)
+{
+	if (_journalFd == -1)
+	{
+		return;
+	}
+
+	pthread_mutex_lock(&_pendingLock);
+	trackMemory(MEM_BUFFERS, -_releasedBytes);
+	_releasedBytes = 0;
+	long needed = _pendingSize + JOURNAL_RECORD_MAX_HEAD + (text != NULL ? size : 0);
+	if (needed > _pendingCapacity)
+	{
+		long capacity = needed > 4096 ? needed * 2 : 4096;
+		_pending = memAlloc(realloc(_pending, capacity), capacity);
+		trackMemory(MEM_BUFFERS, capacity - _pendingCapacity);
+		_pendingCapacity = capacity;
+	}
+
+	_pending[_pendingSize++] = (char)operation;
+	_pendingSize += putVarint(_pending + _pendingSize, offset);
+	_pendingSize += putVarint(_pending + _pendingSize, size);
+	if (text != NULL)
+	{
+		memcpy(_pending + _pendingSize, text, size);
+		_pendingSize += size;
+	}
+	pthread_mutex_unlock(&_pendingLock);
+}
+
+/**
+ * Record text inserted at a character offset in the file.
+ */
+void journalInsert(long offset, const char *text, long size)
+{
+	if (size > 0)
+	{
+		addRecord(JOURNAL_INSERT, offset, text, size);
+	}
+}
+
+/**
+ * Record an amount of characters deleted at a character offset in the file.
+ */
+void journalDelete(long offset, long size)
+{
+	if (size > 0)
+	{
+		addRecord(JOURNAL_DELETE, offset, NULL, size);
+	}
+}
+
+/**
+ * Append records to the journal file and make sure they reach the disk, the records are freed afterwards.
+ * Records from before the latest reset of the journal are not written.
+ */
+static void writeRecords(char *records, long size, long generation)
+{
+	if (records == NULL)
+	{
+		return;
+	}
+
+	pthread_mutex_lock(&_writeLock);
+	if (generation != __atomic_load_n(&_generation, __ATOMIC_ACQUIRE))
+	{
+		size = 0;
+	}
+
+	for (long written = 0; written < size;)
+	{
+		ssize_t bytes = write(_journalFd, records + written, size - written);
+		if (bytes <= 0)
+		{
+			break;
+		}
+		written += bytes;
+	}
+	fdatasync(_journalFd);
+	pthread_mutex_unlock(&_writeLock);
+	free(records);
+}
+
+/**
+ * Takes the records waiting to be written every JOURNAL_SYNC_MS milliseconds and writes them.
+ * Editing only has to append records to memory, the file writes and syncs are done here.
+ */
+static void *syncJournal(void *arg)
+{
+	(void)arg;
+
+	pthread_mutex_lock(&_pendingLock);
+	while (_isSyncing)
+	{
+		struct timespec wakeTime;
+		clock_gettime(CLOCK_REALTIME, &wakeTime);
+		wakeTime.tv_sec += JOURNAL_SYNC_MS / 1000;
+		wakeTime.tv_nsec += (JOURNAL_SYNC_MS % 1000) * 1000000L;
+		if (wakeTime.tv_nsec >= 1000000000L)
+		{
+			++wakeTime.tv_sec;
+			wakeTime.tv_nsec -= 1000000000L;
+		}
+		pthread_cond_timedwait(&_syncWake, &_pendingLock, &wakeTime);
+
+		char *records = _pending;
+		long size = _pendingSize, capacity = _pendingCapacity, generation = _generation;
+		_pending = NULL;
+		_pendingSize = _pendingCapacity = 0;
+
+		pthread_mutex_unlock(&_pendingLock);
+		writeRecords(records, size, generation);
+		pthread_mutex_lock(&_pendingLock);
+		_releasedBytes += capacity;
+	}
+	pthread_mutex_unlock(&_pendingLock);
+
+	return NULL;
+}
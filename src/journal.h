@@ -0,0 +1,36 @@
+/*
+	Writen by: Oscar Bergström
+	https://github.com/OSCARJFB
+
+	MIT License
+	Copyright (c) 2023 Oscar Bergström
+*/
+
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include "allocHandler.h"
+
+#define JOURNAL_SYNC_MS 1000
+
+enum journalOperation
+{
+	JOURNAL_INSERT = 'i',
+	JOURNAL_DELETE = 'd'
+};
+
+char *replayJournal(const char *fileName, char *buffer, long *fileSize);
+bool wasJournalReplayed(void);
+void openJournal(const char *fileName);
+void closeJournal(void);
+void detachJournal(void);
+void discardJournal(const char *fileName);
+void restartJournal(const char *fileName, TEXT *headNode);
+void resetJournal(void);
+void refreshJournalHeader(void);
+void journalInsert(long offset, const char *text, long size);
+void journalDelete(long offset, long size);
+
+#endif // JOURNAL_H
@@ -0,0 +1,197 @@
+/*
+	Writen by: Oscar Bergström
+	https://github.com/OSCARJFB
+
+	MIT License
+	Copyright (c) 2023 Oscar Bergström
+*/
+
+#define _POSIX_C_SOURCE 199309L
+#include <time.h>
+#include "latencyStats.h"
+
+#define SUB_BUCKETS 8
+#define BUCKET_COUNT 320
+#define OVERLAY_WIDTH 42
+
+enum sizeClass
+{
+	SIZE_1KB,
+	SIZE_1MB,
+	SIZE_100MB,
+	SIZE_LARGER,
+	SIZE_CLASS_COUNT
+};
+
+typedef struct histogram
+{
+	long long buckets[BUCKET_COUNT];
+	long long count, max;
+} histogram;
+
+static const char *_stageNames[STAGE_COUNT] = {"edit", "viewport", "margins", "coordinates", "print", "refresh", "total"};
+static const char *_sizeNames[SIZE_CLASS_COUNT] = {"1KB", "1MB", "100MB", "larger"};
+static histogram _histograms[SIZE_CLASS_COUNT][STAGE_COUNT];
+static int _sizeClass = SIZE_1KB;
+
+static int getBucket(long long time);
+static long long getBucketLimit(int bucket);
+static long long getPercentile(const histogram *h, double percentile);
+
+/**
+ * Read the monotonic clock in nanoseconds.
+ */
+long long getTimeNs(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (long long)now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+/**
+ * The histograms are kept apart depending on the size of the file being edited.
+ * This makes it possible to see which stage slows down as files grow.
+ */
+void setLatencySizeClass(long fileSize)
+{
+	if (fileSize <= 1024L)
+	{
+		_sizeClass = SIZE_1KB;
+	}
+	else if (fileSize <= 1024L * 1024L)
+	{
+		_sizeClass = SIZE_1MB;
+	}
+	else if (fileSize <= 100L * 1024L * 1024L)
+	{
+		_sizeClass = SIZE_100MB;
+	}
+	else
+	{
+		_sizeClass = SIZE_LARGER;
+	}
+}
+
+/**
+ * Map a time to its histogram bucket.
+ * Each power of two is split into a number of sub buckets, keeping the error of a percentile within 12.5%.
+ */
+static int getBucket(long long time)
+{
+	if (time < SUB_BUCKETS)
+	{
+		return time < 0 ? 0 : (int)time;
+	}
+
+	int exponent = 63 - __builtin_clzll((unsigned long long)time);
+	int bucket = (exponent - 2) * SUB_BUCKETS + (int)((time >> (exponent - 3)) & (SUB_BUCKETS - 1));
+	return bucket < BUCKET_COUNT ? bucket : BUCKET_COUNT - 1;
+}
+
+/**
+ * Get the highest time that is counted in a bucket.
+ */
+static long long getBucketLimit(int bucket)
+{
+	if (bucket < SUB_BUCKETS)
+	{
+		return bucket;
+	}
+
+	int exponent = bucket / SUB_BUCKETS + 2;
+	long long subBucket = bucket % SUB_BUCKETS;
+	return ((SUB_BUCKETS + subBucket + 1) << (exponent - 3)) - 1;
+}
+
+/**
+ * Find the time below which the given share (0 to 1) of all recorded times are found.
+ */
+static long long getPercentile(const histogram *h, double percentile)
+{
+	long long target = (long long)(percentile * h->count + 0.5), seen = 0;
+	target = target < 1 ? 1 : target;
+
+	for (int i = 0; i < BUCKET_COUNT; ++i)
+	{
+		seen += h->buckets[i];
+		if (seen >= target)
+		{
+			long long limit = getBucketLimit(i);
+			return limit < h->max ? limit : h->max;
+		}
+	}
+
+	return h->max;
+}
+
+/**
+ * Add the time passed since startTime to the histogram of a stage.
+ * Returns the current time, which may be used as the start time of the following stage.
+ */
+long long recordLatency(int stage, long long startTime)
+{
+	long long now = getTimeNs(), time = now - startTime;
+	histogram *h = &_histograms[_sizeClass][stage];
+
+	++h->buckets[getBucket(time)];
+	++h->count;
+	h->max = time > h->max ? time : h->max;
+	return now;
+}
+
+/**
+ * Print the latency of each stage in the top right corner of the terminal.
+ * Times are printed in microseconds.
+ */
+void printLatencyStats(void)
+{
+	int x = getmaxx(stdscr) - OVERLAY_WIDTH;
+	x = x < 0 ? 0 : x;
+
+	attron(A_REVERSE);
+	mvprintw(0, x, "%-12s%10s%10s%10s", "stage", "p50 us", "p99 us", "max us");
+	for (int i = 0; i < STAGE_COUNT; ++i)
+	{
+		const histogram *h = &_histograms[_sizeClass][i];
+		mvprintw(i + 1, x, "%-12s%10.1f%10.1f%10.1f", _stageNames[i],
+				 getPercentile(h, 0.5) / 1000.0, getPercentile(h, 0.99) / 1000.0, h->max / 1000.0);
+	}
+	attroff(A_REVERSE);
+}
+
+/**
+ * Write the recorded latencies to a file as comma separated values.
+ * Nothing is written if path is NULL.
+ */
+void dumpLatencyStats(const char *path)
+{
+	if (path == NULL)
+	{
+		return;
+	}
+
+	FILE *fp = fopen(path, "w");
+	if (fp == NULL)
+	{
+		return;
+	}
+
+	fprintf(fp, "size,stage,count,p50_us,p99_us,max_us\n");
+	for (int size = 0; size < SIZE_CLASS_COUNT; ++size)
+	{
+		for (int i = 0; i < STAGE_COUNT; ++i)
+		{
+			const histogram *h = &_histograms[size][i];
+			if (h->count == 0)
+			{
+				continue;
+			}
+
+			fprintf(fp, "%s,%s,%lld,%.1f,%.1f,%.1f\n", _sizeNames[size], _stageNames[i], h->count,
+					getPercentile(h, 0.5) / 1000.0, getPercentile(h, 0.99) / 1000.0, h->max / 1000.0);
+		}
+	}
+
+	fclose(fp);
+	fp = NULL;
+}
@@ -0,0 +1,34 @@
+/*
+	Writen by: Oscar Bergström
+	https://github.com/OSCARJFB
+
+	MIT License
+	Copyright (c) 2023 Oscar Bergström
+*/
+
+#ifndef LATENCYSTATS_H
+#define LATENCYSTATS_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <ncurses.h>
+
+enum latencyStage
+{
+	STAGE_EDIT,
+	STAGE_VIEWPORT,
+	STAGE_MARGINS,
+	STAGE_COORDINATES,
+	STAGE_PRINT,
+	STAGE_REFRESH,
+	STAGE_TOTAL,
+	STAGE_COUNT
+};
+
+long long getTimeNs(void);
+void setLatencySizeClass(long fileSize);
+long long recordLatency(int stage, long long startTime);
+void printLatencyStats(void);
+void dumpLatencyStats(const char *path);
+
+#endif // LATENCYSTATS_H
@@ -0,0 +1,683 @@
+/*
+	Writen by: Oscar Bergström
+	https://github.com/OSCARJFB
+
+	MIT License
+	Copyright (c) 2023 Oscar Bergström
+*/
+
+#include <string.h>
+#include "lineIndex.h"
+
+static TEXT **_checkpoints = NULL;
+static TEXT *_indexHead = NULL;
+static long _checkpointCount = 0, _checkpointCapacity = 0, _lineCount = 0;
+
+// The offset and line of each checkpoint in the text, and the checkpoints hashed by address so a node can be recognized as one.
+static long *_checkpointOffsets = NULL, *_checkpointLines = NULL, *_checkpointSet = NULL;
+static long _setSize = 0;
+
+// The last line looked up, lookups are often close to the previous one.
+static TEXT *_lastNewLine = NULL;
+static long _lastLine = -1;
+static bool _isIndexValid = false;
+static foldRange *_folds = NULL;
+static long _foldCount = 0, _foldCapacity = 0;
+
+static void buildLineIndex(TEXT *headNode);
+static void growCheckpoints(void);
+static void buildCheckpointSet(void);
+static long hashCheckpoint(TEXT *node);
+static long findCheckpoint(TEXT *node);
+static long findOffsetCheckpoint(long offset);
+static long findLineCheckpoint(long line);
+static void splitCheckpoints(TEXT *headNode, long next);
+static long findFold(long line);
+
+/**
+ * Mark the index as outdated, this has to be done whenever newline nodes are added to or freed from the list without addIndexedLine or removeIndexedLine.
+ * The index is built again the next time a line is looked up.
+ */
+void invalidateLineIndex(void)
+{
+	_isIndexValid = false;
+	_lastLine = -1;
+}
+
+/**
+ * Free the index.
+ */
+void clearLineIndex(void)
+{
+	trackMemory(MEM_STRUCTURE, -_checkpointCapacity * (long)(sizeof(TEXT *) + 2 * sizeof(long)) - _setSize * (long)sizeof(long));
+	free(_checkpoints);
+	free(_checkpointOffsets);
+	free(_checkpointLines);
+	free(_checkpointSet);
+	_checkpoints = NULL;
+	_checkpointOffsets = _checkpointLines = _checkpointSet = NULL;
+	_checkpointCount = _checkpointCapacity = _lineCount = _setSize = 0;
+	_isIndexValid = false;
+	_lastLine = -1;
+	clearFolds();
+}
+
+/**
+ * Walk the list once and keep every LINE_INDEX_STEP newline, so any line is at most LINE_INDEX_STEP lines from a checkpoint.
+ * Edits move the lines of the checkpoints afterwards, they are kept at most 2 * LINE_INDEX_STEP lines apart.
+ */
+static void buildLineIndex(TEXT *headNode)
+{
+	_checkpointCount = _lineCount = 0;
+	long offset = 0;
+	for (TEXT *node = headNode; node != NULL; node = nextNode(node), ++offset)
+	{
+		if (node->ch != '\n')
+		{
+			continue;
+		}
+
+		if (_lineCount++ % LINE_INDEX_STEP != 0)
+		{
+			continue;
+		}
+
+		growCheckpoints();
+		_checkpointOffsets[_checkpointCount] = offset;
+		_checkpointLines[_checkpointCount] = _lineCount - 1;
+		_checkpoints[_checkpointCount++] = node;
+	}
+
+	buildCheckpointSet();
+	_lastLine = -1;
+	_indexHead = headNode;
+	_isIndexValid = true;
+}
+
+/**
+ * Make room for one more checkpoint.
+ */
+static void growCheckpoints(void)
+{
+	if (_checkpointCount < _checkpointCapacity)
+	{
+		return;
+	}
+
+	long capacity = _checkpointCapacity > 0 ? _checkpointCapacity * 2 : 64;
+	_checkpoints = memAlloc(realloc(_checkpoints, capacity * sizeof(TEXT *)), capacity * sizeof(TEXT *));
+	_checkpointOffsets = memAlloc(realloc(_checkpointOffsets, capacity * sizeof(long)), capacity * sizeof(long));
+	_checkpointLines = memAlloc(realloc(_checkpointLines, capacity * sizeof(long)), capacity * sizeof(long));
+	trackMemory(MEM_STRUCTURE, (capacity - _checkpointCapacity) * (long)(sizeof(TEXT *) + 2 * sizeof(long)));
+	_checkpointCapacity = capacity;
+}
+
+/**
+ * Hash the checkpoints by address, the set is kept at most half full.
+ */
+static void buildCheckpointSet(void)
+{
+	long size = 64;
+	for (; size < _checkpointCount * 2; size *= 2)
+	{
+	}
+
+	if (size != _setSize)
+	{
+		_checkpointSet = memAlloc(realloc(_checkpointSet, size * sizeof(long)), size * sizeof(long));
+		trackMemory(MEM_STRUCTURE, (size - _setSize) * (long)sizeof(long));
+		_setSize = size;
+	}
+
+	// Each slot holds the checkpoint plus one, 0 marks an empty slot.
+	memset(_checkpointSet, 0, _setSize * sizeof(long));
+	for (long i = 0; i < _checkpointCount; ++i)
+	{
+		long slot = hashCheckpoint(_checkpoints[i]);
+		for (; _checkpointSet[slot] != 0; slot = (slot + 1) & (_setSize - 1))
+		{
+		}
+		_checkpointSet[slot] = i + 1;
+	}
+}
+
+/**
+ * The slot of a checkpoint in the set. The checkpoints are often evenly spaced in the pool, so the index is mixed and the high bits of the product are used.
+ */
+static long hashCheckpoint(TEXT *node)
+{
+	return (long)((((uint64_t)(node - _nodePool) * 0x9E3779B97F4A7C15ull) >> 32) & (uint64_t)(_setSize - 1));
+}
+
+/**
+ * The checkpoint a newline node is, -1 if it isn't one.
+ */
+static long findCheckpoint(TEXT *node)
+{
+	long slot = hashCheckpoint(node);
+	for (; _checkpointSet[slot] != 0; slot = (slot + 1) & (_setSize - 1))
+	{
+		if (_checkpoints[_checkpointSet[slot] - 1] == node)
+		{
+			return _checkpointSet[slot] - 1;
+		}
+	}
+
+	return -1;
+}
+
+/**
+ * The first checkpoint at or after an offset, the checkpoint count if there is none.
+ */
+static long findOffsetCheckpoint(long offset)
+{
+	long low = 0, high = _checkpointCount;
+	while (low < high)
+	{
+		long middle = low + (high - low) / 2;
+		if (_checkpointOffsets[middle] < offset)
+		{
+			low = middle + 1;
+		}
+		else
+		{
+			high = middle;
+		}
+	}
+
+	return low;
+}
+
+/**
+ * The last checkpoint ending a line at or before a line, -1 if the line is above the first checkpoint.
+ */
+static long findLineCheckpoint(long line)
+{
+	long low = 0, high = _checkpointCount;
+	while (low < high)
+	{
+		long middle = low + (high - low) / 2;
+		if (_checkpointLines[middle] <= line)
+		{
+			low = middle + 1;
+		}
+		else
+		{
+			high = middle;
+		}
+	}
+
+	return low - 1;
+}
+
+/**
+ * The offset of a node in the text. The list is walked back to the closest checkpoint, which is at most LINE_INDEX_STEP lines away.
+ * The index isn't built here since the node may be an edit that is still unrecorded, without an index the walk goes to the head node.
+ */
+long findNodeOffset(TEXT *headNode, TEXT *node)
+{
+	bool isIndexUsed = _isIndexValid && _indexHead == headNode;
+	long offset = 0;
+	for (; node != NULL; node = prevNode(node), ++offset)
+	{
+		long checkpoint = isIndexUsed && node->ch == '\n' ? findCheckpoint(node) : -1;
+		if (checkpoint != -1)
+		{
+			return _checkpointOffsets[checkpoint] + offset;
+		}
+	}
+
+	return offset - 1;
+}
+
+/**
+ * Move the checkpoints at or after an offset by the size of text added (or removed if negative) there.
+ * The newlines added or removed by the edit are counted with addIndexedLine and removeIndexedLine.
+ */
+void shiftLineIndex(long offset, long size)
+{
+	if (!_isIndexValid)
+	{
+		return;
+	}
+
+	for (long i = findOffsetCheckpoint(offset); i < _checkpointCount; ++i)
+	{
+		_checkpointOffsets[i] += size;
+	}
+}
+
+/**
+ * Count a newline added at an offset, the lines of the checkpoints after it move down.
+ * The insert has to be recorded first so the offsets of the checkpoints are moved. A checkpoint is added when the lines around the newline grew too far apart.
+ */
+void addIndexedLine(TEXT *headNode, long offset)
+{
+	if (!_isIndexValid)
+	{
+		return;
+	}
+
+	long next = findOffsetCheckpoint(offset);
+	for (long i = next; i < _checkpointCount; ++i)
+	{
+		++_checkpointLines[i];
+	}
+
+	++_lineCount;
+	_lastLine = -1;
+	splitCheckpoints(headNode, next);
+}
+
+/**
+ * Count a newline as removed before its node is freed, and before the delete is recorded.
+ * A checkpoint moves to the next newline, which is at the same line once the newline is gone, so the checkpoints don't grow further apart.
+ */
+void removeIndexedLine(TEXT *newLine)
+{
+	if (!_isIndexValid)
+	{
+		return;
+	}
+
+	// The node is unlinked but still points to the node that followed it.
+	long checkpoint = findCheckpoint(newLine), distance = 1;
+	TEXT *node = nextNode(newLine);
+	for (; node != NULL && node->ch != '\n'; node = nextNode(node))
+	{
+		++distance;
+	}
+
+	long next = checkpoint + 1;
+	if (checkpoint != -1 && (node == NULL || (next < _checkpointCount && _checkpoints[next] == node)))
+	{
+		memmove(&_checkpoints[checkpoint], &_checkpoints[next], (_checkpointCount - next) * sizeof(TEXT *));
+		memmove(&_checkpointOffsets[checkpoint], &_checkpointOffsets[next], (_checkpointCount - next) * sizeof(long));
+		memmove(&_checkpointLines[checkpoint], &_checkpointLines[next], (_checkpointCount - next) * sizeof(long));
+		--_checkpointCount;
+		next = checkpoint;
+		buildCheckpointSet();
+	}
+	else if (checkpoint != -1)
+	{
+		_checkpoints[checkpoint] = node;
+		_checkpointOffsets[checkpoint] += distance;
+		buildCheckpointSet();
+	}
+	else
+	{
+		for (; node != NULL && (node->ch != '\n' || findCheckpoint(node) == -1); node = nextNode(node))
+		{
+		}
+		next = node != NULL ? findCheckpoint(node) : _checkpointCount;
+	}
+
+	for (long i = next; i < _checkpointCount; ++i)
+	{
+		--_checkpointLines[i];
+	}
+
+	--_lineCount;
+	_lastLine = -1;
+}
+
+/**
+ * Add checkpoints in front of a checkpoint (or the end of the text) until it is at most 2 * LINE_INDEX_STEP lines from the checkpoint before it.
+ */
+static void splitCheckpoints(TEXT *headNode, long next)
+{
+	bool isSplit = false;
+	for (;; ++next)
+	{
+		long prevLine = next > 0 ? _checkpointLines[next - 1] : -1;
+		long nextLine = next < _checkpointCount ? _checkpointLines[next] : _lineCount - 1;
+		if (nextLine - prevLine <= 2 * LINE_INDEX_STEP)
+		{
+			break;
+		}
+
+		// The lines above the first checkpoint are counted from the head node.
+		TEXT *node = next > 0 ? _checkpoints[next - 1] : headNode;
+		long offset = next > 0 ? _checkpointOffsets[next - 1] : 0;
+		long line = next > 0 ? prevLine : (headNode->ch == '\n' ? 0 : -1);
+		while (line < prevLine + LINE_INDEX_STEP)
+		{
+			node = nextNode(node);
+			++offset;
+			line += node->ch == '\n' ? 1 : 0;
+		}
+
+		growCheckpoints();
+		memmove(&_checkpoints[next + 1], &_checkpoints[next], (_checkpointCount - next) * sizeof(TEXT *));
+		memmove(&_checkpointOffsets[next + 1], &_checkpointOffsets[next], (_checkpointCount - next) * sizeof(long));
+		memmove(&_checkpointLines[next + 1], &_checkpointLines[next], (_checkpointCount - next) * sizeof(long));
+		_checkpoints[next] = node;
+		_checkpointOffsets[next] = offset;
+		_checkpointLines[next] = line;
+		++_checkpointCount;
+		isSplit = true;
+	}
+
+	if (isSplit)
+	{
+		buildCheckpointSet();
+	}
+}
+
+/**
+ * Keep the index for a list whose head node was replaced by an edit at the start of the text.
+ */
+void setLineIndexHead(TEXT *headNode)
+{
+	_indexHead = _isIndexValid ? headNode : _indexHead;
+}
+
+/**
+ * Find the newline ending a line (counted from 0), NULL if the line doesn't end with a newline.
+ */
+TEXT *findNewLine(TEXT *headNode, long line)
+{
+	if (!_isIndexValid || _indexHead != headNode)
+	{
+		buildLineIndex(headNode);
+	}
+
+	if (line < 0 || line >= _lineCount)
+	{
+		return NULL;
+	}
+
+	// The lines above the first checkpoint are walked from the head node.
+	// The last line looked up is used instead of the checkpoint when it's between the checkpoint and the line.
+	long checkpoint = findLineCheckpoint(line);
+	TEXT *node = checkpoint != -1 ? _checkpoints[checkpoint] : headNode;
+	long from = checkpoint != -1 ? _checkpointLines[checkpoint] : (headNode->ch == '\n' ? 0 : -1);
+	if (_lastLine >= 0 && _lastLine >= from && _lastLine <= line)
+	{
+		from = _lastLine;
+		node = _lastNewLine;
+	}
+
+	for (long skip = line - from; skip > 0; node = nextNode(node))
+	{
+		skip -= nextNode(node)->ch == '\n' ? 1 : 0;
+	}
+
+	_lastLine = line;
+	_lastNewLine = node;
+	return node;
+}
+
+/**
+ * Find the first node of a line (counted from 0), NULL if the line is empty and last or past the end of the text.
+ */
+TEXT *findLineStart(TEXT *headNode, long line)
+{
+	if (line <= 0)
+	{
+		return headNode;
+	}
+
+	TEXT *newLine = findNewLine(headNode, line - 1);
+	return newLine != NULL ? nextNode(newLine) : NULL;
+}
+
+/**
+ * The amount of newlines in the list.
+ */
+long getLineCount(TEXT *headNode)
+{
+	if (!_isIndexValid || _indexHead != headNode)
+	{
+		buildLineIndex(headNode);
+	}
+
+	return _lineCount;
+}
+
+/**
+ * Find the first fold starting at or after a line, the folds are sorted by their first line and never overlap.
+ */
+static long findFold(long line)
+{
+	long low = 0, high = _foldCount;
+	while (low < high)
+	{
+		long middle = low + (high - low) / 2;
+		if (_folds[middle].first < line)
+		{
+			low = middle + 1;
+		}
+		else
+		{
+			high = middle;
+		}
+	}
+
+	return low;
+}
+
+/**
+ * Fold the lines after a line up to the last line, the first line stays in view and holds the fold.
+ * Folds inside the new fold, and an opened fold around it, are replaced by it. Returns false if the fold would only partly cover another fold.
+ */
+bool addFold(long first, long last)
+{
+	long i = findFold(first);
+	if (i > 0 && _folds[i - 1].last >= first && _folds[i - 1].isOpen && _folds[i - 1].last >= last)
+	{
+		removeFold(first);
+		i = findFold(first);
+	}
+
+	if (last <= first || (i > 0 && _folds[i - 1].last >= first))
+	{
+		return false;
+	}
+
+	long end = i;
+	for (; end < _foldCount && _folds[end].first <= last; ++end)
+	{
+		if (_folds[end].last > last)
+		{
+			return false;
+		}
+	}
+
+	if (_foldCount - (end - i) + 1 > _foldCapacity)
+	{
+		long capacity = _foldCapacity > 0 ? _foldCapacity * 2 : 16;
+		_folds = memAlloc(realloc(_folds, capacity * sizeof(foldRange)), capacity * sizeof(foldRange));
+		trackMemory(MEM_STRUCTURE, (capacity - _foldCapacity) * (long)sizeof(foldRange));
+		_foldCapacity = capacity;
+	}
+
+	memmove(&_folds[i + 1], &_folds[end], (_foldCount - end) * sizeof(foldRange));
+	_foldCount += 1 - (end - i);
+	_folds[i].first = first;
+	_folds[i].last = last;
+	_folds[i].isOpen = false;
+	return true;
+}
+
+/**
+ * Remove the fold holding a line, either as its first line or as a folded line.
+ */
+void removeFold(long line)
+{
+	long i = findFold(line + 1);
+	if (i == 0 || _folds[i - 1].last < line)
+	{
+		return;
+	}
+
+	memmove(&_folds[i - 1], &_folds[i], (_foldCount - i) * sizeof(foldRange));
+	--_foldCount;
+}
+
+/**
+ * Open or close the fold starting at a line, an opened fold is kept so it can be closed again without looking at its lines.
+ * Returns false if no fold starts at the line.
+ */
+bool flipFold(long line)
+{
+	long i = findFold(line);
+	if (i == _foldCount || _folds[i].first != line)
+	{
+		return false;
+	}
+
+	_folds[i].isOpen = !_folds[i].isOpen;
+	return true;
+}
+
+/**
+ * Move the folds starting at or after a line by a number of lines, when lines are added or removed at the line.
+ * Removed lines join the line into the line above it, a closed fold hiding that line or a fold ending at it is removed.
+ * An opened fold holding the line grows or shrinks instead. Folds moved above the first line of the list are removed.
+ */
+void shiftFolds(long line, long lines)
+{
+	long i = findFold(line);
+	if (lines < 0 && i > 0 && _folds[i - 1].last >= line - 1 && (!_folds[i - 1].isOpen || _folds[i - 1].last == line - 1))
+	{
+		removeFold(line - 1);
+		--i;
+	}
+
+	if (i > 0 && _folds[i - 1].last >= line)
+	{
+		_folds[i - 1].last += lines;
+		if (_folds[i - 1].last <= _folds[i - 1].first)
+		{
+			removeFold(_folds[i - 1].first);
+			--i;
+		}
+	}
+
+	for (; i < _foldCount; ++i)
+	{
+		_folds[i].first += lines;
+		_folds[i].last += lines;
+	}
+
+	// Only the first folds can end up above the list.
+	long removed = 0;
+	for (; removed < _foldCount && _folds[removed].first < 0; ++removed)
+	{
+	}
+
+	if (removed > 0)
+	{
+		memmove(&_folds[0], &_folds[removed], (_foldCount - removed) * sizeof(foldRange));
+		_foldCount -= removed;
+	}
+}
+
+/**
+ * Remove every fold, they can't be kept when a different text is loaded.
+ */
+void clearFolds(void)
+{
+	trackMemory(MEM_STRUCTURE, -_foldCapacity * (long)sizeof(foldRange));
+	free(_folds);
+	_folds = NULL;
+	_foldCount = _foldCapacity = 0;
+}
+
+/**
+ * Check if any lines are folded, or were folded and opened again.
+ */
+bool hasFolds(void)
+{
+	return _foldCount > 0;
+}
+
+/**
+ * Check if a fold starts at a line, opened or not.
+ */
+bool isFoldStart(long line)
+{
+	long i = findFold(line);
+	return i < _foldCount && _folds[i].first == line;
+}
+
+/**
+ * The last folded line of the closed fold held by a line, -1 if no closed fold starts at the line.
+ */
+long getFoldEnd(long line)
+{
+	long i = findFold(line);
+	return i < _foldCount && _folds[i].first == line && !_folds[i].isOpen ? _folds[i].last : -1;
+}
+
+/**
+ * The line holding the closed fold a folded line is hidden in, -1 if the line isn't hidden.
+ */
+long getFoldStart(long line)
+{
+	long i = findFold(line);
+	return i > 0 && _folds[i - 1].last >= line && !_folds[i - 1].isOpen ? _folds[i - 1].first : -1;
+}
+
+/**
+ * The line shown after a line, the lines folded under it are skipped.
+ */
+long getNextVisibleLine(long line)
+{
+	long end = getFoldEnd(line);
+	return (end != -1 ? end : line) + 1;
+}
+
+/**
+ * The line shown before a line, a folded line is replaced by the line holding its fold.
+ */
+long getPrevVisibleLine(long line)
+{
+	long start = getFoldStart(line - 1);
+	return start != -1 ? start : line - 1;
+}
+
+/**
+ * The line shown at a row of the view when the view starts at a line.
+ */
+long getLineAtRow(long viewStart, int row)
+{
+	if (_foldCount == 0)
+	{
+		return viewStart + row;
+	}
+
+	long line = viewStart;
+	for (int i = 0; i < row; ++i)
+	{
+		line = getNextVisibleLine(line);
+	}
+
+	return line;
+}
+
+/**
+ * The row of the view a line is shown at when the view starts at a line, maxRow if it's shown further down.
+ * A line above the view gives -1.
+ */
+int getRowOfLine(long viewStart, long line, int maxRow)
+{
+	if (line < viewStart)
+	{
+		return -1;
+	}
+
+	if (_foldCount == 0)
+	{
+		return line - viewStart < maxRow ? line - viewStart : maxRow;
+	}
+
+	int row = 0;
+	for (long shown = viewStart; shown < line && row < maxRow; shown = getNextVisibleLine(shown))
+	{
+		++row;
+	}
+
+	return row;
+}
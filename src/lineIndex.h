@@ -0,0 +1,50 @@
+/*
+	Writen by: Oscar Bergström
+	https://github.com/OSCARJFB
+
+	MIT License
+	Copyright (c) 2023 Oscar Bergström
+*/
+
+#ifndef LINEINDEX_H
+#define LINEINDEX_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "textData.h"
+#include "allocHandler.h"
+
+#define LINE_INDEX_STEP 256
+
+typedef struct foldRange
+{
+	long first, last;
+	bool isOpen;
+} foldRange;
+
+void invalidateLineIndex(void);
+void clearLineIndex(void);
+TEXT *findNewLine(TEXT *headNode, long line);
+TEXT *findLineStart(TEXT *headNode, long line);
+long getLineCount(TEXT *headNode);
+long findNodeOffset(TEXT *headNode, TEXT *node);
+void shiftLineIndex(long offset, long size);
+void addIndexedLine(TEXT *headNode, long offset);
+void removeIndexedLine(TEXT *newLine);
+void setLineIndexHead(TEXT *headNode);
+bool addFold(long first, long last);
+void removeFold(long line);
+bool flipFold(long line);
+void shiftFolds(long line, long lines);
+void clearFolds(void);
+bool hasFolds(void);
+bool isFoldStart(long line);
+long getFoldEnd(long line);
+long getFoldStart(long line);
+long getNextVisibleLine(long line);
+long getPrevVisibleLine(long line);
+long getLineAtRow(long viewStart, int row);
+int getRowOfLine(long viewStart, long line, int maxRow);
+
+#endif // LINEINDEX_H
@@ -0,0 +1,353 @@
+/*
+	Writen by: Oscar Bergström
+	https://github.com/OSCARJFB
+
+	MIT License
+	Copyright (c) 2023 Oscar Bergström
+*/
+
+#define _POSIX_C_SOURCE 200809L
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "lineOperation.h"
+
+// A part of the lines sorted by one thread, the threads split their part until the depth runs out.
+typedef struct sortTask
+{
+	lineSpan *spans, *buffer;
+	long count;
+	int depth;
+} sortTask;
+
+// A part of the lines matched against the pattern by one thread.
+typedef struct filterTask
+{
+	lineSpan *spans;
+	bool *isKept;
+	long count;
+	const char *pattern;
+	long patternLength;
+	bool isKeep;
+} filterTask;
+
+static long splitLines(const char *text, long size, lineSpan **spans);
+static int getWorkerCount(void);
+static int compareSpans(const void *first, const void *second);
+static void *sortSpans(void *arg);
+static void mergeSpans(lineSpan *spans, lineSpan *buffer, long half, long count);
+static long uniqueSpans(lineSpan *spans, long count);
+static long hashSpan(lineSpan span);
+static void reverseSpans(lineSpan *spans, long count);
+static long filterSpans(lineSpan *spans, long count, const char *pattern, bool isKeep);
+static void *matchSpans(void *arg);
+static bool hasPattern(lineSpan span, const char *pattern, long patternLength);
+
+/**
+ * Sort, remove duplicates from, reverse or filter the lines of a text. The lines are separated by newlines, the text doesn't end with one.
+ * The pattern is only used by LINES_KEEP and LINES_DROP. Returns the new text, which is counted as MEM_BUFFERS memory and never longer than the old one.
+ */
+char *applyLineOperation(int operation, const char *text, long size, const char *pattern, long *newSize)
+{
+	lineSpan *spans = NULL;
+	long lineCount = splitLines(text, size, &spans), count = lineCount;
+
+	switch (operation)
+	{
+		case LINES_SORT:
+		{
+			lineSpan *buffer = memAlloc(malloc(count * sizeof(lineSpan)), count * sizeof(lineSpan));
+			trackMemory(MEM_BUFFERS, count * (long)sizeof(lineSpan));
+
+			// Each level of splitting doubles the threads sorting.
+			int depth = 0;
+			for (int workers = getWorkerCount(); workers > 1; workers /= 2, ++depth)
+			{
+			}
+			sortTask task = {spans, buffer, count, depth};
+			sortSpans(&task);
+
+			free(buffer);
+			trackMemory(MEM_BUFFERS, -count * (long)sizeof(lineSpan));
+			break;
+		}
+		case LINES_UNIQUE:
+			count = uniqueSpans(spans, count);
+			break;
+		case LINES_REVERSE:
+			reverseSpans(spans, count);
+			break;
+		case LINES_KEEP:
+		case LINES_DROP:
+			count = filterSpans(spans, count, pattern, operation == LINES_KEEP);
+			break;
+	}
+
+	// Join the lines again in their new order.
+	char *newText = memAlloc(malloc(size + 1), size + 1);
+	trackMemory(MEM_BUFFERS, size + 1);
+	*newSize = 0;
+	for (long i = 0; i < count; ++i)
+	{
+		if (i > 0)
+		{
+			newText[(*newSize)++] = '\n';
+		}
+		memcpy(newText + *newSize, spans[i].text, spans[i].length);
+		*newSize += spans[i].length;
+	}
+	newText[*newSize] = '\0';
+
+	free(spans);
+	trackMemory(MEM_BUFFERS, -lineCount * (long)sizeof(lineSpan));
+	return newText;
+}
+
+/**
+ * Find the lines of a text in one pass, the spans are counted as MEM_BUFFERS memory. Returns the amount of lines.
+ */
+static long splitLines(const char *text, long size, lineSpan **spans)
+{
+	long count = 1;
+	for (const char *newLine = text; (newLine = memchr(newLine, '\n', text + size - newLine)) != NULL; ++newLine)
+	{
+		++count;
+	}
+
+	*spans = memAlloc(malloc(count * sizeof(lineSpan)), count * sizeof(lineSpan));
+	trackMemory(MEM_BUFFERS, count * (long)sizeof(lineSpan));
+
+	const char *lineStart = text;
+	for (long i = 0; i < count; ++i)
+	{
+		const char *lineEnd = memchr(lineStart, '\n', text + size - lineStart);
+		lineEnd = lineEnd != NULL ? lineEnd : text + size;
+		(*spans)[i].text = lineStart;
+		(*spans)[i].length = lineEnd - lineStart;
+		lineStart = lineEnd + 1;
+	}
+
+	return count;
+}
+
+/**
+ * The amount of threads to split the work between.
+ */
+static int getWorkerCount(void)
+{
+	long processors = sysconf(_SC_NPROCESSORS_ONLN);
+	return processors < 1 ? 1 : processors > LINE_MAX_WORKERS ? LINE_MAX_WORKERS : processors;
+}
+
+/**
+ * Order two lines by their bytes, a line sorts before the longer lines it starts.
+ */
+static int compareSpans(const void *first, const void *second)
+{
+	const lineSpan *a = first, *b = second;
+	int order = memcmp(a->text, b->text, a->length < b->length ? a->length : b->length);
+	return order != 0 ? order : (a->length > b->length) - (a->length < b->length);
+}
+
+/**
+ * Merge sort the lines of a task. While the depth allows it the first half is sorted by a new thread and the second half by this one,
+ * the smallest parts are sorted with qsort. A thread that can't be started is replaced by sorting the half here.
+ */
+static void *sortSpans(void *arg)
+{
+	sortTask *task = arg;
+	if (task->depth == 0 || task->count < LINE_SORT_SPLIT)
+	{
+		qsort(task->spans, task->count, sizeof(lineSpan), compareSpans);
+		return NULL;
+	}
+
+	long half = task->count / 2;
+	sortTask first = {task->spans, task->buffer, half, task->depth - 1};
+	sortTask second = {task->spans + half, task->buffer + half, task->count - half, task->depth - 1};
+
+	pthread_t thread;
+	bool isThreaded = pthread_create(&thread, NULL, sortSpans, &first) == 0;
+	if (!isThreaded)
+	{
+		sortSpans(&first);
+	}
+	sortSpans(&second);
+	if (isThreaded)
+	{
+		pthread_join(thread, NULL);
+	}
+
+	mergeSpans(task->spans, task->buffer, half, task->count);
+	return NULL;
+}
+
+/**
+ * Merge the two sorted halves of the lines through the buffer.
+ */
+static void mergeSpans(lineSpan *spans, lineSpan *buffer, long half, long count)
+{
+	long i = 0, j = half, k = 0;
+	while (i < half && j < count)
+	{
+		buffer[k++] = compareSpans(&spans[j], &spans[i]) < 0 ? spans[j++] : spans[i++];
+	}
+
+	memcpy(buffer + k, spans + i, (half - i) * sizeof(lineSpan));
+	k += half - i;
+	memcpy(buffer + k, spans + j, (count - j) * sizeof(lineSpan));
+	memcpy(spans, buffer, count * sizeof(lineSpan));
+}
+
+/**
+ * Remove every line that is the same as a line before it, the lines don't have to be sorted.
+ * The lines kept are hashed into a set that is kept at most half full. Returns the amount of lines left.
+ */
+static long uniqueSpans(lineSpan *spans, long count)
+{
+	long setSize = 32;
+	for (; setSize < count * 2; setSize *= 2)
+	{
+	}
+
+	// Each slot holds the index of a kept line plus one, 0 marks an empty slot.
+	long *lineSet = memAlloc(calloc(setSize, sizeof(long)), setSize * sizeof(long));
+	trackMemory(MEM_BUFFERS, setSize * (long)sizeof(long));
+
+	long kept = 0;
+	for (long i = 0; i < count; ++i)
+	{
+		long slot = hashSpan(spans[i]) & (setSize - 1);
+		for (; lineSet[slot] != 0 && compareSpans(&spans[lineSet[slot] - 1], &spans[i]) != 0; slot = (slot + 1) & (setSize - 1))
+		{
+		}
+
+		if (lineSet[slot] == 0)
+		{
+			spans[kept] = spans[i];
+			lineSet[slot] = ++kept;
+		}
+	}
+
+	free(lineSet);
+	trackMemory(MEM_BUFFERS, -setSize * (long)sizeof(long));
+	return kept;
+}
+
+/**
+ * Hash the bytes of a line (FNV-1a).
+ */
+static long hashSpan(lineSpan span)
+{
+	unsigned long hash = 14695981039346656037UL;
+	for (long i = 0; i < span.length; ++i)
+	{
+		hash = (hash ^ (unsigned char)span.text[i]) * 1099511628211UL;
+	}
+
+	return (long)(hash >> 1);
+}
+
+/**
+ * Reverse the order of the lines.
+ */
+static void reverseSpans(lineSpan *spans, long count)
+{
+	for (long i = 0, j = count - 1; i < j; ++i, --j)
+	{
+		lineSpan temp = spans[i];
+		spans[i] = spans[j];
+		spans[j] = temp;
+	}
+}
+
+/**
+ * Keep or drop the lines holding a pattern. The lines are split in equal parts matched by their own thread.
+ * Returns the amount of lines left.
+ */
+static long filterSpans(lineSpan *spans, long count, const char *pattern, bool isKeep)
+{
+	bool *isKept = memAlloc(malloc(count * sizeof(bool)), count * sizeof(bool));
+	trackMemory(MEM_BUFFERS, count * (long)sizeof(bool));
+
+	int workers = getWorkerCount();
+	workers = count < LINE_SORT_SPLIT ? 1 : workers;
+	filterTask tasks[LINE_MAX_WORKERS];
+	pthread_t threads[LINE_MAX_WORKERS];
+	bool isThreaded[LINE_MAX_WORKERS];
+	long part = count / workers;
+	for (int i = 0; i < workers; ++i)
+	{
+		long first = i * part, last = i == workers - 1 ? count : first + part;
+		filterTask task = {spans + first, isKept + first, last - first, pattern, (long)strlen(pattern), isKeep};
+		tasks[i] = task;
+		isThreaded[i] = i > 0 && pthread_create(&threads[i], NULL, matchSpans, &tasks[i]) == 0;
+	}
+
+	// The first part, and any part no thread could be started for, is matched here.
+	for (int i = 0; i < workers; ++i)
+	{
+		if (!isThreaded[i])
+		{
+			matchSpans(&tasks[i]);
+		}
+	}
+
+	for (int i = 1; i < workers; ++i)
+	{
+		if (isThreaded[i])
+		{
+			pthread_join(threads[i], NULL);
+		}
+	}
+
+	long kept = 0;
+	for (long i = 0; i < count; ++i)
+	{
+		if (isKept[i])
+		{
+			spans[kept++] = spans[i];
+		}
+	}
+
+	free(isKept);
+	trackMemory(MEM_BUFFERS, -count * (long)sizeof(bool));
+	return kept;
+}
+
+/**
+ * Mark which lines of a filter task are kept.
+ */
+static void *matchSpans(void *arg)
+{
+	filterTask *task = arg;
+	for (long i = 0; i < task->count; ++i)
+	{
+		task->isKept[i] = hasPattern(task->spans[i], task->pattern, task->patternLength) == task->isKeep;
+	}
+
+	return NULL;
+}
+
+/**
+ * Check if a line holds a pattern, the first character of the pattern is found with memchr before the rest is compared.
+ */
+static bool hasPattern(lineSpan span, const char *pattern, long patternLength)
+{
+	const char *end = span.text + span.length;
+	for (const char *match = span.text; end - match >= patternLength; ++match)
+	{
+		match = memchr(match, pattern[0], end - match);
+		if (match == NULL || end - match < patternLength)
+		{
+			return false;
+		}
+
+		if (memcmp(match, pattern, patternLength) == 0)
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
@@ -0,0 +1,37 @@
+/*
+	Writen by: Oscar Bergström
+	https://github.com/OSCARJFB
+
+	MIT License
+	Copyright (c) 2023 Oscar Bergström
+*/
+
+#ifndef LINEOPERATION_H
+#define LINEOPERATION_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include "textData.h"
+#include "allocHandler.h"
+
+#define LINE_SORT_SPLIT 65536
+#define LINE_MAX_WORKERS 8
+
+enum lineOperation
+{
+	LINES_SORT,
+	LINES_UNIQUE,
+	LINES_REVERSE,
+	LINES_KEEP,
+	LINES_DROP
+};
+
+typedef struct lineSpan
+{
+	const char *text;
+	long length;
+} lineSpan;
+
+char *applyLineOperation(int operation, const char *text, long size, const char *pattern, long *newSize);
+
+#endif // LINEOPERATION_H
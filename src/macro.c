@@ -0,0 +1,136 @@
+/*
+	Writen by: Oscar Bergström
+	https://github.com/OSCARJFB
+
+	MIT License
+	Copyright (c) 2023 Oscar Bergström
+*/
+
+#include "macro.h"
+
+// The keys of the recorded macro, a new recording replaces them.
+static int *_keys = NULL;
+static long _keyCount = 0, _keyCapacity = 0;
+static bool _isRecording = false;
+
+// The replay position, every iteration replays all the keys.
+static long _nextKey = 0, _iterationsLeft = 0;
+static bool _isEveryLine = false;
+
+/**
+ * Start recording a new macro, the old one is removed.
+ */
+void startRecording(void)
+{
+	_keyCount = 0;
+	_isRecording = true;
+}
+
+/**
+ * Stop recording, the macro keeps the keys recorded so far.
+ */
+void stopRecording(void)
+{
+	_isRecording = false;
+}
+
+/**
+ * Check if keys are being recorded.
+ */
+bool isRecording(void)
+{
+	return _isRecording;
+}
+
+/**
+ * Add a key to the macro while recording. Returns the key.
+ */
+int recordKey(int ch)
+{
+	if (!_isRecording)
+	{
+		return ch;
+	}
+
+	if (_keyCount == _keyCapacity)
+	{
+		long capacity = _keyCapacity > 0 ? _keyCapacity * 2 : 64;
+		_keys = memAlloc(realloc(_keys, capacity * sizeof(int)), capacity * sizeof(int));
+		trackMemory(MEM_BUFFERS, (capacity - _keyCapacity) * (long)sizeof(int));
+		_keyCapacity = capacity;
+	}
+	_keys[_keyCount++] = ch;
+
+	return ch;
+}
+
+/**
+ * Remove the last keys recorded, used for keys that control the macro itself.
+ */
+void dropKeys(int count)
+{
+	if (_isRecording)
+	{
+		_keyCount = _keyCount > count ? _keyCount - count : 0;
+	}
+}
+
+/**
+ * Replay the macro a number of times. When replayed on every line each iteration starts with MACRO_LINE_KEY,
+ * which moves the cursor to the line to replay it on. Returns false if there is no macro.
+ */
+bool startReplay(long times, bool isEveryLine)
+{
+	if (_isRecording || _keyCount == 0 || times <= 0)
+	{
+		return false;
+	}
+
+	_nextKey = isEveryLine ? -1 : 0;
+	_iterationsLeft = times;
+	_isEveryLine = isEveryLine;
+	return true;
+}
+
+/**
+ * Check if there are keys left to replay.
+ */
+bool isReplaying(void)
+{
+	return _iterationsLeft > 0;
+}
+
+/**
+ * Take the next key of the macro being replayed.
+ */
+int replayKey(void)
+{
+	int ch = _nextKey == -1 ? MACRO_LINE_KEY : _keys[_nextKey];
+	if (++_nextKey == _keyCount)
+	{
+		_nextKey = _isEveryLine ? -1 : 0;
+		--_iterationsLeft;
+	}
+
+	return ch;
+}
+
+/**
+ * Stop replaying before every iteration is done.
+ */
+void stopReplay(void)
+{
+	_iterationsLeft = 0;
+}
+
+/**
+ * Remove the macro.
+ */
+void clearMacro(void)
+{
+	trackMemory(MEM_BUFFERS, -_keyCapacity * (long)sizeof(int));
+	free(_keys);
+	_keys = NULL;
+	_keyCount = _keyCapacity = _nextKey = _iterationsLeft = 0;
+	_isRecording = false;
+}
@@ -0,0 +1,30 @@
+/*
+	Writen by: Oscar Bergström
+	https://github.com/OSCARJFB
+
+	MIT License
+	Copyright (c) 2023 Oscar Bergström
+*/
+
+#ifndef MACRO_H
+#define MACRO_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include "textData.h"
+#include "allocHandler.h"
+
+#define MACRO_LINE_KEY (KEY_MAX + 7)
+
+void startRecording(void);
+void stopRecording(void);
+bool isRecording(void);
+int recordKey(int ch);
+void dropKeys(int count);
+bool startReplay(long times, bool isEveryLine);
+bool isReplaying(void);
+int replayKey(void);
+void stopReplay(void);
+void clearMacro(void);
+
+#endif // MACRO_H
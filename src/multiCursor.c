@@ -0,0 +1,189 @@
+/*
+	Writen by: Oscar Bergström
+	https://github.com/OSCARJFB
+
+	MIT License
+	Copyright (c) 2023 Oscar Bergström
+*/
+
+#include <string.h>
+#include "multiCursor.h"
+
+// The extra cursors in the order their nodes have in the list, each one sits on the node text is added in front of.
+static cursor *_cursors = NULL;
+static int _cursorCount = 0, _cursorCapacity = 0;
+
+// The nodes of the cursors hashed by address, so printing can tell if a node holds a cursor.
+static TEXT **_cursorSet = NULL;
+static int _setSize = 0;
+
+static void buildCursorSet(void);
+static long hashNode(TEXT *node);
+
+/**
+ * Check if there are any extra cursors.
+ */
+bool hasCursors(void)
+{
+	return _cursorCount > 0;
+}
+
+/**
+ * The amount of extra cursors.
+ */
+int getCursorCount(void)
+{
+	return _cursorCount;
+}
+
+/**
+ * The extra cursors, sorted by their place in the text.
+ */
+cursor *getCursors(void)
+{
+	return _cursors;
+}
+
+/**
+ * Add a cursor on a node, after the last cursor or before the first one. Returns false if the node already holds a cursor.
+ * The end of the text can't hold an extra cursor.
+ */
+bool addCursor(TEXT *node, long line, bool isLast)
+{
+	if (node == NULL || isCursorNode(node))
+	{
+		return false;
+	}
+
+	if (_cursorCount == _cursorCapacity)
+	{
+		int capacity = _cursorCapacity > 0 ? _cursorCapacity * 2 : 16;
+		_cursors = memAlloc(realloc(_cursors, capacity * sizeof(cursor)), capacity * sizeof(cursor));
+		trackMemory(MEM_STRUCTURE, (capacity - _cursorCapacity) * (long)sizeof(cursor));
+		_cursorCapacity = capacity;
+	}
+
+	int i = isLast ? _cursorCount : 0;
+	memmove(&_cursors[i + 1], &_cursors[i], (_cursorCount - i) * sizeof(cursor));
+	_cursors[i].node = node;
+	_cursors[i].line = line;
+	_cursors[i].offset = 0;
+	++_cursorCount;
+
+	buildCursorSet();
+	return true;
+}
+
+/**
+ * Remove the cursors that ended up on the same node as the cursor before them or as the primary cursor.
+ */
+void mergeCursors(TEXT *primary)
+{
+	int count = 0;
+	for (int i = 0; i < _cursorCount; ++i)
+	{
+		if (_cursors[i].node == primary || (count > 0 && _cursors[count - 1].node == _cursors[i].node))
+		{
+			continue;
+		}
+		_cursors[count++] = _cursors[i];
+	}
+
+	if (count != _cursorCount)
+	{
+		_cursorCount = count;
+		buildCursorSet();
+	}
+}
+
+/**
+ * Move every cursor a node to the left (direction -1) or right (1), the cursors stay on their lines.
+ */
+void moveCursors(int direction)
+{
+	for (int i = 0; i < _cursorCount; ++i)
+	{
+		TEXT *node = _cursors[i].node;
+		if (direction < 0 && prevNode(node) != NULL && prevNode(node)->ch != '\n')
+		{
+			_cursors[i].node = prevNode(node);
+		}
+		else if (direction > 0 && node->ch != '\n' && nextNode(node) != NULL)
+		{
+			_cursors[i].node = nextNode(node);
+		}
+	}
+
+	buildCursorSet();
+	mergeCursors(NULL);
+}
+
+/**
+ * Check if a node holds an extra cursor.
+ */
+bool isCursorNode(TEXT *node)
+{
+	if (_cursorCount == 0 || node == NULL)
+	{
+		return false;
+	}
+
+	for (long i = hashNode(node); _cursorSet[i] != NULL; i = (i + 1) & (_setSize - 1))
+	{
+		if (_cursorSet[i] == node)
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/**
+ * Remove every extra cursor.
+ */
+void clearCursors(void)
+{
+	trackMemory(MEM_STRUCTURE, -_cursorCapacity * (long)sizeof(cursor) - _setSize * (long)sizeof(TEXT *));
+	free(_cursors);
+	free(_cursorSet);
+	_cursors = NULL;
+	_cursorSet = NULL;
+	_cursorCount = _cursorCapacity = _setSize = 0;
+}
+
+/**
+ * Hash the cursor nodes again, the set is kept at most half full.
+ */
+static void buildCursorSet(void)
+{
+	int size = _setSize > 0 ? _setSize : 32;
+	for (; size < _cursorCount * 2; size *= 2)
+	{
+	}
+
+	if (size != _setSize)
+	{
+		_cursorSet = memAlloc(realloc(_cursorSet, size * sizeof(TEXT *)), size * sizeof(TEXT *));
+		trackMemory(MEM_STRUCTURE, (size - _setSize) * (long)sizeof(TEXT *));
+		_setSize = size;
+	}
+
+	memset(_cursorSet, 0, _setSize * sizeof(TEXT *));
+	for (int i = 0; i < _cursorCount; ++i)
+	{
+		long slot = hashNode(_cursors[i].node);
+		for (; _cursorSet[slot] != NULL && _cursorSet[slot] != _cursors[i].node; slot = (slot + 1) & (_setSize - 1))
+		{
+		}
+		_cursorSet[slot] = _cursors[i].node;
+	}
+}
+
+/**
+ * The slot of a node in the cursor set. The nodes of the pool are evenly spaced, so the index is mixed and the high bits of the product are used.
+ */
+static long hashNode(TEXT *node)
+{
+	return (long)((((uint64_t)(node - _nodePool) * 0x9E3779B97F4A7C15ull) >> 32) & (uint64_t)(_setSize - 1));
+}
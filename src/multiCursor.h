@@ -0,0 +1,33 @@
+/*
+	Writen by: Oscar Bergström
+	https://github.com/OSCARJFB
+
+	MIT License
+	Copyright (c) 2023 Oscar Bergström
+*/
+
+#ifndef MULTICURSOR_H
+#define MULTICURSOR_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "textData.h"
+#include "allocHandler.h"
+
+typedef struct cursor
+{
+	TEXT *node;
+	long line, offset;
+} cursor;
+
+bool hasCursors(void);
+int getCursorCount(void);
+cursor *getCursors(void);
+bool addCursor(TEXT *node, long line, bool isLast);
+void mergeCursors(TEXT *primary);
+void moveCursors(int direction);
+bool isCursorNode(TEXT *node);
+void clearCursors(void);
+
+#endif // MULTICURSOR_H
@@ -0,0 +1,680 @@
+/*
+	Writen by: Oscar Bergström
+	https://github.com/OSCARJFB
+
+	MIT License
+	Copyright (c) 2023 Oscar Bergström
+*/
+
+#define _POSIX_C_SOURCE 200809L
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include "pagedFile.h"
+
+typedef struct page
+{
+	long start, size, lines, overlaySize;
+	char *overlay;
+	bool isEdited;
+} page;
+
+typedef struct cachedPage
+{
+	long page, capacity;
+	char *text;
+	long long lastUse;
+} cachedPage;
+
+static int _pagedFd = -1;
+static char *_pagedName = NULL;
+static struct stat _pagedStat;
+static page *_pages = NULL;
+static long _pageCount = 0, _pageCapacity = 0;
+static long _firstPage = 0, _lastPage = 0;
+static long _pagedLimit = PAGED_FILE_MB * 1024L * 1024L;
+static cachedPage _cache[PAGE_CACHE_SIZE];
+static long long _cacheUse = 0;
+static pthread_t _scanThread;
+static pthread_mutex_t _pageLock = PTHREAD_MUTEX_INITIALIZER;
+static bool _isScanning = false, _isScanStopped = false;
+static char *_scanBuffer = NULL;
+static long *_linesBefore = NULL;
+static long _linesBeforeCapacity = 0, _countedPages = 0, _linesVersion = 0, _prefixVersion = -1;
+
+static void addPages(long start, long end);
+static long countLines(const char *text, long size);
+static void *scanPages(void *arg);
+static void startScan(void);
+static void stopScan(void);
+static void freeOverlay(page *overlaid);
+static void clearPageCache(void);
+static void updateLinesBefore(void);
+
+/**
+ * Set the file size from which files are edited in pages, from a string holding a number of megabytes.
+ * A missing or invalid limit keeps the default limit.
+ */
+void setPagedFileLimit(const char *megaBytes)
+{
+	if (megaBytes == NULL)
+	{
+		return;
+	}
+
+	long limit = strtol(megaBytes, NULL, 10);
+	_pagedLimit = limit > 0 ? limit * 1024L * 1024L : _pagedLimit;
+}
+
+/**
+ * Files larger than the limit, or too large to be loaded within the memory budget, are edited in pages.
+ */
+bool isPagedSize(long fileSize)
+{
+	return fileSize > _pagedLimit || (fileSize > 0 && !isWithinMemoryBudget(fileSize + getNodesCost(fileSize)));
+}
+
+/**
+ * Add pages of FILE_PAGE_SIZE characters covering the file from offset start to offset end.
+ */
+static void addPages(long start, long end)
+{
+	long count = _pageCount + (end - start + FILE_PAGE_SIZE - 1) / FILE_PAGE_SIZE;
+
+	pthread_mutex_lock(&_pageLock);
+	if (count > _pageCapacity)
+	{
+		long capacity = count + count / 4;
+		_pages = memAlloc(realloc(_pages, capacity * sizeof(page)), capacity * sizeof(page));
+		trackMemory(MEM_STRUCTURE, (capacity - _pageCapacity) * (long)sizeof(page));
+		_pageCapacity = capacity;
+	}
+
+	for (; start < end; start += FILE_PAGE_SIZE)
+	{
+		page *newPage = &_pages[_pageCount++];
+		newPage->start = start;
+		newPage->size = end - start < FILE_PAGE_SIZE ? end - start : FILE_PAGE_SIZE;
+		newPage->lines = -1;
+		newPage->overlay = NULL;
+		newPage->overlaySize = 0;
+		newPage->isEdited = false;
+	}
+	++_linesVersion;
+	pthread_mutex_unlock(&_pageLock);
+}
+
+/**
+ * Count the newlines of a text.
+ */
+static long countLines(const char *text, long size)
+{
+	long lines = 0;
+	for (const char *end = text + size; (text = memchr(text, '\n', end - text)) != NULL; ++text)
+	{
+		++lines;
+	}
+
+	return lines;
+}
+
+/**
+ * Count the lines of every page in the background, this builds the line index used to find lines far from the view.
+ * Pages that were read or edited by the editor are skipped, their lines are already known or no longer in the file.
+ */
+static void *scanPages(void *arg)
+{
+	(void)arg;
+	for (long i = 0;; ++i)
+	{
+		pthread_mutex_lock(&_pageLock);
+		bool isDone = _isScanStopped || i >= _pageCount;
+		bool isKnown = isDone || _pages[i].lines != -1 || _pages[i].isEdited || _pages[i].overlay != NULL;
+		long start = isKnown ? 0 : _pages[i].start, size = isKnown ? 0 : _pages[i].size;
+		pthread_mutex_unlock(&_pageLock);
+
+		if (isDone)
+		{
+			break;
+		}
+
+		if (isKnown)
+		{
+			continue;
+		}
+
+		long lines = 0;
+		for (long done = 0; done < size;)
+		{
+			ssize_t bytes = pread(_pagedFd, _scanBuffer, size - done < FILE_PAGE_SIZE ? size - done : FILE_PAGE_SIZE, start + done);
+			if (bytes <= 0)
+			{
+				lines = -1;
+				break;
+			}
+			lines += countLines(_scanBuffer, bytes);
+			done += bytes;
+		}
+
+		pthread_mutex_lock(&_pageLock);
+		if (!_pages[i].isEdited && _pages[i].overlay == NULL && _pages[i].lines == -1)
+		{
+			_pages[i].lines = lines;
+			++_linesVersion;
+		}
+		pthread_mutex_unlock(&_pageLock);
+	}
+
+	return NULL;
+}
+
+/**
+ * Start counting the lines of the pages that aren't counted yet.
+ */
+static void startScan(void)
+{
+	_scanBuffer = memAlloc(malloc(FILE_PAGE_SIZE), FILE_PAGE_SIZE);
+	trackMemory(MEM_BUFFERS, FILE_PAGE_SIZE);
+	_isScanStopped = false;
+	_isScanning = pthread_create(&_scanThread, NULL, scanPages, NULL) == 0;
+}
+
+/**
+ * Stop the background scan and wait for it to finish.
+ */
+static void stopScan(void)
+{
+	if (_isScanning)
+	{
+		pthread_mutex_lock(&_pageLock);
+		_isScanStopped = true;
+		pthread_mutex_unlock(&_pageLock);
+		pthread_join(_scanThread, NULL);
+		_isScanning = false;
+	}
+
+	if (_scanBuffer != NULL)
+	{
+		trackMemory(MEM_BUFFERS, -FILE_PAGE_SIZE);
+		free(_scanBuffer);
+		_scanBuffer = NULL;
+	}
+}
+
+/**
+ * Open a file to be edited in pages, only the pages around the view are kept in the list.
+ * The first page is the window when the file is opened. Returns false if the file can't be opened.
+ */
+bool openPagedFile(const char *fileName)
+{
+	struct stat fileStat;
+	int fd = open(fileName, O_RDONLY);
+	if (fd == -1 || fstat(fd, &fileStat) != 0)
+	{
+		if (fd != -1)
+		{
+			close(fd);
+		}
+		return false;
+	}
+
+	closePagedFile();
+	_pagedFd = fd;
+	_pagedStat = fileStat;
+
+	long size = strlen(fileName) + 1;
+	_pagedName = memAlloc(malloc(size), size);
+	strcpy(_pagedName, fileName);
+
+	addPages(0, fileStat.st_size);
+	_firstPage = _lastPage = 0;
+	startScan();
+	return true;
+}
+
+/**
+ * Close the paged file, edits that weren't saved are thrown away.
+ */
+void closePagedFile(void)
+{
+	if (_pagedFd == -1)
+	{
+		return;
+	}
+
+	stopScan();
+	for (long i = 0; i < _pageCount; ++i)
+	{
+		freeOverlay(&_pages[i]);
+	}
+
+	trackMemory(MEM_STRUCTURE, -_pageCapacity * (long)sizeof(page));
+	free(_pages);
+	_pages = NULL;
+	_pageCount = _pageCapacity = 0;
+
+	trackMemory(MEM_STRUCTURE, -_linesBeforeCapacity * (long)sizeof(long));
+	free(_linesBefore);
+	_linesBefore = NULL;
+	_linesBeforeCapacity = _countedPages = 0;
+	_prefixVersion = -1;
+
+	clearPageCache();
+	close(_pagedFd);
+	_pagedFd = -1;
+	free(_pagedName);
+	_pagedName = NULL;
+}
+
+/**
+ * Check if the open document is a paged file.
+ */
+bool isPaged(void)
+{
+	return _pagedFd != -1;
+}
+
+/**
+ * Check if any page was edited since the file was opened or saved.
+ */
+bool isPagedFileEdited(void)
+{
+	for (long i = 0; i < _pageCount; ++i)
+	{
+		if (_pages[i].isEdited || _pages[i].overlay != NULL)
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/**
+ * The amount of pages in the file.
+ */
+long getPageCount(void)
+{
+	return _pageCount;
+}
+
+/**
+ * The first page held by the list.
+ */
+long getFirstPage(void)
+{
+	return _firstPage;
+}
+
+/**
+ * The last page held by the list.
+ */
+long getLastPage(void)
+{
+	return _lastPage;
+}
+
+/**
+ * The offset of an unedited page in the file.
+ */
+long getPageStart(long page)
+{
+	return _pages[page].start;
+}
+
+/**
+ * The amount of characters in a page, including edits.
+ */
+long getPageSize(long page)
+{
+	return _pages[page].size;
+}
+
+/**
+ * The amount of lines ending in a page, -1 if they aren't counted yet.
+ */
+long getPageLines(long page)
+{
+	pthread_mutex_lock(&_pageLock);
+	long lines = _pages[page].isEdited ? -1 : _pages[page].lines;
+	pthread_mutex_unlock(&_pageLock);
+
+	return lines;
+}
+
+/**
+ * Sum up the lines ending before each page, up to the first page whose lines aren't known.
+ * The sums are only updated when the lines of a page changed since the last time, must be called with the page lock held.
+ */
+static void updateLinesBefore(void)
+{
+	if (_prefixVersion == _linesVersion)
+	{
+		return;
+	}
+
+	if (_pageCount + 1 > _linesBeforeCapacity)
+	{
+		long capacity = _pageCount + 1;
+		_linesBefore = memAlloc(realloc(_linesBefore, capacity * sizeof(long)), capacity * sizeof(long));
+		trackMemory(MEM_STRUCTURE, (capacity - _linesBeforeCapacity) * (long)sizeof(long));
+		_linesBeforeCapacity = capacity;
+	}
+
+	_linesBefore[0] = 0;
+	for (_countedPages = 0; _countedPages < _pageCount; ++_countedPages)
+	{
+		page *counted = &_pages[_countedPages];
+		if (counted->lines == -1 || counted->isEdited)
+		{
+			break;
+		}
+		_linesBefore[_countedPages + 1] = _linesBefore[_countedPages] + counted->lines;
+	}
+	_prefixVersion = _linesVersion;
+}
+
+/**
+ * The amount of lines ending before a page, -1 if they aren't counted yet.
+ */
+long getLinesBefore(long page)
+{
+	pthread_mutex_lock(&_pageLock);
+	updateLinesBefore();
+	long lines = page <= _countedPages ? _linesBefore[page] : -1;
+	pthread_mutex_unlock(&_pageLock);
+
+	return lines;
+}
+
+/**
+ * Find the page holding the newline that ends the line before a line (counted from 0), the line starts in that page or the next one.
+ * A line past the end of the file gives the last page. Returns -1 if the pages aren't counted that far yet.
+ */
+long findLinePage(long line)
+{
+	pthread_mutex_lock(&_pageLock);
+	updateLinesBefore();
+
+	long found = -1;
+	if (_countedPages == _pageCount && line > _linesBefore[_countedPages])
+	{
+		found = _pageCount - 1;
+	}
+	else if (line <= 0)
+	{
+		found = 0;
+	}
+	else if (line <= _linesBefore[_countedPages])
+	{
+		// The first page after which at least line newlines have ended.
+		long low = 0, high = _countedPages - 1;
+		while (low < high)
+		{
+			long middle = low + (high - low) / 2;
+			if (_linesBefore[middle + 1] >= line)
+			{
+				high = middle;
+			}
+			else
+			{
+				low = middle + 1;
+			}
+		}
+		found = low;
+	}
+	pthread_mutex_unlock(&_pageLock);
+
+	return found;
+}
+
+/**
+ * Check if a page in the window was edited.
+ */
+bool isPageEdited(long page)
+{
+	return _pages[page].isEdited;
+}
+
+/**
+ * The edited text of a page that was moved out of the window, NULL if the page is unedited.
+ */
+const char *getPageOverlay(long page)
+{
+	return _pages[page].overlay;
+}
+
+/**
+ * The descriptor of the file the unedited pages are read from.
+ */
+int getPagedFd(void)
+{
+	return _pagedFd;
+}
+
+/**
+ * Get the text of a page, the edited text if the page was edited.
+ * Pages read from the file are kept in a cache of PAGE_CACHE_SIZE pages, the least recently used page is replaced.
+ * The returned text is valid until the next page is read.
+ */
+const char *readPage(long page, long *size)
+{
+	*size = _pages[page].size;
+	if (_pages[page].overlay != NULL)
+	{
+		return _pages[page].overlay;
+	}
+
+	cachedPage *slot = NULL;
+	for (int i = 0; i < PAGE_CACHE_SIZE; ++i)
+	{
+		if (_cache[i].text != NULL && _cache[i].page == page)
+		{
+			_cache[i].lastUse = ++_cacheUse;
+			return _cache[i].text;
+		}
+		slot = slot == NULL || _cache[i].lastUse < slot->lastUse ? &_cache[i] : slot;
+	}
+
+	if (slot->capacity < *size)
+	{
+		slot->text = memAlloc(realloc(slot->text, *size), *size);
+		trackMemory(MEM_BUFFERS, *size - slot->capacity);
+		slot->capacity = *size;
+	}
+
+	long done = 0;
+	for (ssize_t bytes = 0; done < *size; done += bytes)
+	{
+		bytes = pread(_pagedFd, slot->text + done, *size - done, _pages[page].start + done);
+		if (bytes <= 0)
+		{
+			break;
+		}
+	}
+
+	// A file that got shorter only gives back what's left of the page.
+	pthread_mutex_lock(&_pageLock);
+	_pages[page].size = *size = done;
+	_pages[page].lines = _pages[page].lines == -1 ? countLines(slot->text, done) : _pages[page].lines;
+	++_linesVersion;
+	pthread_mutex_unlock(&_pageLock);
+
+	slot->page = page;
+	slot->lastUse = ++_cacheUse;
+	return slot->text;
+}
+
+/**
+ * Start the window at a page, returning a copy of its text which is counted as MEM_BUFFERS memory.
+ */
+char *readWindow(long page, long *size)
+{
+	const char *text = readPage(page, size);
+	char *buffer = memAlloc(malloc(*size > 0 ? *size : 1), *size > 0 ? *size : 1);
+	trackMemory(MEM_BUFFERS, *size);
+	memcpy(buffer, text, *size);
+
+	_firstPage = _lastPage = page;
+	return buffer;
+}
+
+/**
+ * Set the pages held by the list.
+ */
+void setWindow(long firstPage, long lastPage)
+{
+	_firstPage = firstPage;
+	_lastPage = lastPage;
+}
+
+/**
+ * Keep the text of an edited page that is moved out of the window.
+ */
+void storePage(long page, const char *text, long size)
+{
+	char *overlay = memAlloc(malloc(size > 0 ? size : 1), size > 0 ? size : 1);
+	memcpy(overlay, text, size);
+	trackMemory(MEM_DOCUMENT, size);
+
+	pthread_mutex_lock(&_pageLock);
+	freeOverlay(&_pages[page]);
+	_pages[page].overlay = overlay;
+	_pages[page].overlaySize = size;
+	_pages[page].size = size;
+	_pages[page].lines = countLines(text, size);
+	_pages[page].isEdited = false;
+	++_linesVersion;
+	pthread_mutex_unlock(&_pageLock);
+}
+
+/**
+ * Free the edited text of a page.
+ */
+static void freeOverlay(page *overlaid)
+{
+	trackMemory(MEM_DOCUMENT, -overlaid->overlaySize);
+	free(overlaid->overlay);
+	overlaid->overlay = NULL;
+	overlaid->overlaySize = 0;
+}
+
+/**
+ * Record an edit of the window, text inserted (size > 0) or deleted (size < 0) at an offset from the start of the window.
+ * Text inserted where two pages meet is added to the first of them.
+ */
+void editPages(long offset, long size)
+{
+	if (_pagedFd == -1)
+	{
+		return;
+	}
+
+	long position = 0;
+	for (long i = _firstPage; i <= _lastPage; ++i)
+	{
+		long pageSize = _pages[i].size, change = 0;
+		if (size > 0)
+		{
+			change = offset >= position && (offset <= position + pageSize || i == _lastPage) ? size : 0;
+		}
+		else
+		{
+			long start = offset > position ? offset : position;
+			long end = offset - size < position + pageSize ? offset - size : position + pageSize;
+			change = end > start ? start - end : 0;
+		}
+
+		if (change != 0)
+		{
+			pthread_mutex_lock(&_pageLock);
+			_pages[i].size += change;
+			_pages[i].isEdited = true;
+			++_linesVersion;
+			pthread_mutex_unlock(&_pageLock);
+		}
+
+		if (size > 0 && change != 0)
+		{
+			break;
+		}
+		position += pageSize;
+	}
+}
+
+/**
+ * Add pages for text appended to the file by another program.
+ * Returns the amount of characters added.
+ */
+long appendPages(void)
+{
+	struct stat current;
+	if (_pagedFd == -1 || fstat(_pagedFd, &current) != 0 || current.st_size <= _pagedStat.st_size)
+	{
+		return 0;
+	}
+
+	long added = current.st_size - _pagedStat.st_size;
+	addPages(_pagedStat.st_size, current.st_size);
+	_pagedStat = current;
+	return added;
+}
+
+/**
+ * The unedited pages can only be copied if the file still is the one the pages were read from.
+ */
+bool isPagedSourceUnchanged(const char *fileName)
+{
+	struct stat current;
+	if (_pagedName == NULL || fileName == NULL || strcmp(fileName, _pagedName) != 0 || stat(fileName, &current) != 0)
+	{
+		return false;
+	}
+
+	return current.st_ino == _pagedStat.st_ino && current.st_size == _pagedStat.st_size &&
+		   current.st_mtim.tv_sec == _pagedStat.st_mtim.tv_sec && current.st_mtim.tv_nsec == _pagedStat.st_mtim.tv_nsec;
+}
+
+/**
+ * Read the pages from the saved file, where every page now holds its edited text.
+ */
+void rebasePages(const char *fileName)
+{
+	stopScan();
+	int fd = open(fileName, O_RDONLY);
+	if (fd != -1)
+	{
+		close(_pagedFd);
+		_pagedFd = fd;
+		fstat(_pagedFd, &_pagedStat);
+
+		long start = 0;
+		for (long i = 0; i < _pageCount; start += _pages[i++].size)
+		{
+			_pages[i].start = start;
+			_pages[i].lines = _pages[i].isEdited ? -1 : _pages[i].lines;
+			_pages[i].isEdited = false;
+			freeOverlay(&_pages[i]);
+		}
+		++_linesVersion;
+		clearPageCache();
+	}
+	startScan();
+}
+
+/**
+ * Free the cached pages.
+ */
+static void clearPageCache(void)
+{
+	for (int i = 0; i < PAGE_CACHE_SIZE; ++i)
+	{
+		trackMemory(MEM_BUFFERS, -_cache[i].capacity);
+		free(_cache[i].text);
+		_cache[i].text = NULL;
+		_cache[i].capacity = 0;
+		_cache[i].lastUse = 0;
+	}
+}
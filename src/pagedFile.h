@@ -0,0 +1,47 @@
+/*
+	Writen by: Oscar Bergström
+	https://github.com/OSCARJFB
+
+	MIT License
+	Copyright (c) 2023 Oscar Bergström
+*/
+
+#ifndef PAGEDFILE_H
+#define PAGEDFILE_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include "allocHandler.h"
+
+#define FILE_PAGE_SIZE (64L * 1024L)
+#define PAGE_CACHE_SIZE 16
+#define PAGED_WINDOW_PAGES 4
+#define PAGED_FILE_MB 64
+
+void setPagedFileLimit(const char *megaBytes);
+bool isPagedSize(long fileSize);
+bool openPagedFile(const char *fileName);
+void closePagedFile(void);
+bool isPaged(void);
+bool isPagedFileEdited(void);
+long getPageCount(void);
+long getFirstPage(void);
+long getLastPage(void);
+long getPageStart(long page);
+long getPageSize(long page);
+long getPageLines(long page);
+long getLinesBefore(long page);
+long findLinePage(long line);
+bool isPageEdited(long page);
+const char *getPageOverlay(long page);
+int getPagedFd(void);
+const char *readPage(long page, long *size);
+char *readWindow(long page, long *size);
+void setWindow(long firstPage, long lastPage);
+void storePage(long page, const char *text, long size);
+void editPages(long offset, long size);
+long appendPages(void);
+bool isPagedSourceUnchanged(const char *fileName);
+void rebasePages(const char *fileName);
+
+#endif // PAGEDFILE_H
@@ -0,0 +1,483 @@
+/*
+	Writen by: Oscar Bergström
+	https://github.com/OSCARJFB
+
+	MIT License
+	Copyright (c) 2023 Oscar Bergström
+*/
+
+#define _POSIX_C_SOURCE 200809L
+#include <fcntl.h>
+#include <unistd.h>
+#include <signal.h>
+#include <setjmp.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <dirent.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "projectSearch.h"
+#include "eventLoop.h"
+
+// The paths a worker still has to search, the worker takes from the tail and idle workers steal from the head.
+typedef struct searchQueue
+{
+	char **paths;
+	int head, tail, capacity;
+	pthread_mutex_t lock;
+} searchQueue;
+
+static searchQueue _queues[SEARCH_MAX_WORKERS];
+static pthread_t _workers[SEARCH_MAX_WORKERS];
+static int _queueCount = 0, _workerCount = 0;
+static char _pattern[SEARCH_PATTERN_SIZE];
+static int _patternLength = 0;
+
+// The results and the amount of paths left to search are shared by the workers and the editor.
+static pthread_mutex_t _searchLock = PTHREAD_MUTEX_INITIALIZER;
+static searchResult *_results = NULL;
+static long _resultCount = 0, _resultCapacity = 0, _trackedBytes = 0, _pendingPaths = 0;
+static bool _isStopped = false;
+
+// A mapped file cut short by another program raises SIGBUS when the missing pages are read, the worker scanning it jumps back out.
+static __thread sigjmp_buf *_scanGuard = NULL;
+static struct sigaction _oldBusAction;
+
+static void *searchWorker(void *arg);
+static void pushPath(int worker, const char *path);
+static char *popPath(int worker);
+static char *stealPath(int worker);
+static void finishPath(void);
+static void searchPath(int worker, const char *path);
+static void searchDirectory(int worker, const char *path);
+static void searchFile(const char *path);
+static void scanText(const char *path, const char *text, long size);
+static void addResult(const char *path, long line, const char *text, long size);
+static void onBusError(int signal);
+static void freeQueues(void);
+
+/**
+ * Search every file below a directory for a pattern, the search runs in the background until stopSearch is called.
+ * Results can be read while the search is running. Returns false if no worker could be started.
+ */
+bool startSearch(const char *root, const char *pattern)
+{
+	_patternLength = strlen(pattern);
+	if (_patternLength == 0 || _patternLength >= SEARCH_PATTERN_SIZE)
+	{
+		return false;
+	}
+	memcpy(_pattern, pattern, _patternLength + 1);
+
+	long processors = sysconf(_SC_NPROCESSORS_ONLN);
+	int workers = processors < 1 ? 1 : processors > SEARCH_MAX_WORKERS ? SEARCH_MAX_WORKERS : processors;
+
+	_isStopped = false;
+	_resultCount = _pendingPaths = 0;
+	for (int i = 0; i < workers; ++i)
+	{
+		_queues[i].paths = NULL;
+		_queues[i].head = _queues[i].tail = _queues[i].capacity = 0;
+		pthread_mutex_init(&_queues[i].lock, NULL);
+	}
+	pushPath(0, root);
+
+	struct sigaction busAction;
+	memset(&busAction, 0, sizeof(busAction));
+	busAction.sa_handler = onBusError;
+	sigemptyset(&busAction.sa_mask);
+	sigaction(SIGBUS, &busAction, &_oldBusAction);
+
+	// The workers steal from every queue, so the queue count is set before any of them is started and isn't changed while they run.
+	_queueCount = workers;
+	int started = 0;
+	while (started < workers && pthread_create(&_workers[started], NULL, searchWorker, (void *)(intptr_t)started) == 0)
+	{
+		++started;
+	}
+	_workerCount = started;
+
+	// Without a worker the root is never taken from its queue.
+	if (_workerCount == 0)
+	{
+		free(popPath(0));
+		freeQueues();
+		sigaction(SIGBUS, &_oldBusAction, NULL);
+		return false;
+	}
+
+	return true;
+}
+
+/**
+ * The amount of results found so far. The memory of the results is accounted here, the workers can't track memory themselves.
+ */
+long getResultCount(void)
+{
+	pthread_mutex_lock(&_searchLock);
+	long count = _resultCount, bytes = _resultCapacity * (long)sizeof(searchResult);
+	pthread_mutex_unlock(&_searchLock);
+
+	trackMemory(MEM_BUFFERS, bytes - _trackedBytes);
+	_trackedBytes = bytes;
+	return count;
+}
+
+/**
+ * Copy a result, results keep their index while the search is running. Returns false if there is no such result.
+ */
+bool getSearchResult(long index, searchResult *result)
+{
+	pthread_mutex_lock(&_searchLock);
+	bool isFound = index >= 0 && index < _resultCount;
+	if (isFound)
+	{
+		*result = _results[index];
+	}
+	pthread_mutex_unlock(&_searchLock);
+
+	return isFound;
+}
+
+/**
+ * Check if every file has been searched.
+ */
+bool isSearchDone(void)
+{
+	pthread_mutex_lock(&_searchLock);
+	bool isDone = _pendingPaths == 0;
+	pthread_mutex_unlock(&_searchLock);
+
+	return isDone;
+}
+
+/**
+ * Stop the search, wait for the workers to finish and free the results.
+ */
+void stopSearch(void)
+{
+	pthread_mutex_lock(&_searchLock);
+	_isStopped = true;
+	pthread_mutex_unlock(&_searchLock);
+
+	for (int i = 0; i < _workerCount; ++i)
+	{
+		pthread_join(_workers[i], NULL);
+	}
+	_workerCount = 0;
+	freeQueues();
+	sigaction(SIGBUS, &_oldBusAction, NULL);
+
+	trackMemory(MEM_BUFFERS, -_trackedBytes);
+	free(_results);
+	_results = NULL;
+	_resultCount = _resultCapacity = _trackedBytes = 0;
+}
+
+/**
+ * Search the paths of the worker's own queue, and steal paths from the other queues when it runs empty.
+ * The worker stops when no path is left anywhere, a directory being read by another worker might still add paths.
+ */
+static void *searchWorker(void *arg)
+{
+	int worker = (int)(intptr_t)arg;
+	struct timespec idle = {0, 1000000};
+	for (;;)
+	{
+		char *path = popPath(worker);
+		for (int i = 1; path == NULL && i < _queueCount; ++i)
+		{
+			path = stealPath((worker + i) % _queueCount);
+		}
+
+		if (path == NULL)
+		{
+			if (isSearchDone())
+			{
+				break;
+			}
+			nanosleep(&idle, NULL);
+			continue;
+		}
+
+		pthread_mutex_lock(&_searchLock);
+		bool isStopped = _isStopped;
+		pthread_mutex_unlock(&_searchLock);
+
+		// A stopped search only empties the queues.
+		if (!isStopped)
+		{
+			searchPath(worker, path);
+		}
+		free(path);
+		finishPath();
+	}
+
+	return NULL;
+}
+
+/**
+ * Free the paths of the queues and their locks, the queues are empty once the workers are done.
+ */
+static void freeQueues(void)
+{
+	for (int i = 0; i < _queueCount; ++i)
+	{
+		free(_queues[i].paths);
+		pthread_mutex_destroy(&_queues[i].lock);
+	}
+	_queueCount = 0;
+}
+
+/**
+ * Add a path to the tail of a worker's queue.
+ */
+static void pushPath(int worker, const char *path)
+{
+	long length = strlen(path) + 1;
+	char *copy = memAlloc(malloc(length), length);
+	memcpy(copy, path, length);
+
+	pthread_mutex_lock(&_searchLock);
+	++_pendingPaths;
+	pthread_mutex_unlock(&_searchLock);
+
+	searchQueue *queue = &_queues[worker];
+	pthread_mutex_lock(&queue->lock);
+	if (queue->tail == queue->capacity)
+	{
+		// Move the paths left to the front before growing the queue.
+		int count = queue->tail - queue->head;
+		memmove(queue->paths, queue->paths + queue->head, count * sizeof(char *));
+		queue->head = 0;
+		queue->tail = count;
+		if (count == queue->capacity)
+		{
+			queue->capacity = queue->capacity > 0 ? queue->capacity * 2 : 64;
+			queue->paths = memAlloc(realloc(queue->paths, queue->capacity * sizeof(char *)), queue->capacity * sizeof(char *));
+		}
+	}
+	queue->paths[queue->tail++] = copy;
+	pthread_mutex_unlock(&queue->lock);
+}
+
+/**
+ * Take the newest path of a worker's own queue, NULL if it's empty.
+ */
+static char *popPath(int worker)
+{
+	searchQueue *queue = &_queues[worker];
+	pthread_mutex_lock(&queue->lock);
+	char *path = queue->tail > queue->head ? queue->paths[--queue->tail] : NULL;
+	pthread_mutex_unlock(&queue->lock);
+
+	return path;
+}
+
+/**
+ * Take the oldest path of another worker's queue, NULL if it's empty. The oldest paths are the directories closest to the root.
+ */
+static char *stealPath(int worker)
+{
+	searchQueue *queue = &_queues[worker];
+	pthread_mutex_lock(&queue->lock);
+	char *path = queue->tail > queue->head ? queue->paths[queue->head++] : NULL;
+	pthread_mutex_unlock(&queue->lock);
+
+	return path;
+}
+
+/**
+ * Count a path as searched.
+ */
+static void finishPath(void)
+{
+	pthread_mutex_lock(&_searchLock);
+	bool isDone = --_pendingPaths == 0;
+	pthread_mutex_unlock(&_searchLock);
+
+	if (isDone)
+	{
+		postEvent(EVENT_SEARCH_RESULTS);
+	}
+}
+
+/**
+ * Search a file, or add the entries of a directory to the worker's queue. Symbolic links aren't followed.
+ */
+static void searchPath(int worker, const char *path)
+{
+	struct stat pathStat;
+	if (lstat(path, &pathStat) != 0)
+	{
+		return;
+	}
+
+	if (S_ISDIR(pathStat.st_mode))
+	{
+		searchDirectory(worker, path);
+	}
+	else if (S_ISREG(pathStat.st_mode) && pathStat.st_size > 0)
+	{
+		searchFile(path);
+	}
+}
+
+/**
+ * Add the entries of a directory to the worker's queue, hidden entries (like .git or the journals) are skipped.
+ */
+static void searchDirectory(int worker, const char *path)
+{
+	DIR *directory = opendir(path);
+	if (directory == NULL)
+	{
+		return;
+	}
+
+	char entryPath[FILENAME_SIZE];
+	for (struct dirent *entry = readdir(directory); entry != NULL; entry = readdir(directory))
+	{
+		if (entry->d_name[0] == '.')
+		{
+			continue;
+		}
+
+		// Entries of the current directory are opened by their name.
+		int length = strcmp(path, ".") == 0 ? snprintf(entryPath, FILENAME_SIZE, "%s", entry->d_name)
+											: snprintf(entryPath, FILENAME_SIZE, "%s/%s", path, entry->d_name);
+		if (length < FILENAME_SIZE)
+		{
+			pushPath(worker, entryPath);
+		}
+	}
+
+	closedir(directory);
+}
+
+/**
+ * Map a file and scan it for the pattern, binary files are skipped.
+ * A file truncated while it's scanned has its missing pages reported by SIGBUS, the rest of it is skipped.
+ */
+static void searchFile(const char *path)
+{
+	int fd = open(path, O_RDONLY);
+	if (fd == -1)
+	{
+		return;
+	}
+
+	struct stat fileStat;
+	if (fstat(fd, &fileStat) != 0 || fileStat.st_size == 0)
+	{
+		close(fd);
+		return;
+	}
+
+	long size = fileStat.st_size;
+	char *text = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (text == MAP_FAILED)
+	{
+		return;
+	}
+
+	sigjmp_buf guard;
+	if (sigsetjmp(guard, 1) == 0)
+	{
+		_scanGuard = &guard;
+		posix_madvise(text, size, POSIX_MADV_SEQUENTIAL);
+		if (memchr(text, '\0', size < SEARCH_BINARY_CHECK ? size : SEARCH_BINARY_CHECK) == NULL)
+		{
+			scanText(path, text, size);
+		}
+	}
+	_scanGuard = NULL;
+	munmap(text, size);
+}
+
+/**
+ * Find the lines of a text holding the pattern. The first character of the pattern is found with memchr, which is vectorized by the C library,
+ * and the newlines before a match are counted the same way. Each line is reported once.
+ */
+static void scanText(const char *path, const char *text, long size)
+{
+	const char *end = text + size, *counted = text, *lineStart = text;
+	long line = 1;
+	for (const char *match = text; (match = memchr(match, _pattern[0], end - match)) != NULL;)
+	{
+		if (end - match < _patternLength)
+		{
+			break;
+		}
+
+		if (memcmp(match, _pattern, _patternLength) != 0)
+		{
+			++match;
+			continue;
+		}
+
+		for (const char *newLine = counted; (newLine = memchr(newLine, '\n', match - newLine)) != NULL; ++newLine)
+		{
+			++line;
+			lineStart = newLine + 1;
+		}
+
+		const char *lineEnd = memchr(match, '\n', end - match);
+		lineEnd = lineEnd != NULL ? lineEnd : end;
+		addResult(path, line, lineStart, lineEnd - lineStart);
+
+		// The rest of the line is skipped.
+		match = counted = lineEnd;
+	}
+}
+
+/**
+ * Add a result, the text of the line is cut to fit the result and its control characters are replaced by spaces.
+ * The line is copied before the lock is taken, reading the mapped file may jump out on SIGBUS.
+ */
+static void addResult(const char *path, long line, const char *text, long size)
+{
+	searchResult result;
+	snprintf(result.path, FILENAME_SIZE, "%s", path);
+	result.line = line;
+
+	long length = size < SEARCH_TEXT_SIZE - 1 ? size : SEARCH_TEXT_SIZE - 1;
+	for (long i = 0; i < length; ++i)
+	{
+		result.text[i] = (unsigned char)text[i] < ' ' ? ' ' : text[i];
+	}
+	result.text[length] = '\0';
+
+	pthread_mutex_lock(&_searchLock);
+	if (_resultCount == SEARCH_RESULT_LIMIT)
+	{
+		pthread_mutex_unlock(&_searchLock);
+		return;
+	}
+
+	if (_resultCount == _resultCapacity)
+	{
+		_resultCapacity = _resultCapacity > 0 ? _resultCapacity * 2 : 64;
+		_results = memAlloc(realloc(_results, _resultCapacity * sizeof(searchResult)), _resultCapacity * sizeof(searchResult));
+	}
+
+	_results[_resultCount++] = result;
+	pthread_mutex_unlock(&_searchLock);
+	postEvent(EVENT_SEARCH_RESULTS);
+}
+
+/**
+ * Jump out of the file a worker is scanning, a SIGBUS raised anywhere else is passed on to the handler it had before the search.
+ */
+static void onBusError(int signal)
+{
+	if (_scanGuard != NULL)
+	{
+		siglongjmp(*_scanGuard, 1);
+	}
+
+	sigaction(signal, &_oldBusAction, NULL);
+	raise(signal);
+}
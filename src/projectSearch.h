@@ -0,0 +1,36 @@
+/*
+	Writen by: Oscar Bergström
+	https://github.com/OSCARJFB
+
+	MIT License
+	Copyright (c) 2023 Oscar Bergström
+*/
+
+#ifndef PROJECTSEARCH_H
+#define PROJECTSEARCH_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include "textData.h"
+#include "allocHandler.h"
+
+#define SEARCH_PATTERN_SIZE 64
+#define SEARCH_TEXT_SIZE 80
+#define SEARCH_RESULT_LIMIT 10000
+#define SEARCH_MAX_WORKERS 8
+#define SEARCH_BINARY_CHECK 4096
+
+typedef struct searchResult
+{
+	char path[FILENAME_SIZE];
+	long line;
+	char text[SEARCH_TEXT_SIZE];
+} searchResult;
+
+bool startSearch(const char *root, const char *pattern);
+long getResultCount(void);
+bool getSearchResult(long index, searchResult *result);
+bool isSearchDone(void);
+void stopSearch(void);
+
+#endif // PROJECTSEARCH_H
@@ -0,0 +1,231 @@
+/*
+	Writen by: Oscar Bergström
+	https://github.com/OSCARJFB
+
+	MIT License
+	Copyright (c) 2023 Oscar Bergström
+*/
+
+#define _POSIX_C_SOURCE 200809L
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "sharedClipboard.h"
+
+// The clip shared by every editor of the user. The sequence is odd while a clip is written and grows by two for every clip.
+typedef struct sharedClip
+{
+	unsigned long sequence;
+	long size;
+	char text[];
+} sharedClip;
+
+static int _clipboardFd = -1;
+static sharedClip *_clip = NULL;
+static long _mappedSize = 0;
+static unsigned long _lastSequence = 0;
+static bool _isUnavailable = false;
+
+static bool openSharedClipboard(void);
+static bool mapClipboard(void);
+static bool growClipboard(long size);
+static void lockClipboard(short type);
+
+/**
+ * Open and map the shared memory of the clipboard, it's created the first time. Without shared memory the clipboard is only used locally.
+ */
+static bool openSharedClipboard(void)
+{
+	if (_clip != NULL || _isUnavailable)
+	{
+		return _clip != NULL;
+	}
+
+	char name[FILENAME_SIZE];
+	snprintf(name, FILENAME_SIZE, "%s-%d", SHARED_CLIPBOARD_NAME, (int)getuid());
+	_clipboardFd = shm_open(name, O_RDWR | O_CREAT, 0600);
+	if (_clipboardFd == -1)
+	{
+		_isUnavailable = true;
+		return false;
+	}
+
+	lockClipboard(F_WRLCK);
+	bool isOpened = growClipboard(SHARED_CLIPBOARD_SIZE);
+	lockClipboard(F_UNLCK);
+	if (!isOpened)
+	{
+		closeSharedClipboard();
+		_isUnavailable = true;
+	}
+
+	return isOpened;
+}
+
+/**
+ * Map all of the shared memory, it's mapped again if another editor made it larger. The memory never shrinks so the old mapping stays valid until then.
+ */
+static bool mapClipboard(void)
+{
+	struct stat clipStat;
+	if (fstat(_clipboardFd, &clipStat) == -1)
+	{
+		return false;
+	}
+
+	if (clipStat.st_size == _mappedSize)
+	{
+		return true;
+	}
+
+	void *clip = mmap(NULL, clipStat.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, _clipboardFd, 0);
+	if (clip == MAP_FAILED)
+	{
+		return false;
+	}
+
+	if (_clip != NULL)
+	{
+		munmap(_clip, _mappedSize);
+	}
+	_clip = clip;
+	_mappedSize = clipStat.st_size;
+	return true;
+}
+
+/**
+ * Make room for a clip of a size, the memory is at least doubled when it grows. Only called with the write lock held.
+ */
+static bool growClipboard(long size)
+{
+	struct stat clipStat;
+	long neededSize = (long)sizeof(sharedClip) + size;
+	if (fstat(_clipboardFd, &clipStat) == -1)
+	{
+		return false;
+	}
+
+	if (clipStat.st_size < neededSize)
+	{
+		long newSize = clipStat.st_size * 2 > neededSize ? clipStat.st_size * 2 : neededSize;
+		if (ftruncate(_clipboardFd, newSize) == -1)
+		{
+			return false;
+		}
+	}
+
+	return mapClipboard();
+}
+
+/**
+ * Take or release the lock on the shared memory, it keeps the editors from writing a clip at the same time.
+ */
+static void lockClipboard(short type)
+{
+	struct flock lock = {0};
+	lock.l_type = type;
+	lock.l_whence = SEEK_SET;
+	fcntl(_clipboardFd, F_SETLKW, &lock);
+}
+
+/**
+ * Share a clip with the other editors. The sequence is made odd while the text is written and even again when it's done,
+ * so readers never wait for the writer.
+ */
+void publishClip(const char *text, long size)
+{
+	if (!openSharedClipboard())
+	{
+		return;
+	}
+
+	lockClipboard(F_WRLCK);
+	if (growClipboard(size))
+	{
+		// An editor that died while writing left the sequence odd, it's rounded up to even so the new clip ends even.
+		unsigned long sequence = (__atomic_load_n(&_clip->sequence, __ATOMIC_RELAXED) + 1) & ~1UL;
+		__atomic_store_n(&_clip->sequence, sequence + 1, __ATOMIC_RELAXED);
+		__atomic_thread_fence(__ATOMIC_RELEASE);
+
+		memcpy(_clip->text, text, size);
+		__atomic_store_n(&_clip->size, size, __ATOMIC_RELAXED);
+		__atomic_store_n(&_clip->sequence, sequence + 2, __ATOMIC_RELEASE);
+		_lastSequence = sequence + 2;
+	}
+	lockClipboard(F_UNLCK);
+}
+
+/**
+ * Copy the shared clip if another editor published one since the last clip seen here, else NULL. The copy is retried while the clip is being written.
+ * A sequence left odd by an editor that died while writing is found by taking the lock. Returns the text, which the caller counts as memory.
+ */
+char *fetchClip(long *size)
+{
+	if (!openSharedClipboard())
+	{
+		return NULL;
+	}
+
+	char *text = NULL;
+	for (;;)
+	{
+		unsigned long sequence = __atomic_load_n(&_clip->sequence, __ATOMIC_ACQUIRE);
+		if (sequence % 2 == 1)
+		{
+			lockClipboard(F_RDLCK);
+			sequence = __atomic_load_n(&_clip->sequence, __ATOMIC_ACQUIRE);
+			lockClipboard(F_UNLCK);
+		}
+
+		if (sequence == _lastSequence || sequence % 2 == 1)
+		{
+			free(text);
+			return NULL;
+		}
+
+		// A size larger than the mapping is either a clip written after the memory grew or a torn read, an empty clip is never published.
+		long clipSize = __atomic_load_n(&_clip->size, __ATOMIC_RELAXED);
+		if (clipSize <= 0 || (long)sizeof(sharedClip) + clipSize > _mappedSize)
+		{
+			bool isMapped = clipSize > 0 && mapClipboard() && (long)sizeof(sharedClip) + clipSize <= _mappedSize;
+			if (!isMapped && __atomic_load_n(&_clip->sequence, __ATOMIC_ACQUIRE) == sequence)
+			{
+				free(text);
+				return NULL;
+			}
+			continue;
+		}
+
+		text = memAlloc(realloc(text, clipSize), clipSize);
+		memcpy(text, _clip->text, clipSize);
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		if (__atomic_load_n(&_clip->sequence, __ATOMIC_RELAXED) == sequence)
+		{
+			_lastSequence = sequence;
+			*size = clipSize;
+			return text;
+		}
+	}
+}
+
+/**
+ * Unmap the shared memory, the clip stays for the other editors and the next run.
+ */
+void closeSharedClipboard(void)
+{
+	if (_clip != NULL)
+	{
+		munmap(_clip, _mappedSize);
+	}
+
+	if (_clipboardFd != -1)
+	{
+		close(_clipboardFd);
+	}
+
+	_clip = NULL;
+	_clipboardFd = -1;
+	_mappedSize = 0;
+}
@@ -0,0 +1,26 @@
+/*
+	Writen by: Oscar Bergström
+	https://github.com/OSCARJFB
+
+	MIT License
+	Copyright (c) 2023 Oscar Bergström
+*/
+
+#ifndef SHAREDCLIPBOARD_H
+#define SHAREDCLIPBOARD_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include "textData.h"
+#include "allocHandler.h"
+
+#ifndef SHARED_CLIPBOARD_NAME
+#define SHARED_CLIPBOARD_NAME "/1st-editor-clipboard"
+#endif
+#define SHARED_CLIPBOARD_SIZE 65536
+
+void publishClip(const char *text, long size);
+char *fetchClip(long *size);
+void closeSharedClipboard(void);
+
+#endif // SHAREDCLIPBOARD_H
@@ -0,0 +1,90 @@
+/*
+	Writen by: Oscar Bergström
+	https://github.com/OSCARJFB
+
+	MIT License
+	Copyright (c) 2023 Oscar Bergström
+*/
+
+#define _POSIX_C_SOURCE 200809L
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include "streamInput.h"
+
+static int _streamFd = -1;
+
+/**
+ * Start reading text from a source that can't be seeked, like a pipe.
+ * The source is read without blocking, so text is only taken when it has arrived.
+ */
+void openStream(int fd)
+{
+	if (fd == -1)
+	{
+		return;
+	}
+
+	fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+	_streamFd = fd;
+}
+
+/**
+ * Stop reading the stream, this is done when it ends.
+ */
+void closeStream(void)
+{
+	if (_streamFd != -1)
+	{
+		close(_streamFd);
+	}
+	_streamFd = -1;
+}
+
+/**
+ * The descriptor is readable when more text has arrived, -1 if there is no stream.
+ */
+int getStreamFd(void)
+{
+	return _streamFd;
+}
+
+/**
+ * Read the text that has arrived, in chunks of STREAM_CHUNK_SIZE up to STREAM_BATCH_SIZE at a time.
+ * The returned buffer is counted as MEM_BUFFERS memory. The stream is closed when it ends.
+ */
+char *readStream(long *size)
+{
+	*size = 0;
+	if (_streamFd == -1)
+	{
+		return NULL;
+	}
+
+	long capacity = STREAM_CHUNK_SIZE;
+	char *text = memAlloc(malloc(capacity), capacity);
+	while (*size < STREAM_BATCH_SIZE)
+	{
+		if (capacity - *size < STREAM_CHUNK_SIZE)
+		{
+			capacity *= 2;
+			text = memAlloc(realloc(text, capacity), capacity);
+		}
+
+		ssize_t bytes = read(_streamFd, text + *size, STREAM_CHUNK_SIZE);
+		if (bytes > 0)
+		{
+			*size += bytes;
+			continue;
+		}
+
+		if (bytes == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR))
+		{
+			closeStream();
+		}
+		break;
+	}
+
+	trackMemory(MEM_BUFFERS, *size);
+	return text;
+}
@@ -0,0 +1,24 @@
+/*
+	Writen by: Oscar Bergström
+	https://github.com/OSCARJFB
+
+	MIT License
+	Copyright (c) 2023 Oscar Bergström
+*/
+
+#ifndef STREAMINPUT_H
+#define STREAMINPUT_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include "allocHandler.h"
+
+#define STREAM_CHUNK_SIZE 65536
+#define STREAM_BATCH_SIZE (4L * 1024L * 1024L)
+
+void openStream(int fd);
+void closeStream(void);
+int getStreamFd(void);
+char *readStream(long *size);
+
+#endif // STREAMINPUT_H
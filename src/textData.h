@@ -9,19 +9,27 @@
 #ifndef TEXTDATA_H
 #define TEXTDATA_H
 
+#include <stdint.h>
+
 #define ESC_KEY 27
 #define FILENAME_SIZE 100
+#define PASTE_MODE_ON "\033[?2004h"
+#define PASTE_MODE_OFF "\033[?2004l"
+#define PASTE_END "\033[201~"
 
 typedef struct coordinates
 {
 	int x, y;
 } coordinates;
 
+// The nodes live in one pool and are linked by their index in it, index 0 isn't used and ends the list. A node is 12 bytes.
+// The coordinates aren't stored, viewSlot finds them in the view map while the node is in view (0 if it isn't).
 typedef struct TEXT
 {
-	int ch, x, y;
-	struct TEXT *next;
-	struct TEXT *prev;
+	uint32_t next;
+	uint32_t prev;
+	unsigned int ch : 8;
+	unsigned int viewSlot : 24;
 } TEXT;
 
 typedef struct dataCopied
@@ -63,6 +71,30 @@ enum mode
 	CUT,
 	PASTE,
 	OPEN_FILE,
+	BRACKETED_PASTE,
+	SHOW_STATS,
+	SHOW_MEMORY,
+	SWITCH_DOCUMENT,
+	FILE_CHANGED,
+	FOLLOW_FILE,
+	READ_STREAM,
+	JUMP,
+	GO_TO_LINE,
+	GO_TO_TOP,
+	GO_TO_BOTTOM,
+	TEXT_MOTION,
+	FOLD,
+	MARK_FOLD,
+	CURSOR_ABOVE,
+	CURSOR_BELOW,
+	CURSOR_AT_MATCH,
+	CLEAR_CURSORS,
+	SEARCH_PROJECT,
+	LINE_OPERATION,
+	MARK_LINES,
+	RECORD_MACRO,
+	REPLAY_MACRO,
+	MACRO_LINE,
 	EXIT
 };
 
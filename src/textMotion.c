@@ -0,0 +1,148 @@
+/*
+	Writen by: Oscar Bergström
+	https://github.com/OSCARJFB
+
+	MIT License
+	Copyright (c) 2023 Oscar Bergström
+*/
+
+#include <ctype.h>
+#include "textMotion.h"
+
+static unsigned char _charClasses[256];
+static bool _isClassTableReady = false;
+
+static void buildCharClasses(void);
+
+/**
+ * Build the table holding the class of every character, bytes of multibyte characters are part of words.
+ */
+static void buildCharClasses(void)
+{
+	for (int ch = 0; ch < 256; ++ch)
+	{
+		if (ch >= 128 || isalnum(ch) || ch == '_')
+		{
+			_charClasses[ch] = CLASS_WORD;
+		}
+		else
+		{
+			_charClasses[ch] = isspace(ch) ? CLASS_SPACE : CLASS_PUNCTUATION;
+		}
+	}
+	_isClassTableReady = true;
+}
+
+/**
+ * The class of a character, a word is made of characters of the same class.
+ */
+int getCharClass(int ch)
+{
+	if (!_isClassTableReady)
+	{
+		buildCharClasses();
+	}
+
+	return _charClasses[(unsigned char)ch];
+}
+
+/**
+ * Find the start of the word following the node at the cursor, the rest of the current word and the space after it are skipped.
+ * Returns NULL if there is no word after the cursor and counts the newlines that were passed.
+ */
+TEXT *findNextWord(TEXT *node, long *lines)
+{
+	*lines = 0;
+	int startClass = getCharClass(node->ch);
+	for (; node != NULL && startClass != CLASS_SPACE && getCharClass(node->ch) == startClass; node = nextNode(node))
+	{
+	}
+
+	for (; node != NULL && getCharClass(node->ch) == CLASS_SPACE; node = nextNode(node))
+	{
+		*lines += node->ch == '\n' ? 1 : 0;
+	}
+
+	return node;
+}
+
+/**
+ * Find the start of the word before the cursor, node is the node just before the cursor.
+ * The space before the cursor is skipped. Returns the first node of the text if there is no word before it, and counts the newlines that were passed.
+ */
+TEXT *findPrevWord(TEXT *node, long *lines)
+{
+	*lines = 0;
+	for (; prevNode(node) != NULL && getCharClass(node->ch) == CLASS_SPACE; node = prevNode(node))
+	{
+		*lines += node->ch == '\n' ? 1 : 0;
+	}
+
+	// The first node of the text ends the search even if it's space.
+	if (getCharClass(node->ch) == CLASS_SPACE)
+	{
+		*lines += node->ch == '\n' ? 1 : 0;
+		return node;
+	}
+
+	int wordClass = getCharClass(node->ch);
+	for (; prevNode(node) != NULL && getCharClass(prevNode(node)->ch) == wordClass; node = prevNode(node))
+	{
+	}
+
+	return node;
+}
+
+/**
+ * Find the next empty line after the text following the cursor, empty lines at the cursor are skipped.
+ * Returns the newline of the empty line or NULL if the text ends first, and counts the newlines that were passed.
+ */
+TEXT *findNextParagraph(TEXT *node, long *lines)
+{
+	*lines = 0;
+	bool isInText = node->ch != '\n' || (prevNode(node) != NULL && prevNode(node)->ch != '\n');
+	for (; node != NULL; node = nextNode(node))
+	{
+		if (node->ch != '\n')
+		{
+			isInText = true;
+			continue;
+		}
+
+		++*lines;
+		if (isInText && (nextNode(node) == NULL || nextNode(node)->ch == '\n'))
+		{
+			return nextNode(node);
+		}
+	}
+
+	return NULL;
+}
+
+/**
+ * Find the empty line before the text preceding the cursor, node is the node just before the cursor.
+ * Returns the newline of the empty line, or the first node of the text if there is none, and counts the newlines that were passed.
+ */
+TEXT *findPrevParagraph(TEXT *node, long *lines)
+{
+	*lines = 0;
+	bool isInText = node->ch != '\n' || (nextNode(node) != NULL && nextNode(node)->ch != '\n');
+	for (; prevNode(node) != NULL; node = prevNode(node))
+	{
+		if (node->ch != '\n')
+		{
+			isInText = true;
+			continue;
+		}
+
+		++*lines;
+		if (isInText && prevNode(node)->ch == '\n')
+		{
+			return node;
+		}
+	}
+
+	// The cursor is placed before the first node, which passes it if it's a newline.
+	*lines += node->ch == '\n' ? 1 : 0;
+	return node;
+}
@@ -0,0 +1,30 @@
+/*
+	Writen by: Oscar Bergström
+	https://github.com/OSCARJFB
+
+	MIT License
+	Copyright (c) 2023 Oscar Bergström
+*/
+
+#ifndef TEXTMOTION_H
+#define TEXTMOTION_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include "textData.h"
+#include "allocHandler.h"
+
+enum charClass
+{
+	CLASS_SPACE,
+	CLASS_WORD,
+	CLASS_PUNCTUATION
+};
+
+int getCharClass(int ch);
+TEXT *findNextWord(TEXT *node, long *lines);
+TEXT *findPrevWord(TEXT *node, long *lines);
+TEXT *findNextParagraph(TEXT *node, long *lines);
+TEXT *findPrevParagraph(TEXT *node, long *lines);
+
+#endif // TEXTMOTION_H
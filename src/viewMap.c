@@ -0,0 +1,135 @@
+/*
+	Writen by: Oscar Bergström
+	https://github.com/OSCARJFB
+
+	MIT License
+	Copyright (c) 2023 Oscar Bergström
+*/
+
+#include "viewMap.h"
+
+// The nodes in view in the order they are printed, with the coordinates they are printed at. Slot i of a node is stored in it as i + 1.
+static viewNode *_viewNodes = NULL;
+static long _viewCount = 0, _viewCapacity = 0;
+
+// The first slot of each row of the view.
+static long *_rowStarts = NULL;
+static int _rowCount = 0, _rowCapacity = 0;
+
+static bool isSlotOf(long slot, const TEXT *node);
+
+/**
+ * Forget the nodes of the view, before the view is laid out again.
+ */
+void clearViewMap(void)
+{
+	_viewCount = 0;
+	_rowCount = 0;
+}
+
+/**
+ * Give a node its place in the view. The nodes are placed in the order they are printed, so the rows only grow.
+ * Only a line of millions of characters fills the slots, its last nodes are far outside the terminal.
+ */
+void placeNode(TEXT *node, int x, int y)
+{
+	if (_viewCount == VIEW_MAP_SLOTS)
+	{
+		node->viewSlot = 0;
+		return;
+	}
+
+	if (_viewCount == _viewCapacity)
+	{
+		long capacity = _viewCapacity > 0 ? _viewCapacity * 2 : 1024;
+		_viewNodes = memAlloc(realloc(_viewNodes, capacity * sizeof(viewNode)), capacity * sizeof(viewNode));
+		trackMemory(MEM_STRUCTURE, (capacity - _viewCapacity) * (long)sizeof(viewNode));
+		_viewCapacity = capacity;
+	}
+
+	for (; _rowCount <= y; ++_rowCount)
+	{
+		if (_rowCount == _rowCapacity)
+		{
+			int capacity = _rowCapacity > 0 ? _rowCapacity * 2 : 64;
+			_rowStarts = memAlloc(realloc(_rowStarts, capacity * sizeof(long)), capacity * sizeof(long));
+			trackMemory(MEM_STRUCTURE, (capacity - _rowCapacity) * (long)sizeof(long));
+			_rowCapacity = capacity;
+		}
+		_rowStarts[_rowCount] = _viewCount;
+	}
+
+	_viewNodes[_viewCount].node = node;
+	_viewNodes[_viewCount].x = x;
+	_viewNodes[_viewCount].y = y;
+	node->viewSlot = ++_viewCount;
+}
+
+/**
+ * Check that a slot holds a node. A slot left in a node by an older view may belong to another node now.
+ */
+static bool isSlotOf(long slot, const TEXT *node)
+{
+	return slot > 0 && slot <= _viewCount && _viewNodes[slot - 1].node == node;
+}
+
+/**
+ * The coordinates a node was placed at when the view was laid out, {-1, -1} if it isn't in the view.
+ */
+coordinates getNodeCoordinates(const TEXT *node)
+{
+	coordinates xy = {-1, -1};
+	if (isSlotOf(node->viewSlot, node))
+	{
+		xy.x = _viewNodes[node->viewSlot - 1].x;
+		xy.y = _viewNodes[node->viewSlot - 1].y;
+	}
+
+	return xy;
+}
+
+/**
+ * Check if a node was placed at coordinates.
+ */
+bool isNodeAt(const TEXT *node, coordinates xy)
+{
+	coordinates nodeXy = getNodeCoordinates(node);
+	return nodeXy.x == xy.x && nodeXy.y == xy.y;
+}
+
+/**
+ * The node placed at coordinates, NULL if there is none. The row is searched from its first slot.
+ * A node freed since the view was laid out is skipped, it may not even be mapped anymore.
+ */
+TEXT *getNodeAt(coordinates xy)
+{
+	if (xy.y < 0 || xy.y >= _rowCount)
+	{
+		return NULL;
+	}
+
+	for (long slot = _rowStarts[xy.y]; slot < _viewCount && _viewNodes[slot].y == xy.y; ++slot)
+	{
+		TEXT *node = _viewNodes[slot].node;
+		if (_viewNodes[slot].x == xy.x && isNodeMapped(node) && isSlotOf(node->viewSlot, node))
+		{
+			return node;
+		}
+	}
+
+	return NULL;
+}
+
+/**
+ * Free the view map, when the editor exits.
+ */
+void freeViewMap(void)
+{
+	trackMemory(MEM_STRUCTURE, -_viewCapacity * (long)sizeof(viewNode) - _rowCapacity * (long)sizeof(long));
+	free(_viewNodes);
+	free(_rowStarts);
+	_viewNodes = NULL;
+	_rowStarts = NULL;
+	_viewCount = _viewCapacity = 0;
+	_rowCount = _rowCapacity = 0;
+}
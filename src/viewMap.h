@@ -0,0 +1,33 @@
+/*
+	Writen by: Oscar Bergström
+	https://github.com/OSCARJFB
+
+	MIT License
+	Copyright (c) 2023 Oscar Bergström
+*/
+
+#ifndef VIEWMAP_H
+#define VIEWMAP_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include "textData.h"
+#include "allocHandler.h"
+
+// A node holds its slot in 24 bits, the nodes of a view past the last slot get no coordinates.
+#define VIEW_MAP_SLOTS ((1L << 24) - 1)
+
+typedef struct viewNode
+{
+	TEXT *node;
+	int x, y;
+} viewNode;
+
+void clearViewMap(void);
+void placeNode(TEXT *node, int x, int y);
+coordinates getNodeCoordinates(const TEXT *node);
+bool isNodeAt(const TEXT *node, coordinates xy);
+TEXT *getNodeAt(coordinates xy);
+void freeViewMap(void);
+
+#endif // VIEWMAP_H